@@ -157,6 +157,51 @@ DEF_FADE( me )
 
 DEF_PLAY_STOP( se )
 
+RB_METHOD(audio_sePreload)
+{
+	RB_UNUSED_PARAM;
+
+	/* Accepts either a list of names or a single array */
+	VALUE list = (argc == 1 && RB_TYPE_P(argv[0], T_ARRAY))
+		? argv[0] : rb_ary_new4(argc, argv);
+
+	std::vector<std::string> filenames;
+
+	for (long i = 0; i < RARRAY_LEN(list); ++i)
+	{
+		VALUE name = rb_ary_entry(list, i);
+		SafeStringValue(name);
+		filenames.push_back(std::string(RSTRING_PTR(name), RSTRING_LEN(name)));
+	}
+
+	unsigned int handle = 0;
+	GUARD_EXC( handle = shState->audio().sePreload(filenames); )
+
+	return UINT2NUM(handle);
+}
+
+RB_METHOD(audio_sePreloadDone)
+{
+	RB_UNUSED_PARAM;
+
+	int handle;
+	rb_get_args(argc, argv, "i", &handle RB_ARG_END);
+
+	return rb_bool_new(shState->audio().sePreloadDone(handle));
+}
+
+RB_METHOD(audio_seReleasePreload)
+{
+	RB_UNUSED_PARAM;
+
+	int handle;
+	rb_get_args(argc, argv, "i", &handle RB_ARG_END);
+
+	shState->audio().seReleasePreload(handle);
+
+	return Qnil;
+}
+
 RB_METHOD(audioSetupMidi)
 {
 	RB_UNUSED_PARAM;
@@ -208,6 +253,9 @@ audioBindingInit()
 	_rb_define_module_function(module, "setup_midi", audioSetupMidi);
 
 	BIND_PLAY_STOP( se )
+	_rb_define_module_function(module, "se_preload", audio_sePreload);
+	_rb_define_module_function(module, "se_preload_done?", audio_sePreloadDone);
+	_rb_define_module_function(module, "se_release_preload", audio_seReleasePreload);
 
 	_rb_define_module_function(module, "__reset__", audioReset);
 }
@@ -23,6 +23,7 @@
 #include "filesystem/filesystem.h"
 #include "display/graphics.h"
 #include "display/font.h"
+#include "display/decodepool.h"
 #include "system/system.h"
 
 #include "util/util.h"
@@ -379,7 +380,7 @@ RB_METHOD(mkxpDesensitize) {
     SafeStringValue(filename);
     
     return rb_utf8_str_new_cstr(
-                                shState->fileSystem().desensitize(RSTRING_PTR(filename)));
+                                shState->fileSystem().desensitize(RSTRING_PTR(filename)).c_str());
 }
 
 RB_METHOD(mkxpPuts) {
@@ -535,6 +536,8 @@ RB_METHOD(mkxpSystemMemory) {
 RB_METHOD(mkxpReloadPathCache) {
     RB_UNUSED_PARAM;
     
+    /* Preloads read the path cache from worker threads */
+    shState->decodePool().wait();
     shState->fileSystem().reloadPathCache();
     return Qnil;
 }
@@ -554,6 +557,7 @@ RB_METHOD(mkxpAddPath) {
         if (reload != Qnil)
             rb_bool_arg(reload, &rl);
         
+        shState->decodePool().wait();
         shState->fileSystem().addPath(RSTRING_PTR(path), mp, rl);
     } catch (Exception &e) {
         raiseRbExc(e);
@@ -573,6 +577,7 @@ RB_METHOD(mkxpRemovePath) {
         if (reload != Qnil)
             rb_bool_arg(reload, &rl);
         
+        shState->decodePool().wait();
         shState->fileSystem().removePath(RSTRING_PTR(path), rl);
     } catch (Exception &e) {
         raiseRbExc(e);
@@ -870,6 +875,33 @@ static void runCustomScript(const std::string &filename) {
                newStringUTF8(filename.c_str(), filename.size()), NULL);
 }
 
+/* Times 'count' Sprite#x= calls from Ruby, ie. the per-setter cost
+ * (dispatch plus graphics lock) a script moving lots of sprites pays */
+static void runPropertyBenchmark(int count) {
+    char script[512];
+    snprintf(script, sizeof(script),
+             "sprite = Sprite.new\n"
+             "start = Time.now\n"
+             "%d.times { |i| sprite.x = i }\n"
+             "elapsed = Time.now - start\n"
+             "sprite.dispose\n"
+             "elapsed\n", count);
+    
+    int state;
+    VALUE elapsed = evalString(rb_str_new_cstr(script),
+                               rb_str_new_cstr("benchmarkPropertySets"), &state);
+    
+    if (state) {
+        Debug() << "Property set benchmark failed";
+        return;
+    }
+    
+    const double secs = NUM2DBL(elapsed);
+    
+    Debug() << count << "Sprite#x= calls:" << secs * 1000.0 << "ms,"
+            << secs * 1e9 / count << "ns per call";
+}
+
 VALUE kernelLoadDataInt(const char *filename, bool rubyExc, bool raw);
 
 struct BacktraceData {
@@ -1224,6 +1256,9 @@ static void mriBindingExecute() {
     
     mriBindingInit();
     
+    if (conf.benchmarkPropertySets > 0)
+        runPropertyBenchmark(conf.benchmarkPropertySets);
+    
     std::string &customScript = conf.customScript;
     if (!customScript.empty())
         runCustomScript(customScript);
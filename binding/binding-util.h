@@ -327,6 +327,19 @@ raiseRbExc(exc);                                                         \
 GFX_UNLOCK;\
 }
 
+/* For calls that only modify CPU side state */
+#define GFX_STATE_GUARD_EXC(exp)                                                   \
+{\
+GFX_STATE_LOCK; \
+try {\
+exp                                                                      \
+} catch (const Exception &exc) {\
+GFX_STATE_UNLOCK; \
+raiseRbExc(exc);                                                         \
+}\
+GFX_STATE_UNLOCK;\
+}
+
 
 template <class C>
 static inline VALUE objectLoad(int argc, VALUE *argv, VALUE self) {
@@ -614,6 +627,9 @@ return propObj;                                                            \
 DEF_PROP_OBJ_VAL(Klass, PropKlass, PropName, prop_iv)
 #endif
 
+/* Scalar properties of graphics objects only ever update CPU side
+ * state (vertex data is uploaded on the next draw), so they don't
+ * need the GL context */
 #define DEF_GFX_PROP(Klass, type, PropName, arg_fun, value_fun)                    \
 RB_METHOD(Klass##Get##PropName) {                                            \
 RB_UNUSED_PARAM;                                                           \
@@ -627,7 +643,7 @@ rb_check_argc(argc, 1);                                                    \
 Klass *k = getPrivateData<Klass>(self);                                    \
 type value;                                                                \
 rb_##arg_fun##_arg(*argv, &value);                                         \
-GFX_GUARD_EXC(k->set##PropName(value);)                                        \
+GFX_STATE_GUARD_EXC(k->set##PropName(value);)                                  \
 return *argv;                                                              \
 }
 
@@ -22,6 +22,10 @@
 #include "binding-types.h"
 #include "binding-util.h"
 #include "bitmap.h"
+#include "bitmapcache.h"
+#include "glyphatlas.h"
+#include "textcache.h"
+#include "texpool.h"
 #include "disposable-binding.h"
 #include "exception.h"
 #include "font.h"
@@ -208,6 +212,27 @@ RB_METHOD(bitmapGetPixel) {
     return wrapObject(color, ColorType);
 }
 
+RB_METHOD(bitmapRequestReadback) {
+    RB_UNUSED_PARAM;
+    
+    Bitmap *b = getPrivateData<Bitmap>(self);
+    
+    GFX_GUARD_EXC(b->requestReadback(););
+    
+    return self;
+}
+
+RB_METHOD(bitmapReadbackReady) {
+    RB_UNUSED_PARAM;
+    
+    Bitmap *b = getPrivateData<Bitmap>(self);
+    
+    bool ready = true;
+    GFX_GUARD_EXC(ready = b->readbackReady(););
+    
+    return rb_bool_new(ready);
+}
+
 RB_METHOD(bitmapSetPixel) {
     Bitmap *b = getPrivateData<Bitmap>(self);
     
@@ -707,6 +732,145 @@ RB_METHOD(bitmapGetMaxSize){
     return INT2NUM(Bitmap::maxSize());
 }
 
+RB_METHOD(bitmapPreload) {
+    RB_UNUSED_PARAM;
+    
+    /* Accepts either a list of paths or a single array */
+    VALUE list = (argc == 1 && RB_TYPE_P(argv[0], T_ARRAY))
+        ? argv[0] : rb_ary_new4(argc, argv);
+    
+    std::vector<std::string> filenames;
+    
+    for (long i = 0; i < RARRAY_LEN(list); ++i) {
+        VALUE path = rb_ary_entry(list, i);
+        SafeStringValue(path);
+        filenames.push_back(std::string(RSTRING_PTR(path), RSTRING_LEN(path)));
+    }
+    
+    unsigned int handle = 0;
+    GUARD_EXC(handle = Bitmap::preload(filenames););
+    
+    return UINT2NUM(handle);
+}
+
+RB_METHOD(bitmapPreloadDone) {
+    RB_UNUSED_PARAM;
+    
+    int handle;
+    rb_get_args(argc, argv, "i", &handle RB_ARG_END);
+    
+    return rb_bool_new(Bitmap::preloadDone(handle));
+}
+
+RB_METHOD(bitmapReleasePreload) {
+    RB_UNUSED_PARAM;
+    
+    int handle;
+    rb_get_args(argc, argv, "i", &handle RB_ARG_END);
+    
+    Bitmap::releasePreload(handle);
+    
+    return Qnil;
+}
+
+RB_METHOD(bitmapCacheStats) {
+    RB_UNUSED_PARAM;
+    
+    rb_check_argc(argc, 0);
+    
+    BitmapCache::Stats stats = shState->bitmapCache().stats();
+    
+    VALUE ret = rb_hash_new();
+    rb_hash_aset(ret, ID2SYM(rb_intern("hits")), ULL2NUM(stats.hits));
+    rb_hash_aset(ret, ID2SYM(rb_intern("misses")), ULL2NUM(stats.misses));
+    rb_hash_aset(ret, ID2SYM(rb_intern("evictions")), ULL2NUM(stats.evictions));
+    rb_hash_aset(ret, ID2SYM(rb_intern("entries")), UINT2NUM(stats.entries));
+    rb_hash_aset(ret, ID2SYM(rb_intern("size")), ULL2NUM(stats.memSize));
+    rb_hash_aset(ret, ID2SYM(rb_intern("idle_size")), ULL2NUM(stats.idleMemSize));
+    rb_hash_aset(ret, ID2SYM(rb_intern("budget")), ULL2NUM(stats.maxMemSize));
+    
+    return ret;
+}
+
+RB_METHOD(bitmapTextAtlasStats) {
+    RB_UNUSED_PARAM;
+    
+    rb_check_argc(argc, 0);
+    
+    GlyphAtlas::Stats stats = shState->glyphAtlas().stats();
+    
+    VALUE ret = rb_hash_new();
+    rb_hash_aset(ret, ID2SYM(rb_intern("hits")), ULL2NUM(stats.hits));
+    rb_hash_aset(ret, ID2SYM(rb_intern("misses")), ULL2NUM(stats.misses));
+    rb_hash_aset(ret, ID2SYM(rb_intern("fallbacks")), ULL2NUM(stats.fallbacks));
+    rb_hash_aset(ret, ID2SYM(rb_intern("resets")), ULL2NUM(stats.resets));
+    rb_hash_aset(ret, ID2SYM(rb_intern("evictions")), ULL2NUM(stats.evictions));
+    rb_hash_aset(ret, ID2SYM(rb_intern("pages")), UINT2NUM(stats.pages));
+    rb_hash_aset(ret, ID2SYM(rb_intern("glyphs")), UINT2NUM(stats.glyphs));
+    rb_hash_aset(ret, ID2SYM(rb_intern("size")), ULL2NUM(stats.memSize));
+    
+    return ret;
+}
+
+RB_METHOD(bitmapTextCacheStats) {
+    RB_UNUSED_PARAM;
+    
+    rb_check_argc(argc, 0);
+    
+    TextCache::Stats stats = shState->textCache().stats();
+    
+    VALUE ret = rb_hash_new();
+    rb_hash_aset(ret, ID2SYM(rb_intern("hits")), ULL2NUM(stats.hits));
+    rb_hash_aset(ret, ID2SYM(rb_intern("misses")), ULL2NUM(stats.misses));
+    rb_hash_aset(ret, ID2SYM(rb_intern("evictions")), ULL2NUM(stats.evictions));
+    rb_hash_aset(ret, ID2SYM(rb_intern("entries")), UINT2NUM(stats.entries));
+    rb_hash_aset(ret, ID2SYM(rb_intern("size")), ULL2NUM(stats.memSize));
+    rb_hash_aset(ret, ID2SYM(rb_intern("budget")), ULL2NUM(stats.maxMemSize));
+    rb_hash_aset(ret, ID2SYM(rb_intern("size_hits")), ULL2NUM(stats.sizeHits));
+    rb_hash_aset(ret, ID2SYM(rb_intern("size_misses")), ULL2NUM(stats.sizeMisses));
+    rb_hash_aset(ret, ID2SYM(rb_intern("size_entries")), UINT2NUM(stats.sizeEntries));
+    
+    return ret;
+}
+
+RB_METHOD(bitmapTexturePoolStats) {
+    RB_UNUSED_PARAM;
+    
+    rb_check_argc(argc, 0);
+    
+    TexPool::Stats stats = shState->texPool().stats();
+    
+    VALUE largest = rb_ary_new();
+    for (size_t i = 0; i < stats.largest.size(); ++i)
+        rb_ary_push(largest, rb_ary_new3(2, INT2NUM(stats.largest[i].x),
+                                         INT2NUM(stats.largest[i].y)));
+    
+    VALUE ret = rb_hash_new();
+    rb_hash_aset(ret, ID2SYM(rb_intern("hits")), ULL2NUM(stats.hits));
+    rb_hash_aset(ret, ID2SYM(rb_intern("class_hits")), ULL2NUM(stats.classHits));
+    rb_hash_aset(ret, ID2SYM(rb_intern("misses")), ULL2NUM(stats.misses));
+    rb_hash_aset(ret, ID2SYM(rb_intern("evictions")), ULL2NUM(stats.evictions));
+    rb_hash_aset(ret, ID2SYM(rb_intern("entries")), UINT2NUM(stats.entries));
+    rb_hash_aset(ret, ID2SYM(rb_intern("size")), ULL2NUM(stats.memSize));
+    rb_hash_aset(ret, ID2SYM(rb_intern("budget")), ULL2NUM(stats.maxMemSize));
+    rb_hash_aset(ret, ID2SYM(rb_intern("largest")), largest);
+    
+    return ret;
+}
+
+RB_METHOD(bitmapClearCache) {
+    RB_UNUSED_PARAM;
+    
+    rb_check_argc(argc, 0);
+    
+    GFX_LOCK;
+    shState->bitmapCache().clear();
+    shState->textCache().clear();
+    GFX_UNLOCK;
+    
+    return Qnil;
+}
+
 RB_METHOD(bitmapInitializeCopy) {
     rb_check_argc(argc, 1);
     VALUE origObj = argv[0];
@@ -748,6 +912,8 @@ void bitmapBindingInit() {
     _rb_define_method(klass, "clear", bitmapClear);
     _rb_define_method(klass, "get_pixel", bitmapGetPixel);
     _rb_define_method(klass, "set_pixel", bitmapSetPixel);
+    _rb_define_method(klass, "request_readback", bitmapRequestReadback);
+    _rb_define_method(klass, "readback_ready?", bitmapReadbackReady);
     _rb_define_method(klass, "hue_change", bitmapHueChange);
     _rb_define_method(klass, "draw_text", bitmapDrawText);
     _rb_define_method(klass, "text_size", bitmapTextSize);
@@ -763,6 +929,14 @@ void bitmapBindingInit() {
     
     _rb_define_method(klass, "mega?", bitmapGetMega);
     rb_define_singleton_method(klass, "max_size", RUBY_METHOD_FUNC(bitmapGetMaxSize), -1);
+    rb_define_singleton_method(klass, "preload", RUBY_METHOD_FUNC(bitmapPreload), -1);
+    rb_define_singleton_method(klass, "preload_done?", RUBY_METHOD_FUNC(bitmapPreloadDone), -1);
+    rb_define_singleton_method(klass, "release_preload", RUBY_METHOD_FUNC(bitmapReleasePreload), -1);
+    rb_define_singleton_method(klass, "cache_stats", RUBY_METHOD_FUNC(bitmapCacheStats), -1);
+    rb_define_singleton_method(klass, "text_atlas_stats", RUBY_METHOD_FUNC(bitmapTextAtlasStats), -1);
+    rb_define_singleton_method(klass, "text_cache_stats", RUBY_METHOD_FUNC(bitmapTextCacheStats), -1);
+    rb_define_singleton_method(klass, "texture_pool_stats", RUBY_METHOD_FUNC(bitmapTexturePoolStats), -1);
+    rb_define_singleton_method(klass, "clear_cache", RUBY_METHOD_FUNC(bitmapClearCache), -1);
     
     _rb_define_method(klass, "animated?", bitmapGetAnimated);
     _rb_define_method(klass, "playing", bitmapGetPlaying);
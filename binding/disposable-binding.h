@@ -32,7 +32,6 @@
 inline void
 disposableAddChild(VALUE disp, VALUE child)
 {
-    GFX_LOCK;
     if (NIL_P(disp) || NIL_P(child)) {
         return;
     }
@@ -58,13 +57,11 @@ disposableAddChild(VALUE disp, VALUE child)
         VALUE method = rb_funcall(disp, rb_intern("method"), 1, rb_id2sym(rb_intern("_sprite_finalizer")));
         rb_funcall(objectspace, rb_intern("define_finalizer"), 2, child, method);
     }
-    GFX_UNLOCK;
 }
 
 inline void
 disposableRemoveChild(VALUE disp, VALUE child)
 {
-    GFX_LOCK;
     if (NIL_P(disp) || NIL_P(child)) {
         return;
     }
@@ -80,7 +77,6 @@ disposableRemoveChild(VALUE disp, VALUE child)
         return;
     
     rb_funcall(children, rb_intern("delete_at"), 1, index);
-    GFX_UNLOCK;
 }
 
 inline void
@@ -31,12 +31,44 @@
 
 RB_METHOD(graphicsDelta) {
     RB_UNUSED_PARAM;
-    GFX_LOCK;
+    GFX_STATE_LOCK;
     VALUE ret = rb_float_new(shState->graphics().getDelta());
-    GFX_UNLOCK;
+    GFX_STATE_UNLOCK;
     return ret;
 }
 
+/* Calls the blocks given to Graphics.screenshot_async
+ * whose files have been written since */
+static void runScreenshotCallbacks(VALUE module)
+{
+    VALUE callbacks = rb_iv_get(module, "screenshot_callbacks");
+    
+    if (NIL_P(callbacks))
+        return;
+    
+    VALUE handles = rb_funcall(callbacks, rb_intern("keys"), 0);
+    
+    for (long i = 0; i < RARRAY_LEN(handles); ++i)
+    {
+        VALUE handle = rb_ary_entry(handles, i);
+        
+        std::string error;
+        bool done;
+        
+        GFX_LOCK;
+        done = shState->graphics().screenshotDone(NUM2UINT(handle), error);
+        GFX_UNLOCK;
+        
+        if (!done)
+            continue;
+        
+        VALUE callback = rb_hash_delete(callbacks, handle);
+        VALUE success = rb_bool_new(error.empty());
+        
+        rb_funcall2(callback, rb_intern("call"), 1, &success);
+    }
+}
+
 RB_METHOD(graphicsUpdate)
 {
     RB_UNUSED_PARAM;
@@ -50,15 +82,17 @@ RB_METHOD(graphicsUpdate)
 #else
     shState->graphics().update();
 #endif
+    runScreenshotCallbacks(self);
+    
     return Qnil;
 }
 
 RB_METHOD(graphicsAverageFrameRate)
 {
     RB_UNUSED_PARAM;
-    GFX_LOCK;
+    GFX_STATE_LOCK;
     VALUE ret = rb_float_new(shState->graphics().averageFrameRate());
-    GFX_UNLOCK;
+    GFX_STATE_UNLOCK;
     return ret;
 }
 
@@ -358,6 +392,50 @@ RB_METHOD(graphicsScreenshot)
     return Qnil;
 }
 
+RB_METHOD(graphicsScreenshotAsync)
+{
+    RB_UNUSED_PARAM;
+    
+    VALUE filename;
+    rb_scan_args(argc, argv, "1", &filename);
+    SafeStringValue(filename);
+    
+    unsigned int handle = 0;
+    GFX_GUARD_EXC(handle = shState->graphics().screenshotAsync(RSTRING_PTR(filename)););
+    
+    if (rb_block_given_p())
+    {
+        VALUE callbacks = rb_iv_get(self, "screenshot_callbacks");
+        
+        if (NIL_P(callbacks))
+        {
+            callbacks = rb_hash_new();
+            rb_iv_set(self, "screenshot_callbacks", callbacks);
+        }
+        
+        rb_hash_aset(callbacks, UINT2NUM(handle), rb_block_proc());
+    }
+    
+    return UINT2NUM(handle);
+}
+
+RB_METHOD(graphicsScreenshotDone)
+{
+    RB_UNUSED_PARAM;
+    
+    int handle;
+    rb_get_args(argc, argv, "i", &handle RB_ARG_END);
+    
+    std::string error;
+    bool done = true;
+    GFX_GUARD_EXC(done = shState->graphics().screenshotDone(handle, error););
+    
+    if (!error.empty())
+        raiseRbExc(Exception(Exception::SDLError, "%s", error.c_str()));
+    
+    return rb_bool_new(done);
+}
+
 DEF_GRA_PROP_I(FrameRate)
 DEF_GRA_PROP_I(FrameCount)
 DEF_GRA_PROP_I(Brightness)
@@ -388,6 +466,8 @@ void graphicsBindingInit()
     _rb_define_module_function(module, "transition", graphicsTransition);
     _rb_define_module_function(module, "frame_reset", graphicsFrameReset);
     _rb_define_module_function(module, "screenshot", graphicsScreenshot);
+    _rb_define_module_function(module, "screenshot_async", graphicsScreenshotAsync);
+    _rb_define_module_function(module, "screenshot_done?", graphicsScreenshotDone);
     
     _rb_define_module_function(module, "__reset__", graphicsReset);
     
@@ -0,0 +1,33 @@
+/* Turns the per channel glyph coverage (text, outline,
+ * shadow) into the final text image, the same way
+ * Bitmap::drawText blends the SDL_ttf surfaces */
+
+uniform sampler2D texture;
+
+uniform lowp vec4 textColor;
+uniform lowp vec4 outColor;
+
+uniform lowp float outline;
+
+varying vec2 v_texCoord;
+
+void main()
+{
+	vec3 cov = texture2D(texture, v_texCoord).rgb;
+
+	/* Black drop shadow behind the text */
+	float alpha = cov.r + cov.b * (1.0 - cov.r);
+	vec4 resFrag = vec4(textColor.rgb, alpha);
+
+	if (alpha > 0.0)
+		resFrag.rgb *= cov.r / alpha;
+
+	/* Outline behind both */
+	if (outline > 0.0)
+	{
+		resFrag.rgb = mix(outColor.rgb, resFrag.rgb, resFrag.a);
+		resFrag.a += cov.g * (1.0 - resFrag.a);
+	}
+
+	gl_FragColor = resFrag;
+}
@@ -0,0 +1,31 @@
+
+uniform sampler2D texture;
+
+uniform lowp float gray;
+uniform lowp vec4 tone;
+uniform lowp vec4 color;
+uniform lowp vec4 flash;
+
+varying vec2 v_texCoord;
+
+const vec3 lumaF = vec3(.299, .587, .114);
+
+void main()
+{
+	/* Sample source color */
+	vec4 frag = texture2D(texture, v_texCoord);
+
+	/* Apply gray */
+	float luma = dot(frag.rgb, lumaF);
+	frag.rgb = mix(frag.rgb, vec3(luma), gray);
+
+	/* Apply tone, additive part first */
+	frag.rgb = clamp(frag.rgb + max(tone.rgb, 0.0), 0.0, 1.0);
+	frag.rgb = clamp(frag.rgb + min(tone.rgb, 0.0), 0.0, 1.0);
+
+	/* Apply color and flash */
+	frag.rgb = mix(frag.rgb, color.rgb, color.a);
+	frag.rgb = mix(frag.rgb, flash.rgb, flash.a);
+
+	gl_FragColor = frag;
+}
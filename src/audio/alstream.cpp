@@ -32,17 +32,20 @@
 #include "debugwriter.h"
 
 #include <SDL_mutex.h>
-#include <SDL_thread.h>
 #include <SDL_timer.h>
 
+#include <algorithm>
+#include <stdint.h>
+
 ALStream::ALStream(LoopMode loopMode,
-		           const std::string &threadId)
+		           AudioScheduler &scheduler)
 	: looped(loopMode == Looped),
 	  state(Closed),
 	  source(0),
-	  thread(0),
+	  scheduler(scheduler),
 	  preemptPause(false),
-      pitch(1.0f)
+      pitch(1.0f),
+	  alPitch(1.0f)
 {
 	alSrc = AL::Source::gen();
 
@@ -54,8 +57,6 @@ ALStream::ALStream(LoopMode loopMode,
 		alBuf[i] = AL::Buffer::gen();
 
 	pauseMut = SDL_CreateMutex();
-
-	threadName = std::string("al_stream (") + threadId + ")";
 }
 
 ALStream::~ALStream()
@@ -140,6 +141,10 @@ void ALStream::play(float offset)
 		break;
 	case Paused :
 		resumeStream();
+
+		/* The stream parked itself while paused */
+		if (streamInited)
+			scheduler.wake(this);
 	}
 
 	state = Playing;
@@ -172,9 +177,11 @@ void ALStream::setPitch(float value)
 	/* If the source supports setting pitch natively,
 	 * we don't have to do it via OpenAL */
 	if (source && source->setPitch(value))
-		AL::Source::setPitch(alSrc, 1.0f);
+		alPitch = 1.0f;
 	else
-		AL::Source::setPitch(alSrc, value);
+		alPitch = value;
+
+	AL::Source::setPitch(alSrc, alPitch);
 }
 
 ALStream::State ALStream::queryState()
@@ -273,18 +280,12 @@ void ALStream::openSource(const std::string &filename)
 
 void ALStream::stopStream()
 {
-	threadTermReq.set();
+	scheduler.remove(this);
+	needsRewind.set();
 
-	if (thread)
-	{
-		SDL_WaitThread(thread, 0);
-		thread = 0;
-		needsRewind.set();
-	}
-
-	/* Need to stop the source _after_ the thread has terminated,
-	 * because it might have accidentally started it again before
-	 * seeing the term request */
+	/* Need to stop the source _after_ the stream has been
+	 * unscheduled, because a refill in progress might have
+	 * started it again */
 	AL::Source::stop(alSrc);
 
 	procFrames = 0;
@@ -293,17 +294,16 @@ void ALStream::stopStream()
 void ALStream::startStream(float offset)
 {
 	AL::Source::clearQueue(alSrc);
+	queuedFrames.clear();
 
 	preemptPause = false;
 	streamInited.clear();
 	sourceExhausted.clear();
-	threadTermReq.clear();
 
 	startOffset = offset;
 	procFrames = offset * source->sampleRate();
 
-	thread = createSDLThread
-		<ALStream, &ALStream::streamData>(this, threadName);
+	scheduler.wake(this);
 }
 
 void ALStream::pauseStream()
@@ -357,44 +357,41 @@ void ALStream::checkStopped()
 	state = Stopped;
 }
 
-/* thread func */
-void ALStream::streamData()
+void ALStream::queueBuffer(AL::Buffer::ID buf)
 {
-	/* Fill up queue */
-	bool firstBuffer = true;
-	ALDataSource::Status status;
+	ALint bits = AL::Buffer::getBits(buf);
+	ALint size = AL::Buffer::getSize(buf);
+	ALint chan = AL::Buffer::getChannels(buf);
 
-	if (threadTermReq)
-		return;
+	AL::Source::queueBuffer(alSrc, buf);
+	queuedFrames.push_back((bits != 0 && chan != 0) ? (size / (bits / 8)) / chan : 0);
+}
+
+/* Returns false if the stream can't continue */
+bool ALStream::fillQueue()
+{
+	ALDataSource::Status status;
 
 	//if (needsRewind)
 		source->seekToOffset(startOffset);
 
 	for (int i = 0; i < STREAM_BUFS; ++i)
 	{
-		if (threadTermReq)
-			return;
-
 		AL::Buffer::ID buf = alBuf[i];
 
 		status = source->fillBuffer(buf);
 
 		if (status == ALDataSource::Error)
-			return;
+			return false;
 
-		AL::Source::queueBuffer(alSrc, buf);
+		queueBuffer(buf);
 
-		if (firstBuffer)
+		if (i == 0)
 		{
 			resumeStream();
-
-			firstBuffer = false;
 			streamInited.set();
 		}
 
-		if (threadTermReq)
-			return;
-
 		if (status == ALDataSource::EndOfStream)
 		{
 			sourceExhausted.set();
@@ -402,76 +399,120 @@ void ALStream::streamData()
 		}
 	}
 
-	/* Wait for buffers to be consumed, then
-	 * refill and queue them up again */
-	while (true)
+	return true;
+}
+
+/* Unqueues consumed buffers, then refills
+ * and queues them up again */
+bool ALStream::refillQueue()
+{
+	ALDataSource::Status status;
+	ALint procBufs = AL::Source::getProcBufferCount(alSrc);
+
+	while (procBufs--)
 	{
-		shState->rtData().syncPoint.passSecondarySync();
+		AL::Buffer::ID buf = AL::Source::unqueueBuffer(alSrc);
 
-		ALint procBufs = AL::Source::getProcBufferCount(alSrc);
+		/* If something went wrong, try again later */
+		if (buf == AL::Buffer::ID(0))
+			break;
+
+		if (!queuedFrames.empty())
+			queuedFrames.pop_front();
 
-		while (procBufs--)
+		if (buf == lastBuf)
+		{
+			/* Reset the processed sample count so
+			 * querying the playback offset returns 0.0 again */
+			procFrames = source->loopStartFrames();
+			lastBuf = AL::Buffer::ID(0);
+		}
+		else
 		{
-			if (threadTermReq)
-				break;
+			/* Add the frame count contained in this
+			 * buffer to the total count */
+			ALint bits = AL::Buffer::getBits(buf);
+			ALint size = AL::Buffer::getSize(buf);
+			ALint chan = AL::Buffer::getChannels(buf);
+
+			if (bits != 0 && chan != 0)
+				procFrames += ((size / (bits / 8)) / chan);
+		}
 
-			AL::Buffer::ID buf = AL::Source::unqueueBuffer(alSrc);
+		if (sourceExhausted)
+			continue;
 
-			/* If something went wrong, try again later */
-			if (buf == AL::Buffer::ID(0))
-				break;
+		status = source->fillBuffer(buf);
 
-			if (buf == lastBuf)
-			{
-				/* Reset the processed sample count so
-				 * querying the playback offset returns 0.0 again */
-				procFrames = source->loopStartFrames();
-				lastBuf = AL::Buffer::ID(0);
-			}
-			else
-			{
-				/* Add the frame count contained in this
-				 * buffer to the total count */
-				ALint bits = AL::Buffer::getBits(buf);
-				ALint size = AL::Buffer::getSize(buf);
-				ALint chan = AL::Buffer::getChannels(buf);
-
-				if (bits != 0 && chan != 0)
-					procFrames += ((size / (bits / 8)) / chan);
-			}
+		if (status == ALDataSource::Error)
+		{
+			sourceExhausted.set();
+			return false;
+		}
 
-			if (sourceExhausted)
-				continue;
+		queueBuffer(buf);
 
-			status = source->fillBuffer(buf);
+		/* In case of buffer underrun,
+		 * start playing again */
+		if (AL::Source::getState(alSrc) == AL_STOPPED)
+			AL::Source::play(alSrc);
 
-			if (status == ALDataSource::Error)
-			{
-				sourceExhausted.set();
-				return;
-			}
+		/* If this was the last buffer before the data
+		 * source loop wrapped around again, mark it as
+		 * such so we can catch it and reset the processed
+		 * sample count once it gets unqueued */
+		if (status == ALDataSource::WrapAround)
+			lastBuf = buf;
 
-			AL::Source::queueBuffer(alSrc, buf);
+		if (status == ALDataSource::EndOfStream)
+			sourceExhausted.set();
+	}
 
-			/* In case of buffer underrun,
-			 * start playing again */
-			if (AL::Source::getState(alSrc) == AL_STOPPED)
-				AL::Source::play(alSrc);
+	return true;
+}
 
-			/* If this was the last buffer before the data
-			 * source loop wrapped around again, mark it as
-			 * such so we can catch it and reset the processed
-			 * sample count once it gets unqueued */
-			if (status == ALDataSource::WrapAround)
-				lastBuf = buf;
+/* Milliseconds until the buffer at the front of the queue
+ * is used up and can be refilled, or -1 if there's nothing
+ * to do until 'play()' wakes the stream up again */
+int32_t ALStream::refillDelay()
+{
+	ALint alState = AL::Source::getState(alSrc);
 
-			if (status == ALDataSource::EndOfStream)
-				sourceExhausted.set();
-		}
+	/* Paused, possibly before playback even started */
+	if (alState == AL_PAUSED || alState == AL_INITIAL)
+		return -1;
 
-		if (threadTermReq)
-			break;
+	/* Played to the end */
+	if (sourceExhausted && (queuedFrames.empty() || alState == AL_STOPPED))
+		return -1;
+
+	/* Buffer underrun, 'refillQueue()' restarts the source */
+	if (queuedFrames.empty() || alState != AL_PLAYING)
+		return AUDIO_SLEEP;
+
+	ALint offset = AL::Source::getInteger(alSrc, AL_SAMPLE_OFFSET);
+	ALint remaining = std::max(queuedFrames.front() - offset, 0);
+
+	float rate = source->sampleRate() * alPitch;
+
+	if (rate <= 0)
+		return AUDIO_SLEEP;
+
+	/* Round up, waking early would only find nothing to do */
+	return (int32_t) (remaining * 1000 / rate) + 1;
+}
 
-		SDL_Delay(AUDIO_SLEEP);
+int32_t ALStream::service()
+{
+	if (!streamInited)
+	{
+		if (!fillQueue())
+			return -1;
 	}
+	else if (!refillQueue())
+	{
+		return -1;
+	}
+
+	return refillDelay();
 }
@@ -23,8 +23,10 @@
 #define ALSTREAM_H
 
 #include "al-util.h"
+#include "audioscheduler.h"
 #include "sdl-util.h"
 
+#include <deque>
 #include <string>
 #include <SDL_rwops.h>
 
@@ -32,9 +34,10 @@ struct ALDataSource;
 
 #define STREAM_BUFS 3
 
-/* State-machine like audio playback stream.
+/* State-machine like audio playback stream. Buffers are
+ * filled on the AudioScheduler thread.
  * This class is NOT thread safe */
-struct ALStream
+struct ALStream : AudioScheduler::Task
 {
 	enum State
 	{
@@ -48,9 +51,7 @@ struct ALStream
 	State state;
 
 	ALDataSource *source;
-	SDL_Thread *thread;
-
-	std::string threadName;
+	AudioScheduler &scheduler;
 
 	SDL_mutex *pauseMut;
 	bool preemptPause;
@@ -61,12 +62,13 @@ struct ALStream
 	AtomicFlag streamInited;
 	AtomicFlag sourceExhausted;
 
-	AtomicFlag threadTermReq;
-
 	AtomicFlag needsRewind;
 	float startOffset;
 
 	float pitch;
+	/* Pitch applied by OpenAL (as opposed to the
+	 * data source), scales the consumption rate */
+	float alPitch;
 
 	AL::Source::ID alSrc;
 	AL::Buffer::ID alBuf[STREAM_BUFS];
@@ -74,6 +76,10 @@ struct ALStream
 	uint64_t procFrames;
 	AL::Buffer::ID lastBuf;
 
+	/* Frame counts of the buffers currently
+	 * queued on alSrc, in playback order */
+	std::deque<ALint> queuedFrames;
+
 	SDL_RWops srcOps;
 
 	struct
@@ -89,7 +95,7 @@ struct ALStream
 	};
 
 	ALStream(LoopMode loopMode,
-	         const std::string &threadId);
+	         AudioScheduler &scheduler);
 	~ALStream();
 
 	void close();
@@ -115,8 +121,13 @@ private:
 
 	void checkStopped();
 
-	/* thread func */
-	void streamData();
+	void queueBuffer(AL::Buffer::ID buf);
+	bool fillQueue();
+	bool refillQueue();
+	int32_t refillDelay();
+
+	/* Called on the scheduler thread */
+	int32_t service();
 };
 
 #endif // ALSTREAM_H
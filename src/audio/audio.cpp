@@ -21,30 +21,31 @@
 
 #include "audio.h"
 
+#include "audioscheduler.h"
 #include "audiostream.h"
 #include "soundemitter.h"
 #include "sharedstate.h"
 #include "sharedmidistate.h"
+#include "decodepool.h"
 #include "eventthread.h"
 #include "sdl-util.h"
 #include "exception.h"
 
+#include <stdint.h>
 #include <string>
 #include <vector>
 
-#include <SDL_thread.h>
-#include <SDL_timer.h>
-
-struct AudioPrivate
+struct AudioPrivate : AudioScheduler::Task
 {
+	/* Services all streams below, as well as the MeWatch.
+	 * Declared first so it outlives them */
+	AudioScheduler scheduler;
     
     std::vector<AudioStream*> bgmTracks;
 	AudioStream bgs;
 	AudioStream me;
 
 	SoundEmitter se;
-
-	SyncPoint &syncPoint;
     
     float volumeRatio;
 
@@ -63,32 +64,28 @@ struct AudioPrivate
 
 	struct
 	{
-		SDL_Thread *thread;
-		AtomicFlag termReq;
 		MeWatchState state;
 	} meWatch;
 
 	AudioPrivate(RGSSThreadData &rtData)
-	    : bgs(ALStream::Looped, "bgs"),
-	      me(ALStream::NotLooped, "me"),
+	    : scheduler(rtData.syncPoint, rtData.config.audioRefillInterval),
+	      bgs(ALStream::Looped, "bgs", scheduler),
+	      me(ALStream::NotLooped, "me", scheduler),
 	      se(rtData.config),
-	      syncPoint(rtData.syncPoint),
           volumeRatio(1)
 	{
         for (int i = 0; i < rtData.config.BGM.trackCount; i++) {
             std::string id = std::string("bgm" + std::to_string(i));
-            bgmTracks.push_back(new AudioStream(ALStream::Looped, id.c_str()));
+            bgmTracks.push_back(new AudioStream(ALStream::Looped, id.c_str(), scheduler));
         }
         
 		meWatch.state = MeNotPlaying;
-		meWatch.thread = createSDLThread
-			<AudioPrivate, &AudioPrivate::meWatchFun>(this, "audio_mewatch");
+		scheduler.wake(this);
 	}
 
 	~AudioPrivate()
 	{
-		meWatch.termReq.set();
-		SDL_WaitThread(meWatch.thread, 0);
+		scheduler.remove(this);
         for (auto track : bgmTracks)
             delete track;
 	}
@@ -101,186 +98,183 @@ struct AudioPrivate
         return bgmTracks[index];
     }
 
-	void meWatchFun()
+	/* MeWatch step, called on the scheduler thread */
+	int32_t service()
 	{
 		const float fadeOutStep = 1.f / (200  / AUDIO_SLEEP);
 		const float fadeInStep  = 1.f / (1000 / AUDIO_SLEEP);
 
-		while (true)
+		switch (meWatch.state)
 		{
-			syncPoint.passSecondarySync();
-
-			if (meWatch.termReq)
-				return;
+		case MeNotPlaying:
+		{
+			me.lockStream();
 
-			switch (meWatch.state)
-			{
-			case MeNotPlaying:
+			if (me.stream.queryState() == ALStream::Playing)
 			{
-				me.lockStream();
+				/* ME playing detected. -> FadeOutBGM */
+                for (auto track : bgmTracks)
+                    track->extPaused = true;
+                
+				meWatch.state = BgmFadingOut;
+			}
 
-				if (me.stream.queryState() == ALStream::Playing)
-				{
-					/* ME playing detected. -> FadeOutBGM */
-                    for (auto track : bgmTracks)
-                        track->extPaused = true;
-                    
-					meWatch.state = BgmFadingOut;
-				}
+			me.unlockStream();
 
-				me.unlockStream();
+			break;
+		}
 
-				break;
-			}
+		case BgmFadingOut :
+		{
+			me.lockStream();
 
-			case BgmFadingOut :
+			if (me.stream.queryState() != ALStream::Playing)
 			{
-				me.lockStream();
-
-				if (me.stream.queryState() != ALStream::Playing)
-				{
-					/* ME has ended while fading OUT BGM. -> FadeInBGM */
-					me.unlockStream();
-					meWatch.state = BgmFadingIn;
+				/* ME has ended while fading OUT BGM. -> FadeInBGM */
+				me.unlockStream();
+				meWatch.state = BgmFadingIn;
 
-					break;
-				}
+				break;
+			}
+            
+            bool shouldBreak = false;
+            
+            for (int i = 0; i < (int)(bgmTracks.size()); i++) {
+                AudioStream *track = bgmTracks[i];
                 
-                bool shouldBreak = false;
+                track->lockStream();
                 
-                for (int i = 0; i < (int)(bgmTracks.size()); i++) {
-                    AudioStream *track = bgmTracks[i];
+                float vol = track->getVolume(AudioStream::External);
+                vol -= fadeOutStep;
+                
+                if (vol < 0 || track->stream.queryState() != ALStream::Playing) {
+                    /* Either BGM has fully faded out, or stopped midway. -> MePlaying */
+                    track->setVolume(AudioStream::External, 0);
+                    track->stream.pause();
+                    track->unlockStream();
                     
+                    // check to see if there are any tracks still playing,
+                    // and if the last one was ended this round, this branch should exit
+                    std::vector<AudioStream*> playingTracks;
+                    for (auto t : bgmTracks)
+                        if (t->stream.queryState() == ALStream::Playing)
+                            playingTracks.push_back(t);
+                    
+                    
+                    if (playingTracks.size() <= 0 && !shouldBreak) shouldBreak = true;
+                    continue;
+                }
+                
+                track->setVolume(AudioStream::External, vol);
+                track->unlockStream();
+                
+            }
+            if (shouldBreak) {
+                meWatch.state = MePlaying;
+                me.unlockStream();
+                break;
+            }
+            
+			me.unlockStream();
+
+			break;
+		}
+
+		case MePlaying :
+		{
+			me.lockStream();
+
+			if (me.stream.queryState() != ALStream::Playing)
+            {
+                /* ME has ended */
+                for (auto track : bgmTracks) {
                     track->lockStream();
+                    track->extPaused = false;
                     
-                    float vol = track->getVolume(AudioStream::External);
-                    vol -= fadeOutStep;
+                    ALStream::State sState = track->stream.queryState();
                     
-                    if (vol < 0 || track->stream.queryState() != ALStream::Playing) {
-                        /* Either BGM has fully faded out, or stopped midway. -> MePlaying */
-                        track->setVolume(AudioStream::External, 0);
-                        track->stream.pause();
-                        track->unlockStream();
-                        
-                        // check to see if there are any tracks still playing,
-                        // and if the last one was ended this round, this branch should exit
-                        std::vector<AudioStream*> playingTracks;
-                        for (auto t : bgmTracks)
-                            if (t->stream.queryState() == ALStream::Playing)
-                                playingTracks.push_back(t);
+                    if (sState == ALStream::Paused) {
+                        /* BGM is paused. -> FadeInBGM */
+                        track->stream.play();
+                        meWatch.state = BgmFadingIn;
+                    }
+                    else {
+                        /* BGM is stopped. -> MeNotPlaying */
+                        track->setVolume(AudioStream::External, 1.0f);
                         
+                        if (!track->noResumeStop)
+                            track->stream.play();
                         
-                        if (playingTracks.size() <= 0 && !shouldBreak) shouldBreak = true;
-                        continue;
+                        meWatch.state = MeNotPlaying;
                     }
                     
-                    track->setVolume(AudioStream::External, vol);
                     track->unlockStream();
-                    
                 }
-                if (shouldBreak) {
-                    meWatch.state = MePlaying;
-                    me.unlockStream();
-                    break;
-                }
-                
-				me.unlockStream();
-
-				break;
 			}
 
-			case MePlaying :
-			{
-				me.lockStream();
-
-				if (me.stream.queryState() != ALStream::Playing)
-                {
-                    /* ME has ended */
-                    for (auto track : bgmTracks) {
-                        track->lockStream();
-                        track->extPaused = false;
-                        
-                        ALStream::State sState = track->stream.queryState();
-                        
-                        if (sState == ALStream::Paused) {
-                            /* BGM is paused. -> FadeInBGM */
-                            track->stream.play();
-                            meWatch.state = BgmFadingIn;
-                        }
-                        else {
-                            /* BGM is stopped. -> MeNotPlaying */
-                            track->setVolume(AudioStream::External, 1.0f);
-                            
-                            if (!track->noResumeStop)
-                                track->stream.play();
-                            
-                            meWatch.state = MeNotPlaying;
-                        }
-                        
-                        track->unlockStream();
-                    }
-				}
+            me.unlockStream();
 
-                me.unlockStream();
+			break;
+		}
 
-				break;
-			}
+		case BgmFadingIn :
+		{
+            for (auto track : bgmTracks)
+                track->lockStream();
 
-			case BgmFadingIn :
+			if (bgmTracks[0]->stream.queryState() == ALStream::Stopped)
 			{
+				/* BGM stopped midway fade in. -> MeNotPlaying */
                 for (auto track : bgmTracks)
-                    track->lockStream();
+                    track->setVolume(AudioStream::External, 1.0f);
+				meWatch.state = MeNotPlaying;
+                for (auto track : bgmTracks)
+                    track->unlockStream();
 
-				if (bgmTracks[0]->stream.queryState() == ALStream::Stopped)
-				{
-					/* BGM stopped midway fade in. -> MeNotPlaying */
-                    for (auto track : bgmTracks)
-                        track->setVolume(AudioStream::External, 1.0f);
-					meWatch.state = MeNotPlaying;
-                    for (auto track : bgmTracks)
-                        track->unlockStream();
-
-					break;
-				}
-
-				me.lockStream();
-
-				if (me.stream.queryState() == ALStream::Playing)
-				{
-					/* ME started playing midway BGM fade in. -> FadeOutBGM */
-                    for (auto track : bgmTracks)
-                        track->extPaused = true;
-					meWatch.state = BgmFadingOut;
-					me.unlockStream();
-                    for (auto track : bgmTracks)
-                        track->unlockStream();
-
-					break;
-				}
-
-				float vol = bgmTracks[0]->getVolume(AudioStream::External);
-				vol += fadeInStep;
-
-				if (vol >= 1)
-				{
-					/* BGM fully faded in. -> MeNotPlaying */
-					vol = 1.0f;
-					meWatch.state = MeNotPlaying;
-				}
+				break;
+			}
 
-                for (auto track : bgmTracks)
-                    track->setVolume(AudioStream::External, vol);
+			me.lockStream();
 
+			if (me.stream.queryState() == ALStream::Playing)
+			{
+				/* ME started playing midway BGM fade in. -> FadeOutBGM */
+                for (auto track : bgmTracks)
+                    track->extPaused = true;
+				meWatch.state = BgmFadingOut;
 				me.unlockStream();
                 for (auto track : bgmTracks)
                     track->unlockStream();
 
 				break;
 			}
+
+			float vol = bgmTracks[0]->getVolume(AudioStream::External);
+			vol += fadeInStep;
+
+			if (vol >= 1)
+			{
+				/* BGM fully faded in. -> MeNotPlaying */
+				vol = 1.0f;
+				meWatch.state = MeNotPlaying;
 			}
 
-			SDL_Delay(AUDIO_SLEEP);
+            for (auto track : bgmTracks)
+                track->setVolume(AudioStream::External, vol);
+
+			me.unlockStream();
+            for (auto track : bgmTracks)
+                track->unlockStream();
+
+			break;
 		}
+		}
+
+		/* Nothing to watch until 'mePlay()' wakes us up */
+		if (meWatch.state == MeNotPlaying)
+			return -1;
+
+		return AUDIO_SLEEP;
 	}
 };
 
@@ -377,6 +371,7 @@ void Audio::mePlay(const char *filename,
                    int pitch)
 {
 	p->me.play(filename, volume, pitch);
+	p->scheduler.wake(p);
 }
 
 void Audio::meStop()
@@ -402,6 +397,21 @@ void Audio::seStop()
 	p->se.stop();
 }
 
+unsigned int Audio::sePreload(const std::vector<std::string> &filenames)
+{
+	return p->se.preload(filenames);
+}
+
+bool Audio::sePreloadDone(unsigned int handle)
+{
+	return shState->decodePool().batchDone(handle);
+}
+
+void Audio::seReleasePreload(unsigned int handle)
+{
+	shState->decodePool().releaseBatch(handle);
+}
+
 void Audio::setupMidi()
 {
 	shState->midiState().initIfNeeded(shState->config());
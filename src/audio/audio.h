@@ -22,6 +22,9 @@
 #ifndef AUDIO_H
 #define AUDIO_H
 
+#include <string>
+#include <vector>
+
 /* Concerning the 'pos' parameter:
  *   RGSS3 actually doesn't specify a format for this,
  *   it's only implied that it is a numerical value
@@ -66,6 +69,11 @@ public:
 	            int pitch = 100);
 	void seStop();
 
+	/* Returns a handle for 'sePreloadDone()' / 'seReleasePreload()' */
+	unsigned int sePreload(const std::vector<std::string> &filenames);
+	bool sePreloadDone(unsigned int handle);
+	void seReleasePreload(unsigned int handle);
+
 	void setupMidi();
 	float bgmPos(int track = 0);
 	float bgsPos();
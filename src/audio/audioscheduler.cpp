@@ -0,0 +1,216 @@
+/*
+** audioscheduler.cpp
+**
+** This file is part of mkxp.
+**
+** Copyright (C) 2013 - 2021 Amaryllis Kulla <ancurio@mapleshrine.eu>
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "audioscheduler.h"
+
+#include "eventthread.h"
+#include "sdl-util.h"
+
+#include <SDL_mutex.h>
+#include <SDL_thread.h>
+#include <SDL_timer.h>
+
+#include <algorithm>
+#include <vector>
+
+struct ScheduledTask
+{
+	AudioScheduler::Task *task;
+	uint32_t deadline;
+
+	/* 'wake()' was called while the task was running */
+	bool rewoken;
+};
+
+struct AudioSchedulerPrivate
+{
+	SyncPoint &syncPoint;
+	const uint32_t maxSleep;
+
+	SDL_mutex *mutex;
+	/* Signaled when the schedule changes, or a task finished running */
+	SDL_cond *cond;
+
+	SDL_Thread *thread;
+	SDL_threadID threadId;
+
+	/* Only ever a handful of streams, a linear scan is fine */
+	std::vector<ScheduledTask> tasks;
+	AudioScheduler::Task *running;
+
+	bool quit;
+
+	AudioSchedulerPrivate(SyncPoint &syncPoint, uint32_t maxSleep)
+	    : syncPoint(syncPoint),
+	      maxSleep(maxSleep),
+	      threadId(0),
+	      running(0),
+	      quit(false)
+	{
+		mutex = SDL_CreateMutex();
+		cond = SDL_CreateCond();
+	}
+
+	~AudioSchedulerPrivate()
+	{
+		SDL_DestroyCond(cond);
+		SDL_DestroyMutex(mutex);
+	}
+
+	int find(AudioScheduler::Task *task) const
+	{
+		for (size_t i = 0; i < tasks.size(); ++i)
+			if (tasks[i].task == task)
+				return i;
+
+		return -1;
+	}
+
+	/* Index of the task due the earliest, or -1 */
+	int findNext() const
+	{
+		int next = -1;
+
+		for (size_t i = 0; i < tasks.size(); ++i)
+		{
+			if (next < 0 || (int32_t) (tasks[i].deadline - tasks[next].deadline) < 0)
+				next = i;
+		}
+
+		return next;
+	}
+
+	void threadFun()
+	{
+		SDL_LockMutex(mutex);
+		threadId = SDL_ThreadID();
+
+		while (true)
+		{
+			/* Hold still while the window is in the background */
+			SDL_UnlockMutex(mutex);
+			syncPoint.passSecondarySync();
+			SDL_LockMutex(mutex);
+
+			if (quit)
+				break;
+
+			int next = findNext();
+
+			if (next < 0)
+			{
+				SDL_CondWait(cond, mutex);
+				continue;
+			}
+
+			int32_t wait = tasks[next].deadline - SDL_GetTicks();
+
+			if (wait > 0)
+			{
+				SDL_CondWaitTimeout(cond, mutex, wait);
+				continue;
+			}
+
+			AudioScheduler::Task *task = tasks[next].task;
+			tasks[next].rewoken = false;
+			running = task;
+
+			SDL_UnlockMutex(mutex);
+			int32_t delay = task->service();
+			SDL_LockMutex(mutex);
+
+			running = 0;
+			SDL_CondBroadcast(cond);
+
+			/* The task may have been removed (and even rescheduled)
+			 * by another task in the meantime, don't overrule that */
+			int index = find(task);
+
+			if (index < 0)
+				continue;
+
+			/* Being woken while running overrules parking,
+			 * whatever woke it happened after the check */
+			if (tasks[index].rewoken)
+				continue;
+
+			if (delay < 0)
+				tasks.erase(tasks.begin() + index);
+			else
+				tasks[index].deadline = SDL_GetTicks() + std::min<uint32_t>(delay, maxSleep);
+		}
+
+		SDL_UnlockMutex(mutex);
+	}
+};
+
+AudioScheduler::AudioScheduler(SyncPoint &syncPoint, uint32_t maxSleep)
+{
+	p = new AudioSchedulerPrivate(syncPoint, maxSleep);
+	p->thread = createSDLThread
+		<AudioSchedulerPrivate, &AudioSchedulerPrivate::threadFun>(p, "audio_scheduler");
+}
+
+AudioScheduler::~AudioScheduler()
+{
+	SDL_LockMutex(p->mutex);
+	p->quit = true;
+	SDL_CondBroadcast(p->cond);
+	SDL_UnlockMutex(p->mutex);
+
+	SDL_WaitThread(p->thread, 0);
+
+	delete p;
+}
+
+void AudioScheduler::wake(Task *task)
+{
+	SDL_LockMutex(p->mutex);
+
+	ScheduledTask entry = { task, SDL_GetTicks(), p->running == task };
+	int index = p->find(task);
+
+	if (index < 0)
+		p->tasks.push_back(entry);
+	else
+		p->tasks[index] = entry;
+
+	SDL_CondBroadcast(p->cond);
+	SDL_UnlockMutex(p->mutex);
+}
+
+void AudioScheduler::remove(Task *task)
+{
+	SDL_LockMutex(p->mutex);
+
+	int index = p->find(task);
+
+	if (index >= 0)
+		p->tasks.erase(p->tasks.begin() + index);
+
+	/* A task unscheduling itself from within 'service()'
+	 * can't wait for that to return */
+	if (SDL_ThreadID() != p->threadId)
+		while (p->running == task)
+			SDL_CondWait(p->cond, p->mutex);
+
+	SDL_UnlockMutex(p->mutex);
+}
@@ -0,0 +1,65 @@
+/*
+** audioscheduler.h
+**
+** This file is part of mkxp.
+**
+** Copyright (C) 2013 - 2021 Amaryllis Kulla <ancurio@mapleshrine.eu>
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef AUDIOSCHEDULER_H
+#define AUDIOSCHEDULER_H
+
+#include <stdint.h>
+
+struct SyncPoint;
+struct AudioSchedulerPrivate;
+
+/* A single thread servicing every audio stream (and the MeWatch)
+ * instead of each one polling on a thread of its own. Every task
+ * reports when it next needs attention, and the thread sleeps
+ * until the earliest such deadline, or until woken up early. */
+class AudioScheduler
+{
+public:
+	struct Task
+	{
+		virtual ~Task() {}
+
+		/* Called on the scheduler thread. Returns the number of
+		 * milliseconds until the task wants to run again, or a
+		 * negative value to be unscheduled until the next 'wake()'
+		 * (unless that happened while it was running) */
+		virtual int32_t service() = 0;
+	};
+
+	/* No task sleeps longer than 'maxSleep' ms between runs */
+	AudioScheduler(SyncPoint &syncPoint, uint32_t maxSleep);
+	~AudioScheduler();
+
+	/* Schedules 'task' to run as soon as possible; if it
+	 * already is scheduled, moves its deadline up to now */
+	void wake(Task *task);
+
+	/* Unschedules 'task', waiting for it to finish running first
+	 * if necessary. Afterwards 'service()' won't be called again
+	 * until the next 'wake()' */
+	void remove(Task *task);
+
+private:
+	AudioSchedulerPrivate *p;
+};
+
+#endif // AUDIOSCHEDULER_H
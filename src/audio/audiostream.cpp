@@ -29,10 +29,11 @@
 #include <SDL_timer.h>
 
 AudioStream::AudioStream(ALStream::LoopMode loopMode,
-                         const std::string &threadId)
+                         const std::string &threadId,
+                         AudioScheduler &scheduler)
 	: extPaused(false),
 	  noResumeStop(false),
-	  stream(loopMode, threadId)
+	  stream(loopMode, scheduler)
 {
 	current.volume = 1.0f;
 	current.pitch = 1.0f;
@@ -121,7 +121,8 @@ struct AudioStream
 	} fadeIn;
 
 	AudioStream(ALStream::LoopMode loopMode,
-	            const std::string &threadId);
+	            const std::string &threadId,
+	            AudioScheduler &scheduler);
 	~AudioStream();
 
 	void play(const std::string &filename,
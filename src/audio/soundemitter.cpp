@@ -27,10 +27,11 @@
 #include "config.h"
 #include "util.h"
 #include "debugwriter.h"
+#include "decodepool.h"
 
 #include <SDL_sound.h>
 
-#define SE_CACHE_MEM (10*1024*1024) // 10 MB
+#include <algorithm>
 
 struct SoundBuffer
 {
@@ -39,7 +40,8 @@ struct SoundBuffer
 
 	AL::Buffer::ID alBuffer;
 
-	/* Link into the buffer cache priority list */
+	/* Link into the buffer cache priority list
+	 * (most recently played at the front) */
 	IntruListLink<SoundBuffer> link;
 
 	/* Buffer byte count */
@@ -90,6 +92,7 @@ arrayPushBack(std::vector<size_t> &array, size_t size, size_t index)
 
 SoundEmitter::SoundEmitter(const Config &conf)
     : bufferBytes(0),
+      cacheBytes((uint32_t) conf.SE.cacheSize * 1024 * 1024),
       srcCount(conf.SE.sourceCount),
       alSrcs(srcCount),
       atchBufs(srcCount),
@@ -184,12 +187,25 @@ void SoundEmitter::stop()
 		AL::Source::stop(alSrcs[i]);
 }
 
+/* Decoded PCM data, ready to be uploaded into an AL buffer */
+struct SoundData
+{
+	std::vector<uint8_t> samples;
+	ALenum format;
+	int rate;
+};
+
 struct SoundOpenHandler : FileSystem::OpenHandler
 {
-	SoundBuffer *buffer;
+	SoundData &data;
+	bool decoded;
 
-	SoundOpenHandler()
-	    : buffer(0)
+	/* SDL_sound errors are per thread */
+	std::string error;
+
+	SoundOpenHandler(SoundData &data)
+	    : data(data),
+	      decoded(false)
 	{}
 
 	bool tryRead(SDL_RWops &ops, const char *ext)
@@ -198,6 +214,8 @@ struct SoundOpenHandler : FileSystem::OpenHandler
 
 		if (!sample)
 		{
+			const char *err = Sound_GetError();
+			error = err ? err : "";
 			SDL_RWclose(&ops);
 			return false;
 		}
@@ -208,20 +226,83 @@ struct SoundOpenHandler : FileSystem::OpenHandler
 		uint8_t sampleSize = formatSampleSize(sample->actual.format);
 		uint32_t sampleCount = decBytes / sampleSize;
 
-		buffer = new SoundBuffer;
-		buffer->bytes = sampleSize * sampleCount;
-
-		ALenum alFormat = chooseALFormat(sampleSize, sample->actual.channels);
-
-		AL::Buffer::uploadData(buffer->alBuffer, alFormat, sample->buffer,
-							   buffer->bytes, sample->actual.rate);
+		const uint8_t *samples = static_cast<const uint8_t*>(sample->buffer);
+		data.samples.assign(samples, samples + sampleSize * sampleCount);
+		data.format = chooseALFormat(sampleSize, sample->actual.channels);
+		data.rate = sample->actual.rate;
 
 		Sound_FreeSample(sample);
+		decoded = true;
 
 		return true;
 	}
 };
 
+/* Decodes a sound effect ahead of its first 'play()' */
+struct SoundDecodeJob : DecodePool::Job
+{
+	FileSystem &fs;
+	std::string filename;
+
+	SoundData data;
+	SoundOpenHandler handler;
+
+	bool thrown;
+	Exception::Type excType;
+	std::string excMsg;
+
+	SoundDecodeJob(FileSystem &fs, const std::string &filename)
+	    : fs(fs),
+	      filename(filename),
+	      handler(data),
+	      thrown(false),
+	      excType(Exception::MKXPError)
+	{}
+
+	void run()
+	{
+		try
+		{
+			fs.openRead(handler, filename.c_str());
+		}
+		catch (const Exception &e)
+		{
+			thrown = true;
+			excType = e.type;
+			excMsg = e.msg;
+		}
+	}
+};
+
+/* Preloads share the DecodePool with Bitmaps, keep their keys apart */
+static std::string preloadKey(const std::string &filename)
+{
+	std::string key = shState->fileSystem().normalize(filename.c_str(), false, false);
+
+	std::transform(key.begin(), key.end(), key.begin(), [](unsigned char c){
+		return std::tolower(c);
+	});
+
+	return "se:" + key;
+}
+
+unsigned int SoundEmitter::preload(const std::vector<std::string> &filenames)
+{
+	DecodePool &pool = shState->decodePool();
+	unsigned int batch = pool.newBatch();
+
+	for (size_t i = 0; i < filenames.size(); ++i)
+	{
+		if (bufferHash.contains(filenames[i]))
+			continue;
+
+		pool.enqueue(batch, preloadKey(filenames[i]),
+		             new SoundDecodeJob(shState->fileSystem(), filenames[i]));
+	}
+
+	return batch;
+}
+
 SoundBuffer *SoundEmitter::allocateBuffer(const std::string &filename)
 {
 	SoundBuffer *buffer = bufferHash.value(filename, 0);
@@ -231,33 +312,72 @@ SoundBuffer *SoundEmitter::allocateBuffer(const std::string &filename)
 		/* Buffer still in cashe.
 		 * Move to front of priority list */
 		buffers.remove(buffer->link);
-		buffers.append(buffer->link);
+		buffers.prepend(buffer->link);
 
 		return buffer;
 	}
 	else
 	{
-		/* Buffer not in cache, needs to be loaded */
-		SoundOpenHandler handler;
-		shState->fileSystem().openRead(handler, filename.c_str());
-		buffer = handler.buffer;
+		/* Buffer not in cache, needs to be loaded. If it
+		 * was preloaded, only the upload is left to do */
+		SoundData data;
+		std::string error;
+		bool decoded;
 
-		if (!buffer)
+		DecodePool::Job *job = shState->decodePool().take(preloadKey(filename));
+
+		if (job)
+		{
+			SoundDecodeJob *decodeJob = static_cast<SoundDecodeJob*>(job);
+
+			if (decodeJob->thrown)
+			{
+				Exception exc(decodeJob->excType, "%s", decodeJob->excMsg.c_str());
+				delete decodeJob;
+
+				throw exc;
+			}
+
+			data.samples.swap(decodeJob->data.samples);
+			data.format = decodeJob->data.format;
+			data.rate = decodeJob->data.rate;
+			decoded = decodeJob->handler.decoded;
+			error = decodeJob->handler.error;
+
+			delete decodeJob;
+		}
+		else
+		{
+			SoundOpenHandler handler(data);
+			shState->fileSystem().openRead(handler, filename.c_str());
+
+			decoded = handler.decoded;
+			error = handler.error;
+		}
+
+		if (!decoded)
 		{
 			char buf[512];
 			snprintf(buf, sizeof(buf), "Unable to decode sound: %s: %s",
-			         filename.c_str(), Sound_GetError());
+			         filename.c_str(), error.c_str());
 			Debug() << buf;
 
 			return 0;
 		}
 
+		buffer = new SoundBuffer;
 		buffer->key = filename;
+		buffer->bytes = data.samples.size();
+
+		AL::Buffer::uploadData(buffer->alBuffer, data.format,
+		                       data.samples.empty() ? 0 : &data.samples[0],
+		                       buffer->bytes, data.rate);
+
 		uint32_t wouldBeBytes = bufferBytes + buffer->bytes;
 
-		/* If memory limit is reached, delete lowest priority buffer
-		 * until there is room or no buffers left */
-		while (wouldBeBytes > SE_CACHE_MEM && !buffers.isEmpty())
+		/* If memory limit is reached, delete least recently played
+		 * buffers until there is room or no buffers left */
+		while (wouldBeBytes > cacheBytes && !buffers.isEmpty())
 		{
 			SoundBuffer *last = buffers.tail();
 			bufferHash.remove(last->key);
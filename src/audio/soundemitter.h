@@ -41,6 +41,7 @@ struct SoundEmitter
 
 	/* Byte count sum of all cached / playing buffers */
 	uint32_t bufferBytes;
+	const uint32_t cacheBytes;
 
 	const size_t srcCount;
 	std::vector<AL::Source::ID> alSrcs;
@@ -58,6 +59,11 @@ struct SoundEmitter
 
 	void stop();
 
+	/* Decodes 'filenames' on the DecodePool, so their first
+	 * 'play()' only has to upload the samples. Returns
+	 * the DecodePool batch the jobs were queued in */
+	unsigned int preload(const std::vector<std::string> &filenames);
+
 private:
 	SoundBuffer *allocateBuffer(const std::string &filename);
 };
@@ -130,11 +130,19 @@ void Config::read(int argc, char *argv[]) {
         {"rgssVersion", 0},
         {"debugMode", false},
         {"printFPS", false},
+        {"headless", false},
+        {"benchmarkFrames", 0},
+        {"benchmarkOutput", "benchmark.json"},
+        {"benchmarkDecrypt", false},
+        {"benchmarkPropertySets", 0},
+        {"profilerTrace", ""},
+        {"profilerOverlay", false},
         {"winResizable", true},
         {"fullscreen", false},
         {"fixedAspectRatio", true},
         {"smoothScaling", false},
         {"vsync", false},
+        {"presentThread", false},
         {"defScreenW", 0},
         {"defScreenH", 0},
         {"windowTitle", ""},
@@ -154,11 +162,18 @@ void Config::read(int argc, char *argv[]) {
         {"integerScalingActive", false},
         {"integerScalingLastMile", true},
         {"maxTextureSize", 0},
+        {"shaderCache", true},
+        {"texturePoolSize", 20},
+        {"bitmapCacheSize", 64},
+        {"textAtlas", true},
+        {"textCacheSize", 8},
+        {"deferPixelWrites", true},
         {"gameFolder", ""},
         {"anyAltToggleFS", false},
         {"enableReset", true},
         {"enableSettings", true},
         {"allowSymlinks", false},
+        {"mapArchives", true},
         {"dataPathOrg", ""},
         {"dataPathApp", ""},
         {"iconPath", ""},
@@ -167,7 +182,9 @@ void Config::read(int argc, char *argv[]) {
         {"midiChorus", false},
         {"midiReverb", false},
         {"SESourceCount", 6},
+        {"SECacheSize", 10},
         {"BGMTrackCount", 1},
+        {"audioRefillInterval", 100},
         {"customScript", ""},
         {"pathCache", true},
         {"useScriptNames", 1},
@@ -227,6 +244,7 @@ try { exp } catch (...) {}
     SET_STRINGOPT(iconPath, iconPath);
     SET_STRINGOPT(execName, execName);
     SET_OPT(allowSymlinks, boolean);
+    SET_OPT(mapArchives, boolean);
     SET_OPT_CUSTOMKEY(jit.enabled, JITEnable, boolean);
     SET_OPT_CUSTOMKEY(jit.verboseLevel, JITVerboseLevel, integer);
     SET_OPT_CUSTOMKEY(jit.maxCache, JITMaxCache, integer);
@@ -253,11 +271,19 @@ try { exp } catch (...) {}
     SET_OPT(pathCache, boolean);
     SET_OPT(debugMode, boolean);
     SET_OPT(printFPS, boolean);
+    SET_OPT(headless, boolean);
+    SET_OPT(benchmarkFrames, integer);
+    SET_STRINGOPT(benchmarkOutput, benchmarkOutput);
+    SET_OPT(benchmarkDecrypt, boolean);
+    SET_OPT(benchmarkPropertySets, integer);
+    SET_STRINGOPT(profilerTrace, profilerTrace);
+    SET_OPT(profilerOverlay, boolean);
     SET_OPT(fullscreen, boolean);
     SET_OPT(fixedAspectRatio, boolean);
     SET_OPT(smoothScaling, boolean);
     SET_OPT(winResizable, boolean);
     SET_OPT(vsync, boolean);
+    SET_OPT(presentThread, boolean);
     SET_STRINGOPT(windowTitle, windowTitle);
     SET_OPT(fixedFramerate, integer);
     SET_OPT(frameSkip, boolean);
@@ -269,6 +295,12 @@ try { exp } catch (...) {}
     SET_OPT_CUSTOMKEY(integerScaling.active, integerScalingActive, boolean);
     SET_OPT_CUSTOMKEY(integerScaling.lastMileScaling, integerScalingLastMile, boolean);
     SET_OPT(maxTextureSize, integer);
+    SET_OPT(shaderCache, boolean);
+    SET_OPT(texturePoolSize, integer);
+    SET_OPT(bitmapCacheSize, integer);
+    SET_OPT(textAtlas, boolean);
+    SET_OPT(textCacheSize, integer);
+    SET_OPT(deferPixelWrites, boolean);
     SET_OPT(anyAltToggleFS, boolean);
     SET_OPT(enableReset, boolean);
     SET_OPT(enableSettings, boolean);
@@ -276,7 +308,9 @@ try { exp } catch (...) {}
     SET_OPT_CUSTOMKEY(midi.chorus, midiChorus, boolean);
     SET_OPT_CUSTOMKEY(midi.reverb, midiReverb, boolean);
     SET_OPT_CUSTOMKEY(SE.sourceCount, SESourceCount, integer);
+    SET_OPT_CUSTOMKEY(SE.cacheSize, SECacheSize, integer);
     SET_OPT_CUSTOMKEY(BGM.trackCount, BGMTrackCount, integer);
+    SET_OPT(audioRefillInterval, integer);
     SET_STRINGOPT(customScript, customScript);
     SET_OPT(useScriptNames, boolean);
     
@@ -300,7 +334,9 @@ try { exp } catch (...) {}
     
     rgssVersion = clamp(rgssVersion, 0, 3);
     SE.sourceCount = clamp(SE.sourceCount, 1, 64);
+    SE.cacheSize = clamp(SE.cacheSize, 1, 1024);
     BGM.trackCount = clamp(BGM.trackCount, 1, 16);
+    audioRefillInterval = clamp(audioRefillInterval, 1, 1000);
     
     // Determine whether to open a console window on Windows, with force disable
 #ifndef HIDE_WINDOWS_CONSOLE
@@ -39,11 +39,21 @@ struct Config {
     std::string angleRenderer;
     bool printFPS;
     
+    bool headless;
+    int benchmarkFrames;
+    std::string benchmarkOutput;
+    bool benchmarkDecrypt;
+    int benchmarkPropertySets;
+    
+    std::string profilerTrace;
+    bool profilerOverlay;
+    
     bool winResizable;
     bool fullscreen;
     bool fixedAspectRatio;
     bool smoothScaling;
     bool vsync;
+    bool presentThread;
     
     int defScreenW;
     int defScreenH;
@@ -58,6 +68,12 @@ struct Config {
     bool subImageFix;
     bool enableBlitting;
     int maxTextureSize;
+    bool shaderCache;
+    int texturePoolSize;
+    int bitmapCacheSize;
+    bool textAtlas;
+    int textCacheSize;
+    bool deferPixelWrites;
     
     struct {
         bool active;
@@ -71,6 +87,7 @@ struct Config {
     bool enableReset;
     bool enableSettings;
     bool allowSymlinks;
+    bool mapArchives;
     bool pathCache;
     
     std::string dataPathOrg;
@@ -88,12 +105,15 @@ struct Config {
     
     struct {
         int sourceCount;
+        int cacheSize;
     } SE;
     
     struct {
         int trackCount;
     } BGM;
     
+    int audioRefillInterval;
+    
     bool useScriptNames;
     
     std::string customScript;
@@ -21,11 +21,40 @@
 
 #include "rgssad.h"
 #include "boost-hash.h"
+#include "debugwriter.h"
+
+#include <SDL_cpuinfo.h>
+#include <SDL_timer.h>
 
 #include <stdint.h>
 #include <string.h>
 
+#include <algorithm>
 #include <string>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define RGSS_SIMD_SSE2
+#include <emmintrin.h>
+#endif
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define RGSS_SIMD_AVX2
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define RGSS_SIMD_NEON
+#include <arm_neon.h>
+#endif
+
+#ifdef __linux__
+#define RGSS_HAVE_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 /* Equivalent Linear Congruential Generator (LCG) constants for iteration 2^n
  * all the way up to 2^32/4 (the largest dword offset possible in
@@ -60,38 +89,80 @@ struct RGSS_entryData
 	uint32_t startMagic;
 };
 
+/* Small reads (eg. from image decoders) are served from a
+ * decrypted window of the entry this large */
+#define READ_AHEAD_SIZE (256 * 1024)
+
+struct RGSS_archiveData
+{
+	PHYSFS_Io *archiveIo;
+
+	/* The whole archive file mapped into memory,
+	 * or null if reads have to go through 'archiveIo' */
+	const uint8_t *mapping;
+	uint64_t mappingSize;
+
+	/* Maps: file path
+	 * to:   entry data */
+	BoostHash<std::string, RGSS_entryData> entryHash;
+
+	/* Maps: directory path,
+	 * to:   list of contained entries */
+	BoostHash<std::string, BoostSet<std::string> > dirHash;
+
+	RGSS_archiveData(PHYSFS_Io *archiveIo)
+	    : archiveIo(archiveIo),
+	      mapping(0),
+	      mappingSize(0)
+	{}
+};
+
 struct RGSS_entryHandle
 {
 	const RGSS_entryData data;
-	uint32_t currentMagic;
 	uint64_t currentOffset;
+
+	/* Exactly one of these is set */
 	PHYSFS_Io *io;
+	const uint8_t *mapping;
+
+	/* Decrypted entry bytes starting at the
+	 * (dword aligned) entry offset 'bufOffset' */
+	std::vector<uint8_t> buffer;
+	uint64_t bufOffset;
+	uint64_t bufSize;
 
-	RGSS_entryHandle(const RGSS_entryData &data, PHYSFS_Io *archIo)
+	RGSS_entryHandle(const RGSS_entryData &data, const RGSS_archiveData &arch)
 	    : data(data),
-	      currentMagic(data.startMagic),
-	      currentOffset(0)
+	      currentOffset(0),
+	      io(0),
+	      mapping(0),
+	      bufOffset(0),
+	      bufSize(0)
 	{
-		io = archIo->duplicate(archIo);
+		if (arch.mapping && data.offset + data.size <= arch.mappingSize)
+			mapping = arch.mapping + data.offset;
+		else
+			io = arch.archiveIo->duplicate(arch.archiveIo);
 	}
 
-	~RGSS_entryHandle()
+	RGSS_entryHandle(const RGSS_entryHandle &other)
+	    : data(other.data),
+	      currentOffset(other.currentOffset),
+	      io(0),
+	      mapping(other.mapping),
+	      bufOffset(0),
+	      bufSize(0)
 	{
-		io->destroy(io);
+		if (other.io)
+			io = other.io->duplicate(other.io);
 	}
-};
-
-struct RGSS_archiveData
-{
-	PHYSFS_Io *archiveIo;
 
-	/* Maps: file path
-	 * to:   entry data */
-	BoostHash<std::string, RGSS_entryData> entryHash;
-
-	/* Maps: directory path,
-	 * to:   list of contained entries */
-	BoostHash<std::string, BoostSet<std::string> > dirHash;
+	~RGSS_entryHandle()
+	{
+		if (io)
+			io->destroy(io);
+	}
 };
 
 static bool
@@ -142,129 +213,346 @@ advanceMagicN(uint32_t &magic, uint32_t n) {
     return old;
 }
 
-static PHYSFS_sint64
-RGSS_ioRead(PHYSFS_Io *self, void *buffer, PHYSFS_uint64 len)
+/* Xor kernels. All of them decrypt 'count' little endian dwords
+ * at 'data' (no alignment required), starting with key 'magic'.
+ * The vectorized ones keep one LCG state per lane and step each
+ * lane by the lane count at once using the jump table. */
+typedef void (*XorDwordsFunc)(uint8_t *data, size_t count, uint32_t magic);
+
+static void
+xorDwordsScalar(uint8_t *data, size_t count, uint32_t magic)
 {
-	RGSS_entryHandle *entry = static_cast<RGSS_entryHandle*>(self->opaque);
+	for (size_t i = 0; i < count; ++i, data += 4)
+	{
+		uint32_t dword;
+		memcpy(&dword, data, 4);
+		dword ^= advanceMagic(magic);
+		memcpy(data, &dword, 4);
+	}
+}
 
-	PHYSFS_Io *io = entry->io;
+#ifdef RGSS_SIMD_SSE2
+/* SSE2 has no 32 bit lane multiply, emulate
+ * it with two 32x32->64 multiplies */
+static inline __m128i
+mullo32SSE2(__m128i a, __m128i b)
+{
+	__m128i even = _mm_mul_epu32(a, b);
+	__m128i odd  = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
 
-	uint64_t toRead = std::min<uint64_t>(entry->data.size - entry->currentOffset, len);
-	uint64_t offs = entry->currentOffset;
-
-	io->seek(io, entry->data.offset + offs);
-
-	/* We divide up the bytes to be read in 3 categories:
-	 *
-	 * preAlign: If the current read address is not dword
-	 *   aligned, this is the number of bytes to read til
-	 *   we reach alignment again (therefore can only be
-	 *   3 or less).
-	 *
-	 * align: The number of aligned dwords we can read
-	 *   times 4 (= number of bytes).
-	 *
-	 * postAlign: The number of bytes to read after the
-	 *   last aligned dword. Always 3 or less.
-	 *
-	 * Treating the pre- and post aligned reads specially,
-	 * we can read all aligned dwords in one syscall directly
-	 * into the write buffer and then run the xor chain on
-	 * it afterwards. */
-
-	uint8_t preAlign = 4 - (offs % 4);
-
-	if (preAlign == 4)
-		preAlign = 0;
-	else
-		preAlign = std::min<uint64_t>(preAlign, len);
+	return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+	                          _mm_shuffle_epi32(odd,  _MM_SHUFFLE(0, 0, 2, 0)));
+}
 
-	uint8_t postAlign = (len > preAlign) ? (offs + len) % 4 : 0;
+static void
+xorDwordsSSE2(uint8_t *data, size_t count, uint32_t magic)
+{
+	const size_t blocks = count / 4;
+	uint32_t lanes[4];
 
-	uint64_t align = len - (preAlign + postAlign);
+	uint32_t m = magic;
+	for (int i = 0; i < 4; ++i)
+		lanes[i] = advanceMagic(m);
 
-	/* Byte buffer pointer */
-	uint8_t *bBufferP = static_cast<uint8_t*>(buffer);
+	__m128i key = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lanes));
+	const __m128i mul = _mm_set1_epi32(LCG_TABLE[2][0]);
+	const __m128i add = _mm_set1_epi32(LCG_TABLE[2][1]);
 
-	if (preAlign > 0)
+	for (size_t i = 0; i < blocks; ++i, data += 16)
 	{
-		uint32_t dword;
-		io->read(io, &dword, preAlign);
+		__m128i *p = reinterpret_cast<__m128i*>(data);
+		_mm_storeu_si128(p, _mm_xor_si128(_mm_loadu_si128(p), key));
+		key = _mm_add_epi32(mullo32SSE2(key, mul), add);
+	}
+
+	advanceMagicN(magic, (uint32_t) (blocks * 4));
+	xorDwordsScalar(data, count % 4, magic);
+}
+#endif
 
-		/* Need to align the bytes with the
-		 * magic before xoring */
-		dword <<= 8 * (offs % 4);
-		dword ^= entry->currentMagic;
+#ifdef RGSS_SIMD_AVX2
+__attribute__((target("avx2"))) static void
+xorDwordsAVX2(uint8_t *data, size_t count, uint32_t magic)
+{
+	const size_t blocks = count / 8;
+	uint32_t lanes[8];
 
-		/* Shift them back to normal */
-		dword >>= 8 * (offs % 4);
-		memcpy(bBufferP, &dword, preAlign);
+	uint32_t m = magic;
+	for (int i = 0; i < 8; ++i)
+		lanes[i] = advanceMagic(m);
 
-		bBufferP += preAlign;
+	__m256i key = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(lanes));
+	const __m256i mul = _mm256_set1_epi32(LCG_TABLE[3][0]);
+	const __m256i add = _mm256_set1_epi32(LCG_TABLE[3][1]);
 
-		/* Only advance the magic if we actually
-		 * reached the next alignment */
-		if ((offs+preAlign) % 4 == 0)
-			advanceMagic(entry->currentMagic);
+	for (size_t i = 0; i < blocks; ++i, data += 32)
+	{
+		__m256i *p = reinterpret_cast<__m256i*>(data);
+		_mm256_storeu_si256(p, _mm256_xor_si256(_mm256_loadu_si256(p), key));
+		key = _mm256_add_epi32(_mm256_mullo_epi32(key, mul), add);
 	}
 
-	if (align > 0)
+	advanceMagicN(magic, (uint32_t) (blocks * 8));
+	xorDwordsScalar(data, count % 8, magic);
+}
+#endif
+
+#ifdef RGSS_SIMD_NEON
+static void
+xorDwordsNEON(uint8_t *data, size_t count, uint32_t magic)
+{
+	const size_t blocks = count / 4;
+	uint32_t lanes[4];
+
+	uint32_t m = magic;
+	for (int i = 0; i < 4; ++i)
+		lanes[i] = advanceMagic(m);
+
+	uint32x4_t key = vld1q_u32(lanes);
+	const uint32x4_t mul = vdupq_n_u32(LCG_TABLE[2][0]);
+	const uint32x4_t add = vdupq_n_u32(LCG_TABLE[2][1]);
+
+	for (size_t i = 0; i < blocks; ++i, data += 16)
 	{
-		/* Double word buffer pointer */
-		uint32_t *dwBufferP = reinterpret_cast<uint32_t*>(bBufferP);
+		uint32x4_t v = vreinterpretq_u32_u8(vld1q_u8(data));
+		vst1q_u8(data, vreinterpretq_u8_u32(veorq_u32(v, key)));
+		key = vmlaq_u32(add, key, mul);
+	}
+
+	advanceMagicN(magic, (uint32_t) (blocks * 4));
+	xorDwordsScalar(data, count % 4, magic);
+}
+#endif
+
+static XorDwordsFunc
+selectXorDwords()
+{
+#ifdef RGSS_SIMD_AVX2
+	if (SDL_HasAVX2())
+		return xorDwordsAVX2;
+#endif
+#ifdef RGSS_SIMD_SSE2
+	return xorDwordsSSE2;
+#elif defined(RGSS_SIMD_NEON)
+	return xorDwordsNEON;
+#else
+	return xorDwordsScalar;
+#endif
+}
+
+static const XorDwordsFunc xorDwords = selectXorDwords();
 
-		/* Read aligned dwords in one go */
-		io->read(io, bBufferP, align);
+void RGSS_benchmarkKernels()
+{
+	/* A synthetic archive body large enough to leave the caches */
+	const size_t size = 64 * 1024 * 1024;
+	const uint32_t startMagic = 0xDEADCAFE;
+	const int rounds = 8;
 
-		/* Then xor them */
-		for (uint64_t i = 0; i < (align / 4); ++i)
-			dwBufferP[i] ^= advanceMagic(entry->currentMagic);
+	std::vector<uint8_t> plain(size), buffer(size);
 
-		bBufferP += align;
+	uint32_t seed = 1;
+	for (size_t i = 0; i < size; ++i)
+	{
+		seed = seed * 1103515245 + 12345;
+		plain[i] = seed >> 16;
 	}
 
-	if (postAlign > 0)
+	/* Encrypt it with the reference kernel (the xor is symmetric) */
+	std::vector<uint8_t> encrypted(plain);
+	xorDwordsScalar(&encrypted[0], size / 4, startMagic);
+
+	struct Kernel
 	{
-		uint32_t dword;
-		io->read(io, &dword, postAlign);
+		const char *name;
+		XorDwordsFunc func;
+	};
+
+	std::vector<Kernel> kernels;
+	kernels.push_back({ "scalar", xorDwordsScalar });
+#ifdef RGSS_SIMD_SSE2
+	kernels.push_back({ "SSE2", xorDwordsSSE2 });
+#endif
+#ifdef RGSS_SIMD_AVX2
+	if (SDL_HasAVX2())
+		kernels.push_back({ "AVX2", xorDwordsAVX2 });
+#endif
+#ifdef RGSS_SIMD_NEON
+	kernels.push_back({ "NEON", xorDwordsNEON });
+#endif
+
+	const double freq = SDL_GetPerformanceFrequency();
+
+	for (size_t k = 0; k < kernels.size(); ++k)
+	{
+		double best = 0;
+		bool valid = true;
+
+		for (int r = 0; r < rounds; ++r)
+		{
+			memcpy(&buffer[0], &encrypted[0], size);
+
+			const Uint64 start = SDL_GetPerformanceCounter();
+			kernels[k].func(&buffer[0], size / 4, startMagic);
+			const double secs = (SDL_GetPerformanceCounter() - start) / freq;
+
+			if (secs > 0 && (best == 0 || secs < best))
+				best = secs;
 
-		/* Bytes are already aligned with magic */
-		dword ^= entry->currentMagic;
-		memcpy(bBufferP, &dword, postAlign);
+			valid = valid && memcmp(&buffer[0], &plain[0], size) == 0;
+		}
+
+		Debug() << "RGSS decrypt" << kernels[k].name << ":"
+		        << (best > 0 ? (size / (1024.0 * 1024.0)) / best : 0) << "MB/s"
+		        << (kernels[k].func == xorDwords ? "(selected)" : "")
+		        << (valid ? "" : "MISMATCH");
 	}
+}
 
-	entry->currentOffset += toRead;
+/* Decrypts 'len' bytes in place that were read
+ * from the (arbitrary) entry offset 'offs' */
+static void
+decryptInPlace(const RGSS_entryHandle *entry, uint64_t offs, uint8_t *dst, uint64_t len)
+{
+	uint32_t magic = entry->data.startMagic;
+	advanceMagicN(magic, (uint32_t) (offs / 4));
+
+	uint64_t i = 0;
+
+	/* Leading bytes up to the next dword boundary */
+	if (offs % 4)
+	{
+		const uint32_t key = advanceMagic(magic);
 
-	return toRead;
+		for (; i < len && (offs + i) % 4; ++i)
+			dst[i] ^= (key >> 8 * ((offs + i) % 4)) & 0xFF;
+	}
+
+	const uint64_t dwords = (len - i) / 4;
+
+	xorDwords(dst + i, dwords, magic);
+	advanceMagicN(magic, (uint32_t) dwords);
+	i += dwords * 4;
+
+	/* Trailing partial dword */
+	for (int shift = 0; i < len; ++i, shift += 8)
+		dst[i] ^= (magic >> shift) & 0xFF;
 }
 
-static int
-RGSS_ioSeek(PHYSFS_Io *self, PHYSFS_uint64 offset)
+/* Reads and decrypts 'len' bytes at the entry offset 'offs' */
+static uint64_t
+readDecrypted(RGSS_entryHandle *entry, uint64_t offs, uint8_t *dst, uint64_t len)
 {
-	RGSS_entryHandle *entry = static_cast<RGSS_entryHandle*>(self->opaque);
+	PHYSFS_Io *io = entry->io;
 
-	if (offset == entry->currentOffset)
-		return 1;
+	if (!io->seek(io, entry->data.offset + offs))
+		return 0;
+
+	PHYSFS_sint64 result = io->read(io, dst, len);
+
+	if (result <= 0)
+		return 0;
+
+	decryptInPlace(entry, offs, dst, result);
+
+	return result;
+}
+
+static bool
+fillReadAhead(RGSS_entryHandle *entry, uint64_t offs)
+{
+	offs &= ~3ULL;
+
+	uint64_t len = std::min<uint64_t>(READ_AHEAD_SIZE, entry->data.size - offs);
+
+	if (entry->buffer.size() < len)
+		entry->buffer.resize(len);
 
-	if (offset > entry->data.size-1)
+	entry->bufOffset = offs;
+	entry->bufSize = readDecrypted(entry, offs, &entry->buffer[0], len);
+
+	return entry->bufSize > 0;
+}
+
+static PHYSFS_sint64
+RGSS_ioRead(PHYSFS_Io *self, void *buffer, PHYSFS_uint64 len)
+{
+	RGSS_entryHandle *entry = static_cast<RGSS_entryHandle*>(self->opaque);
+
+	if (entry->currentOffset >= entry->data.size)
 		return 0;
 
-	/* If rewinding, we need to rewind to begining */
-	if (offset < entry->currentOffset)
+	uint64_t toRead = std::min<uint64_t>(entry->data.size - entry->currentOffset, len);
+	uint8_t *dst = static_cast<uint8_t*>(buffer);
+	uint64_t done = 0;
+
+	/* Mapped archives need neither syscalls nor read-ahead,
+	 * decrypt directly into the caller's buffer */
+	if (entry->mapping)
 	{
-		entry->currentOffset = 0;
-		entry->currentMagic = entry->data.startMagic;
+		memcpy(dst, entry->mapping + entry->currentOffset, toRead);
+		decryptInPlace(entry, entry->currentOffset, dst, toRead);
+
+		entry->currentOffset += toRead;
+
+		return toRead;
 	}
 
-	/* For each overstepped alignment, advance magic */
-	uint64_t currentDword = entry->currentOffset / 4;
-	uint64_t targetDword  = offset / 4;
-	uint64_t dwordsSought = targetDword - currentDword;
+	while (done < toRead)
+	{
+		uint64_t offs = entry->currentOffset;
+		uint64_t remaining = toRead - done;
+
+		/* Serve what we can from the read-ahead window */
+		if (offs >= entry->bufOffset && offs < entry->bufOffset + entry->bufSize)
+		{
+			uint64_t avail = entry->bufOffset + entry->bufSize - offs;
+			uint64_t n = std::min(avail, remaining);
+
+			memcpy(dst + done, &entry->buffer[offs - entry->bufOffset], n);
+
+			entry->currentOffset += n;
+			done += n;
+
+			continue;
+		}
+
+		/* Large aligned reads bypass the window and are
+		 * decrypted in place in the caller's buffer */
+		if (offs % 4 == 0 && remaining >= READ_AHEAD_SIZE)
+		{
+			uint64_t n = readDecrypted(entry, offs, dst + done, remaining & ~3ULL);
 
-	advanceMagicN(entry->currentMagic, (uint32_t) dwordsSought);
+			if (n == 0)
+				break;
 
+			entry->currentOffset += n;
+			done += n;
+
+			continue;
+		}
+
+		if (!fillReadAhead(entry, offs))
+			break;
+	}
+
+	return done;
+}
+
+static int
+RGSS_ioSeek(PHYSFS_Io *self, PHYSFS_uint64 offset)
+{
+	RGSS_entryHandle *entry = static_cast<RGSS_entryHandle*>(self->opaque);
+
+	if (offset == entry->currentOffset)
+		return 1;
+
+	if (offset > entry->data.size)
+		return 0;
+
+	/* Reads derive the magic from the offset,
+	 * so there's nothing else to keep track of */
 	entry->currentOffset = offset;
-	entry->io->seek(entry->io, entry->data.offset + entry->currentOffset);
 
 	return 1;
 }
@@ -375,8 +663,64 @@ verifyHeader(PHYSFS_Io *io, char version)
 	return true;
 }
 
+static bool mapArchives = false;
+
+void
+RGSS_setMapArchives(bool enable)
+{
+	mapArchives = enable;
+}
+
+/* Maps the archive file into memory if enabled and possible.
+ * 'filename' is only a native path if the archive wasn't found
+ * inside another archive, so verify it matches what we parsed */
+static void
+mapArchive(RGSS_archiveData *data, const char *filename, char version)
+{
+#ifdef RGSS_HAVE_MMAP
+	if (!mapArchives || !filename)
+		return;
+
+	int fd = open(filename, O_RDONLY);
+
+	if (fd < 0)
+		return;
+
+	struct stat st;
+	PHYSFS_Io *io = data->archiveIo;
+
+	if (fstat(fd, &st) != 0 || st.st_size <= 8 ||
+	    (PHYSFS_sint64) st.st_size != io->length(io))
+	{
+		close(fd);
+		return;
+	}
+
+	void *addr = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if (addr == MAP_FAILED)
+		return;
+
+	const uint8_t *bytes = static_cast<const uint8_t*>(addr);
+
+	if (memcmp(bytes, RGSS_HEADER, sizeof(RGSS_HEADER)) || bytes[7] != version)
+	{
+		munmap(addr, st.st_size);
+		return;
+	}
+
+	data->mapping = bytes;
+	data->mappingSize = st.st_size;
+#else
+	(void) data;
+	(void) filename;
+	(void) version;
+#endif
+}
+
 static void*
-RGSS_openArchive(PHYSFS_Io *io, const char *, int forWrite, int *claimed)
+RGSS_openArchive(PHYSFS_Io *io, const char *filename, int forWrite, int *claimed)
 {
 	if (forWrite)
 		return NULL;
@@ -387,8 +731,7 @@ RGSS_openArchive(PHYSFS_Io *io, const char *, int forWrite, int *claimed)
 	else
 		*claimed = 1;
 
-	RGSS_archiveData *data = new RGSS_archiveData;
-	data->archiveIo = io;
+	RGSS_archiveData *data = new RGSS_archiveData(io);
 
 	uint32_t magic = RGSS_MAGIC;
 
@@ -433,6 +776,8 @@ RGSS_openArchive(PHYSFS_Io *io, const char *, int forWrite, int *claimed)
 		io->seek(io, entry.offset + entry.size);
 	}
 
+	mapArchive(data, filename, 1);
+
 	return data;
 }
 
@@ -466,7 +811,7 @@ RGSS_openRead(void *opaque, const char *filename)
 		return 0;
 
 	RGSS_entryHandle *entry =
-	        new RGSS_entryHandle(data->entryHash[filename], data->archiveIo);
+	        new RGSS_entryHandle(data->entryHash[filename], *data);
 
 	PHYSFS_Io *io = PHYSFS_ALLOC(PHYSFS_Io);
 
@@ -516,6 +861,11 @@ RGSS_closeArchive(void *opaque)
 {
 	RGSS_archiveData *data = static_cast<RGSS_archiveData*>(opaque);
 
+#ifdef RGSS_HAVE_MMAP
+	if (data->mapping)
+		munmap(const_cast<uint8_t*>(data->mapping), data->mappingSize);
+#endif
+
 	delete data;
 }
 
@@ -585,7 +935,7 @@ readUint32AndXor(PHYSFS_Io *io, uint32_t &result, uint32_t key)
 }
 
 static void*
-RGSS3_openArchive(PHYSFS_Io *io, const char *, int forWrite, int *claimed)
+RGSS3_openArchive(PHYSFS_Io *io, const char *filename, int forWrite, int *claimed)
 {
 	if (forWrite)
 		return NULL;
@@ -603,8 +953,7 @@ RGSS3_openArchive(PHYSFS_Io *io, const char *, int forWrite, int *claimed)
 
 	baseMagic = (baseMagic * 9) + 3;
 
-	RGSS_archiveData *data = new RGSS_archiveData;
-	data->archiveIo = io;
+	RGSS_archiveData *data = new RGSS_archiveData(io);
 
 	/* Top level entry list */
 	BoostSet<std::string> &topLevel = data->dirHash[""];
@@ -659,6 +1008,8 @@ RGSS3_openArchive(PHYSFS_Io *io, const char *, int forWrite, int *claimed)
 		return NULL;
 	}
 
+	mapArchive(data, filename, 3);
+
 	return data;
 }
 
@@ -28,4 +28,12 @@ extern const PHYSFS_Archiver RGSS1_Archiver;
 extern const PHYSFS_Archiver RGSS2_Archiver;
 extern const PHYSFS_Archiver RGSS3_Archiver;
 
+/* Whether archives mounted from now on are memory mapped
+ * (where supported) instead of read through PhysFS */
+void RGSS_setMapArchives(bool enable);
+
+/* Decrypts a synthetic in-memory archive with every xor
+ * kernel usable on this machine and logs each one's MB/s */
+void RGSS_benchmarkKernels();
+
 #endif // RGSSAD_H
@@ -0,0 +1,217 @@
+/*
+** benchmark.cpp
+**
+** This file is part of mkxp.
+**
+** Copyright (C) 2013 - 2021 Amaryllis Kulla <ancurio@mapleshrine.eu>
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "benchmark.h"
+
+#include "bitmap.h"
+#include "gl-fun.h"
+#include "debugwriter.h"
+#include "util/json5pp.hpp"
+
+#include <SDL_timer.h>
+
+#include <stdio.h>
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+
+struct FrameRecord
+{
+	double frameMs;
+	double compositeMs;
+	uint64_t drawCalls;
+	uint64_t texUploads;
+	uint64_t effectPixels;
+};
+
+struct BenchmarkPrivate
+{
+	const size_t frames;
+	const std::string outPath;
+
+	std::vector<FrameRecord> records;
+
+	GLCallCounters counters;
+	GLCallCounters lastCounters;
+
+	const double ticksPerMs;
+
+	/* 0 until the first frame ended; that frame
+	 * includes startup and isn't recorded */
+	uint64_t lastFrameEnd;
+
+	uint64_t compositeStart;
+	double compositeMs;
+	uint64_t effectPixels;
+
+	bool written;
+
+	BenchmarkPrivate(int frames, const std::string &outPath)
+	    : frames(std::max(frames, 1)),
+	      outPath(outPath),
+	      ticksPerMs(SDL_GetPerformanceFrequency() / 1000.0),
+	      lastFrameEnd(0),
+	      compositeStart(0),
+	      compositeMs(0),
+	      effectPixels(0),
+	      written(false)
+	{
+		counters.drawCalls = counters.texUploads = 0;
+		lastCounters = counters;
+
+		records.reserve(this->frames);
+	}
+
+	double elapsedMs(uint64_t since) const
+	{
+		return (SDL_GetPerformanceCounter() - since) / ticksPerMs;
+	}
+
+	static double percentile(const std::vector<double> &sorted, double pct)
+	{
+		size_t i = (size_t) (pct / 100.0 * (sorted.size() - 1) + 0.5);
+
+		return sorted[std::min(i, sorted.size() - 1)];
+	}
+
+	void write()
+	{
+		json5pp::value perFrame = json5pp::array({});
+		json5pp::value::array_type &list = perFrame.as_array();
+
+		std::vector<double> times;
+		double total = 0;
+		double totalEffectPixels = 0;
+
+		for (size_t i = 0; i < records.size(); ++i)
+		{
+			const FrameRecord &r = records[i];
+
+			list.push_back(json5pp::object({
+				{ "frameMs", r.frameMs },
+				{ "compositeMs", r.compositeMs },
+				{ "drawCalls", (int) r.drawCalls },
+				{ "textureUploads", (int) r.texUploads },
+				{ "effectPixels", (double) r.effectPixels }
+			}));
+
+			times.push_back(r.frameMs);
+			total += r.frameMs;
+			totalEffectPixels += r.effectPixels;
+		}
+
+		std::sort(times.begin(), times.end());
+
+		Bitmap::StorageStats storage = Bitmap::storageStats();
+
+		json5pp::value out = json5pp::object({
+#ifdef MKXPZ_VERSION
+			{ "version", MKXPZ_VERSION },
+#endif
+#ifdef MKXPZ_GIT_HASH
+			{ "gitHash", MKXPZ_GIT_HASH },
+#endif
+			{ "renderer", (const char*) gl.GetString(GL_RENDERER) },
+			{ "frames", (int) records.size() },
+			{ "meanFrameMs", total / records.size() },
+			{ "medianFrameMs", percentile(times, 50) },
+			{ "p95FrameMs", percentile(times, 95) },
+			{ "p99FrameMs", percentile(times, 99) },
+			{ "maxFrameMs", times.back() },
+			{ "meanEffectPixels", totalEffectPixels / records.size() },
+			{ "emptyBitmapBytes", (double) storage.nominalBytes },
+			{ "emptyBitmapBytesCommitted", (double) storage.committedBytes },
+			{ "perFrame", perFrame }
+		});
+
+		FILE *f = fopen(outPath.c_str(), "w");
+
+		if (!f)
+		{
+			Debug() << "Failed to open benchmark output" << outPath;
+			return;
+		}
+
+		std::string json = out.stringify(json5pp::rule::space_indent<>());
+		fwrite(json.c_str(), 1, json.size(), f);
+		fclose(f);
+
+		Debug() << "Benchmark results written to" << outPath;
+	}
+};
+
+Benchmark::Benchmark(int frames, const std::string &outPath)
+{
+	p = new BenchmarkPrivate(frames, outPath);
+
+	countGLCalls(&p->counters);
+}
+
+Benchmark::~Benchmark()
+{
+	countGLCalls(0);
+
+	delete p;
+}
+
+void Benchmark::compositeBegin()
+{
+	p->compositeStart = SDL_GetPerformanceCounter();
+}
+
+void Benchmark::compositeEnd(uint64_t effectPixels)
+{
+	p->compositeMs += p->elapsedMs(p->compositeStart);
+	p->effectPixels += effectPixels;
+}
+
+bool Benchmark::frameEnd()
+{
+	if (p->written)
+		return true;
+
+	uint64_t now = SDL_GetPerformanceCounter();
+
+	if (p->lastFrameEnd != 0)
+	{
+		FrameRecord r;
+		r.frameMs = (now - p->lastFrameEnd) / p->ticksPerMs;
+		r.compositeMs = p->compositeMs;
+		r.drawCalls = p->counters.drawCalls - p->lastCounters.drawCalls;
+		r.texUploads = p->counters.texUploads - p->lastCounters.texUploads;
+		r.effectPixels = p->effectPixels;
+
+		p->records.push_back(r);
+	}
+
+	p->lastFrameEnd = now;
+	p->lastCounters = p->counters;
+	p->compositeMs = 0;
+	p->effectPixels = 0;
+
+	if (p->records.size() < p->frames)
+		return false;
+
+	p->write();
+	p->written = true;
+
+	return true;
+}
@@ -0,0 +1,57 @@
+/*
+** benchmark.h
+**
+** This file is part of mkxp.
+**
+** Copyright (C) 2013 - 2021 Amaryllis Kulla <ancurio@mapleshrine.eu>
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <stdint.h>
+#include <string>
+
+struct BenchmarkPrivate;
+
+/* Records per frame timings and GL call counts for a fixed
+ * number of frames, then writes them out as JSON, so runs of
+ * the same scripted scene can be compared across builds.
+ *
+ * The time of a frame spans from the end of the previous
+ * Graphics.update to the end of its own, ie. it includes
+ * the time spent in scripts. */
+class Benchmark
+{
+public:
+	Benchmark(int frames, const std::string &outPath);
+	~Benchmark();
+
+	/* Brackets scene composition; may happen several times
+	 * per frame. 'effectPixels' is the number of pixels the
+	 * composition wrote for viewport effects */
+	void compositeBegin();
+	void compositeEnd(uint64_t effectPixels);
+
+	/* Returns true once the last frame was recorded
+	 * and the results were written */
+	bool frameEnd();
+
+private:
+	BenchmarkPrivate *p;
+};
+
+#endif // BENCHMARK_H
@@ -41,6 +41,10 @@
 #include "texpool.h"
 #include "shader.h"
 #include "filesystem.h"
+#include "decodepool.h"
+#include "bitmapcache.h"
+#include "glyphatlas.h"
+#include "textcache.h"
 #include "font.h"
 #include "eventthread.h"
 #include "graphics.h"
@@ -52,6 +56,7 @@
 #include "sigslot/signal.hpp"
 
 #include <math.h>
+#include <assert.h>
 #include <algorithm>
 
 extern "C" {
@@ -81,6 +86,15 @@ throw Exception(Exception::MKXPError, \
 
 #define OUTLINE_SIZE 1
 
+/* Number of set_pixel calls outside of the cached surface after
+ * which reading back the tiles they hit is cheaper than uploading
+ * every single pixel on its own */
+#define PIXEL_DEFER_THRESHOLD 32
+
+/* Edge length of the squares the cached surface is read back
+ * and invalidated in */
+#define READBACK_TILE 64
+
 /* Normalize (= ensure width and
  * height are positive) */
 static IntRect normalizedRect(const IntRect &rect)
@@ -151,6 +165,9 @@ static void gif_bitmap_modified(void *bitmap)
 
 // --------------------
 
+/* Texture memory of bitmaps created empty */
+static Bitmap::StorageStats emptyStorage = { 0, 0 };
+
 struct BitmapPrivate
 {
     Bitmap *self;
@@ -225,11 +242,37 @@ struct BitmapPrivate
     SDL_Surface *megaSurface;
     
     /* A cached version of the bitmap in client memory, for
-     * getPixel calls. Is invalidated any time the bitmap
-     * is modified */
+     * getPixel calls. It is read back one tile at a time, and
+     * only the tiles touched by a modification are invalidated */
     SDL_Surface *surface;
     SDL_PixelFormat *format;
     
+    enum TileState
+    {
+        TileInvalid,
+        /* Part of the pending 'readbackBuf' transfer */
+        TileRequested,
+        TileValid,
+        /* Holds setPixel writes which haven't been uploaded
+         * yet. Flushed before the texture is used for
+         * anything else */
+        TileDirty
+    };
+    
+    /* State of each READBACK_TILE square of 'surface', row
+     * by row (empty while there is no surface) */
+    std::vector<uint8_t> tiles;
+    int tilesX;
+    unsigned int dirtyTiles;
+    
+    /* setPixel calls outside of valid tiles
+     * since 'surface' was last freed */
+    unsigned int pixelWrites;
+    
+    /* In flight Bitmap#request_readback, if any */
+    PBO::ID readbackBuf;
+    void *readbackSync;
+    
     /* The 'tainted' area describes which parts of the
      * bitmap are not cleared, ie. don't have 0 opacity.
      * If we're blitting / drawing text to a cleared part
@@ -238,10 +281,25 @@ struct BitmapPrivate
      * ourselves the expensive blending calculation */
     pixman_region16_t tainted;
     
+    /* Set if 'gl' is shared through the BitmapCache */
+    BitmapCacheEntry *cacheEntry;
+    
+    /* Size of the texture of a bitmap created empty, which is
+     * only allocated on first write (see 'commit()'). Until then
+     * 'gl' has no objects, and the bitmap is entirely clear */
+    uint64_t emptyBytes;
+    
     BitmapPrivate(Bitmap *self)
     : self(self),
     megaSurface(0),
-    surface(0)
+    surface(0),
+    tilesX(0),
+    dirtyTiles(0),
+    pixelWrites(0),
+    readbackBuf(0),
+    readbackSync(0),
+    cacheEntry(0),
+    emptyBytes(0)
     {
         format = SDL_AllocFormat(SDL_PIXELFORMAT_ABGR8888);
         
@@ -269,11 +327,99 @@ struct BitmapPrivate
     }
     
     TEXFBO &getGLTypes() {
+        commit();
+        flushPixels();
+        
         return (animation.enabled) ? animation.currentFrame() : gl;
     }
     
+    /* Whether 'gl' still waits for its texture */
+    bool pending() const
+    {
+        return gl.tex == TEX::ID(0) && gl.width > 0;
+    }
+    
+    /* Gives a bitmap created empty its texture, cleared
+     * unless the caller is about to overwrite all of it.
+     * This can happen in the middle of a blit or draw (eg.
+     * a blank bitmap used as a source), so the framebuffer
+     * bindings are left as they were */
+    void commit(bool clearContents = true)
+    {
+        if (!pending())
+            return;
+        
+        gl = shState->texPool().request(gl.width, gl.height);
+        emptyStorage.committedBytes += emptyBytes;
+        
+        if (!clearContents)
+            return;
+        
+        GLint drawFBO = 0, readFBO = 0;
+        ::gl.GetIntegerv(GL_FRAMEBUFFER_BINDING, &drawFBO);
+        if (::gl.BlitFramebuffer)
+            ::gl.GetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &readFBO);
+        
+        FBO::bind(gl.fbo);
+        glState.clearColor.pushSet(Vec4());
+        glState.scissorTest.pushSet(false);
+        FBO::clear();
+        glState.scissorTest.pop();
+        glState.clearColor.pop();
+        
+        if (::gl.BlitFramebuffer) {
+            ::gl.BindFramebuffer(GL_DRAW_FRAMEBUFFER, drawFBO);
+            ::gl.BindFramebuffer(GL_READ_FRAMEBUFFER, readFBO);
+        }
+        else {
+            ::gl.BindFramebuffer(GL_FRAMEBUFFER, drawFBO);
+        }
+    }
+    
+    /* Must be called before anything writes to 'gl'. Contents
+     * can be skipped if they're about to be overwritten anyway */
+    void unshare(bool keepContents = true)
+    {
+        commit(keepContents);
+        
+        if (keepContents)
+            flushPixels();
+        else
+            discardPixels();
+        
+        if (!cacheEntry)
+            return;
+        
+        shState->bitmapCache().unshare(cacheEntry, gl, keepContents);
+        cacheEntry = 0;
+    }
+    
+    /* Swaps in a new texture after an operation that
+     * rendered the old contents into it */
+    void replaceTex(const TEXFBO &newTex)
+    {
+        if (pending())
+            emptyStorage.committedBytes += emptyBytes;
+        
+        if (cacheEntry)
+            shState->bitmapCache().release(cacheEntry);
+        else
+            shState->texPool().release(gl);
+        
+        cacheEntry = 0;
+        gl = newTex;
+    }
+    
+    void touchCache()
+    {
+        if (cacheEntry)
+            shState->bitmapCache().touch(cacheEntry);
+    }
+    
     void prepare()
     {
+        flushPixels();
+        
         if (!animation.enabled || !animation.playing) return;
         
         animation.updateTimer();
@@ -284,6 +430,335 @@ struct BitmapPrivate
         surface = SDL_CreateRGBSurface(0, gl.width, gl.height, format->BitsPerPixel,
                                        format->Rmask, format->Gmask,
                                        format->Bmask, format->Amask);
+        
+        tilesX = (gl.width + READBACK_TILE - 1) / READBACK_TILE;
+        int tilesY = (gl.height + READBACK_TILE - 1) / READBACK_TILE;
+        
+        /* New surfaces are zeroed, just like the texture to be */
+        tiles.assign(tilesX * tilesY, pending() ? TileValid : TileInvalid);
+    }
+    
+    void freeSurface()
+    {
+        if (!surface)
+            return;
+        
+        /* Anything pending must have been flushed
+         * before the texture was rendered to */
+        assert(dirtyTiles == 0);
+        
+        cancelReadback();
+        
+        SDL_FreeSurface(surface);
+        surface = 0;
+        tiles.clear();
+        pixelWrites = 0;
+    }
+    
+    size_t tileAt(int x, int y) const
+    {
+        return (y / READBACK_TILE) * tilesX + x / READBACK_TILE;
+    }
+    
+    IntRect tileRect(size_t i) const
+    {
+        int x = (i % tilesX) * READBACK_TILE;
+        int y = (i / tilesX) * READBACK_TILE;
+        
+        return IntRect(x, y, std::min(READBACK_TILE, gl.width - x),
+                       std::min(READBACK_TILE, gl.height - y));
+    }
+    
+    /* Whether 'surface' mirrors the entire texture */
+    bool surfaceComplete() const
+    {
+        if (!surface)
+            return false;
+        
+        for (size_t i = 0; i < tiles.size(); ++i)
+            if (tiles[i] == TileInvalid || tiles[i] == TileRequested)
+                return false;
+        
+        return true;
+    }
+    
+    /* Copies rows of 'rect' from 'src', laid out with 'srcPitch',
+     * to the same position in 'surface' */
+    void copyToSurface(const IntRect &rect, const uint8_t *src, int srcPitch)
+    {
+        uint8_t *dst = (uint8_t*) surface->pixels
+            + rect.y * surface->pitch + rect.x * 4;
+        
+        for (int y = 0; y < rect.h; ++y)
+            memcpy(dst + y * surface->pitch, src + y * srcPitch, rect.w * 4);
+    }
+    
+    void readTile(size_t i)
+    {
+        /* GLES2 can't pack into a larger row length, so
+         * tiles have to take a detour through here */
+        static uint8_t buffer[READBACK_TILE * READBACK_TILE * 4];
+        
+        IntRect rect = tileRect(i);
+        
+        FBO::bind(gl.fbo);
+        ::gl.ReadPixels(rect.x, rect.y, rect.w, rect.h, GL_RGBA, GL_UNSIGNED_BYTE, buffer);
+        
+        copyToSurface(rect, buffer, rect.w * 4);
+        tiles[i] = TileValid;
+    }
+    
+    /* Makes 'surface' mirror the whole texture, reading back
+     * whatever isn't cached yet */
+    void readSurface()
+    {
+        finishReadback();
+        
+        if (!surface)
+            allocSurface();
+        
+        size_t invalid = 0;
+        
+        for (size_t i = 0; i < tiles.size(); ++i)
+            invalid += (tiles[i] == TileInvalid);
+        
+        if (invalid < tiles.size())
+        {
+            for (size_t i = 0; i < tiles.size(); ++i)
+                if (tiles[i] == TileInvalid)
+                    readTile(i);
+            
+            return;
+        }
+        
+        /* Nothing cached yet, fetch everything in one go */
+        FBO::bind(gl.fbo);
+        ::gl.ReadPixels(0, 0, gl.width, gl.height, GL_RGBA, GL_UNSIGNED_BYTE, surface->pixels);
+        
+        tiles.assign(tiles.size(), TileValid);
+    }
+    
+    /* Makes sure the tile containing x/y is in 'surface' */
+    void readPixelTile(int x, int y)
+    {
+        if (!surface)
+            allocSurface();
+        
+        size_t i = tileAt(x, y);
+        
+        if (tiles[i] == TileRequested)
+            finishReadback();
+        
+        if (tiles[i] == TileInvalid)
+            readTile(i);
+    }
+    
+    bool pixelCached(int x, int y) const
+    {
+        if (!surface)
+            return false;
+        
+        uint8_t state = tiles[tileAt(x, y)];
+        
+        return state == TileValid || state == TileDirty;
+    }
+    
+    void addPendingPixel(int x, int y)
+    {
+        uint8_t &state = tiles[tileAt(x, y)];
+        
+        if (state == TileDirty)
+            return;
+        
+        state = TileDirty;
+        ++dirtyTiles;
+    }
+    
+    /* Must be called before anything reads from or renders to 'gl' */
+    void flushPixels()
+    {
+        if (dirtyTiles == 0)
+            return;
+        
+        commit();
+        TEX::bind(gl.tex);
+        
+        for (size_t i = 0; i < tiles.size(); ++i)
+        {
+            if (tiles[i] != TileDirty)
+                continue;
+            
+            IntRect r = tileRect(i);
+            GLMeta::subRectImageUpload(surface->w, r.x, r.y, r.x, r.y, r.w, r.h,
+                                       surface, GL_RGBA);
+            
+            tiles[i] = TileValid;
+        }
+        
+        GLMeta::subRectImageEnd();
+        
+        dirtyTiles = 0;
+    }
+    
+    /* For operations that overwrite the whole texture anyway */
+    void discardPixels()
+    {
+        if (dirtyTiles == 0)
+            return;
+        
+        for (size_t i = 0; i < tiles.size(); ++i)
+            if (tiles[i] == TileDirty)
+                tiles[i] = TileInvalid;
+        
+        dirtyTiles = 0;
+    }
+    
+    /* Drops the tiles overlapping 'rect' from 'surface'
+     * after the texture was rendered to there */
+    void invalidate(const IntRect &rect)
+    {
+        /* Nothing could have been rendered to a pending texture */
+        if (!surface || pending())
+            return;
+        
+        IntRect norm = normalizedRect(rect);
+        
+        int x0 = std::max(norm.x, 0);
+        int y0 = std::max(norm.y, 0);
+        int x1 = std::min(norm.x + norm.w, gl.width);
+        int y1 = std::min(norm.y + norm.h, gl.height);
+        
+        if (x0 >= x1 || y0 >= y1)
+            return;
+        
+        if (x0 == 0 && y0 == 0 && x1 == gl.width && y1 == gl.height)
+        {
+            freeSurface();
+            return;
+        }
+        
+        for (int ty = y0 / READBACK_TILE; ty <= (y1 - 1) / READBACK_TILE; ++ty)
+            for (int tx = x0 / READBACK_TILE; tx <= (x1 - 1) / READBACK_TILE; ++tx)
+            {
+                uint8_t &state = tiles[ty * tilesX + tx];
+                assert(state != TileDirty);
+                
+                /* A pending transfer may still carry the
+                 * old contents, it mustn't land here */
+                state = TileInvalid;
+            }
+    }
+    
+    /* Starts copying everything not cached yet into a pixel
+     * buffer, to be picked up by a later 'pollReadback()' */
+    void requestReadback()
+    {
+        if (readbackBuf.gl != 0)
+            return;
+        
+        if (!surface)
+            allocSurface();
+        
+        if (surfaceComplete())
+            return;
+        
+        /* No way to tell when the transfer is done,
+         * so there's nothing to gain from starting it */
+        if (!::gl.FenceSync)
+        {
+            readSurface();
+            return;
+        }
+        
+        readbackBuf = PBO::gen();
+        PBO::bind(readbackBuf);
+        PBO::allocEmpty(gl.width * gl.height * 4, GL_STREAM_READ);
+        
+        FBO::bind(gl.fbo);
+        ::gl.ReadPixels(0, 0, gl.width, gl.height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+        
+        PBO::unbind();
+        
+        readbackSync = ::gl.FenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        
+        for (size_t i = 0; i < tiles.size(); ++i)
+            if (tiles[i] == TileInvalid)
+                tiles[i] = TileRequested;
+    }
+    
+    /* Returns true once nothing is in flight anymore */
+    bool pollReadback()
+    {
+        if (readbackBuf.gl == 0)
+            return true;
+        
+        GLenum result = ::gl.ClientWaitSync(readbackSync, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        
+        if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED)
+            return false;
+        
+        finishReadback();
+        
+        return true;
+    }
+    
+    /* Moves the requested tiles into 'surface',
+     * waiting for the transfer if necessary */
+    void finishReadback()
+    {
+        if (readbackBuf.gl == 0)
+            return;
+        
+        int pitch = gl.width * 4;
+        
+        PBO::bind(readbackBuf);
+        const uint8_t *data = (const uint8_t*)
+            ::gl.MapBufferRange(GL_PIXEL_PACK_BUFFER, 0, pitch * gl.height, GL_MAP_READ_BIT);
+        
+        for (size_t i = 0; i < tiles.size(); ++i)
+        {
+            if (tiles[i] != TileRequested)
+                continue;
+            
+            /* Tiles will simply be read again if mapping failed */
+            if (!data)
+            {
+                tiles[i] = TileInvalid;
+                continue;
+            }
+            
+            IntRect rect = tileRect(i);
+            copyToSurface(rect, data + rect.y * pitch + rect.x * 4, pitch);
+            
+            tiles[i] = TileValid;
+        }
+        
+        if (data)
+            ::gl.UnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        
+        PBO::unbind();
+        releaseReadback();
+    }
+    
+    void cancelReadback()
+    {
+        if (readbackBuf.gl == 0)
+            return;
+        
+        for (size_t i = 0; i < tiles.size(); ++i)
+            if (tiles[i] == TileRequested)
+                tiles[i] = TileInvalid;
+        
+        releaseReadback();
+    }
+    
+    void releaseReadback()
+    {
+        PBO::del(readbackBuf);
+        readbackBuf = PBO::ID(0);
+        
+        ::gl.DeleteSync(readbackSync);
+        readbackSync = 0;
     }
     
     void clearTaintedArea()
@@ -307,7 +782,7 @@ struct BitmapPrivate
         pixman_region16_t m_reg;
         pixman_region_init_rect(&m_reg, rect.x, rect.y, rect.w, rect.h);
         
-        pixman_region_subtract(&tainted, &m_reg, &tainted);
+        pixman_region_subtract(&tainted, &tainted, &m_reg);
         
         pixman_region_fini(&m_reg);
     }
@@ -328,6 +803,15 @@ struct BitmapPrivate
     
     void bindTexture(ShaderBase &shader)
     {
+        touchCache();
+        flushPixels();
+        
+        if (pending()) {
+            shState->bindEmptyTex();
+            shader.setTexSize(Vec2i(gl.width, gl.height));
+            return;
+        }
+        
         if (animation.enabled) {
             TEXFBO cframe = animation.currentFrame();
             TEX::bind(cframe.tex);
@@ -340,6 +824,9 @@ struct BitmapPrivate
     
     void bindFBO()
     {
+        commit();
+        flushPixels();
+        
         FBO::bind((animation.enabled) ? animation.currentFrame().fbo : gl.fbo);
     }
     
@@ -390,13 +877,18 @@ struct BitmapPrivate
         surf = surfConv;
     }
     
-    void onModified(bool freeSurface = true)
+    void onModified(bool dropSurface = true)
     {
-        if (surface && freeSurface)
-        {
-            SDL_FreeSurface(surface);
-            surface = 0;
-        }
+        if (dropSurface)
+            freeSurface();
+        
+        self->modified();
+    }
+    
+    /* For operations that only rendered to 'rect' */
+    void onModified(const IntRect &rect)
+    {
+        invalidate(rect);
         
         self->modified();
     }
@@ -469,10 +961,127 @@ struct BitmapOpenHandler : FileSystem::OpenHandler
     }
 };
 
+/* Runs a BitmapOpenHandler ahead of time on a decode worker,
+ * leaving only the texture upload to the Bitmap constructor */
+struct BitmapDecodeJob : DecodePool::Job
+{
+    FileSystem &fs;
+    std::string filename;
+    
+    BitmapOpenHandler handler;
+    
+    bool thrown;
+    Exception::Type excType;
+    std::string excMsg;
+    
+    BitmapDecodeJob(FileSystem &fs, const char *filename)
+    : fs(fs), filename(filename), thrown(false), excType(Exception::MKXPError)
+    {}
+    
+    ~BitmapDecodeJob()
+    {
+        if (handler.surface)
+            SDL_FreeSurface(handler.surface);
+        
+        if (handler.gif)
+        {
+            gif_finalise(handler.gif);
+            delete handler.gif;
+            delete handler.gif_data;
+        }
+    }
+    
+    void run()
+    {
+        try
+        {
+            fs.openRead(handler, filename.c_str());
+        }
+        catch (const Exception &e)
+        {
+            thrown = true;
+            excType = e.type;
+            excMsg = e.msg;
+            return;
+        }
+        
+        /* SDL errors are per thread, grab it while we can */
+        if (!handler.gif && !handler.surface && handler.error.empty())
+            handler.error = SDL_GetError();
+        
+        BitmapPrivate::ensureFormat(handler.surface, SDL_PIXELFORMAT_ABGR8888);
+    }
+    
+    /* Moves the decoded result into 'out', or rethrows
+     * whatever 'openRead()' threw on the worker */
+    void claim(BitmapOpenHandler &out)
+    {
+        if (thrown)
+            throw Exception(excType, "%s", excMsg.c_str());
+        
+        out = handler;
+        handler.surface = 0;
+        handler.gif = 0;
+        handler.gif_data = 0;
+    }
+};
+
+/* Preloaded and cached images are matched
+ * by their normalized, lower case path */
+static std::string bitmapKey(const char *filename)
+{
+    std::string key = shState->fileSystem().normalize(filename, false, false);
+    
+    std::transform(key.begin(), key.end(), key.begin(), [](unsigned char c){
+        return std::tolower(c);
+    });
+    
+    return key;
+}
+
 Bitmap::Bitmap(const char *filename)
 {
+    const std::string key = bitmapKey(filename);
+    BitmapCache &cache = shState->bitmapCache();
+    
+    if (cache.enabled())
+    {
+        TEXFBO tex;
+        BitmapCacheEntry *entry = cache.acquire(key, tex);
+        
+        if (entry)
+        {
+            p = new BitmapPrivate(this);
+            p->gl = tex;
+            p->cacheEntry = entry;
+            p->addTaintedArea(rect());
+            return;
+        }
+    }
+    
     BitmapOpenHandler handler;
-    shState->fileSystem().openRead(handler, filename);
+    DecodePool::Job *job = shState->decodePool().take(key);
+    
+    if (job)
+    {
+        BitmapDecodeJob *decodeJob = static_cast<BitmapDecodeJob*>(job);
+        
+        try
+        {
+            decodeJob->claim(handler);
+        }
+        catch (const Exception &e)
+        {
+            delete decodeJob;
+            throw e;
+        }
+        
+        delete decodeJob;
+    }
+    else
+    {
+        shState->fileSystem().openRead(handler, filename);
+    }
     
     if (!handler.error.empty()) {
         // Not loaded with SDL, but I want it to be caught with the same exception type
@@ -611,6 +1220,9 @@ Bitmap::Bitmap(const char *filename)
         TEX::uploadImage(p->gl.width, p->gl.height, imgSurf->pixels, GL_RGBA);
         
         SDL_FreeSurface(imgSurf);
+        
+        if (cache.enabled())
+            p->cacheEntry = cache.insert(key, p->gl);
     }
     
     p->addTaintedArea(rect());
@@ -621,12 +1233,20 @@ Bitmap::Bitmap(int width, int height)
     if (width <= 0 || height <= 0)
         throw Exception(Exception::RGSSError, "failed to create bitmap");
     
-    TEXFBO tex = shState->texPool().request(width, height);
+    int maxSize = glState.caps.maxTexSize;
+    if (width > maxSize || height > maxSize)
+        throw Exception(Exception::MKXPError,
+                        "Texture dimensions [%d, %d] exceed hardware capabilities",
+                        width, height);
     
+    /* Lots of these are never drawn to, or get filled right
+     * away; the texture is only requested on first write */
     p = new BitmapPrivate(this);
-    p->gl = tex;
+    p->gl.width = width;
+    p->gl.height = height;
     
-    clear();
+    p->emptyBytes = (uint64_t) width * height * 4;
+    emptyStorage.nominalBytes += p->emptyBytes;
 }
 
 Bitmap::Bitmap(void *pixeldata, int width, int height)
@@ -685,7 +1305,14 @@ Bitmap::Bitmap(const Bitmap &other, int frame)
     p = new BitmapPrivate(this);
     
     // TODO: Clean me up
-    if (!other.isAnimated() || frame >= -1) {
+    if (!other.isAnimated() && other.p->pending()) {
+        p->gl.width = other.width();
+        p->gl.height = other.height();
+        
+        p->emptyBytes = other.p->emptyBytes;
+        emptyStorage.nominalBytes += p->emptyBytes;
+    }
+    else if (!other.isAnimated() || frame >= -1) {
         p->gl = shState->texPool().request(other.width(), other.height());
         
         GLMeta::blitBegin(p->gl);
@@ -824,6 +1451,22 @@ void Bitmap::stretchBlt(const IntRect &destRect,
     if (opacity == 0)
         return;
     
+    /* Blending transparent pixels changes nothing */
+    if (source.p->pending())
+        return;
+    
+    /* Plain GL blits covering the whole bitmap don't need
+     * the previous contents (nor a cleared texture) */
+    bool overwrite = opacity == 255 && destRect == rect()
+        && &source != this && !source.isMega()
+        && !p->touchesTaintedArea(destRect)
+        && sourceRect.x >= 0 && sourceRect.y >= 0
+        && sourceRect.w > 0 && sourceRect.h > 0
+        && sourceRect.x + sourceRect.w <= source.width()
+        && sourceRect.y + sourceRect.h <= source.height();
+    
+    p->unshare(!overwrite);
+    
     SDL_Surface *srcSurf = source.megaSurface();
     
     if (srcSurf && shState->config().subImageFix)
@@ -853,7 +1496,7 @@ void Bitmap::stretchBlt(const IntRect &destRect,
         p->popViewport();
         
         p->addTaintedArea(destRect);
-        p->onModified();
+        p->onModified(destRect);
         
         return;
     }
@@ -900,7 +1543,7 @@ void Bitmap::stretchBlt(const IntRect &destRect,
         
         SDL_FreeSurface(blitTemp);
         
-        p->onModified();
+        p->onModified(destRect);
         return;
     }
     
@@ -949,7 +1592,7 @@ void Bitmap::stretchBlt(const IntRect &destRect,
     }
     
     p->addTaintedArea(destRect);
-    p->onModified();
+    p->onModified(destRect);
 }
 
 void Bitmap::fillRect(int x, int y,
@@ -966,6 +1609,11 @@ void Bitmap::fillRect(const IntRect &rect, const Vec4 &color)
     GUARD_MEGA;
     GUARD_ANIMATED;
     
+    /* Nothing to clear there */
+    if (color.w == 0 && !p->touchesTaintedArea(rect))
+        return;
+    
+    p->unshare();
     p->fillRect(rect, color);
     
     if (color.w == 0)
@@ -975,7 +1623,7 @@ void Bitmap::fillRect(const IntRect &rect, const Vec4 &color)
     /* Fill op */
         p->addTaintedArea(rect);
     
-    p->onModified();
+    p->onModified(rect);
 }
 
 void Bitmap::gradientFillRect(int x, int y,
@@ -995,6 +1643,8 @@ void Bitmap::gradientFillRect(const IntRect &rect,
     GUARD_MEGA;
     GUARD_ANIMATED;
     
+    p->unshare();
+    
     SimpleColorShader &shader = shState->shaders().simpleColor;
     shader.bind();
     shader.setTranslation(Vec2i());
@@ -1027,7 +1677,7 @@ void Bitmap::gradientFillRect(const IntRect &rect,
     
     p->addTaintedArea(rect);
     
-    p->onModified();
+    p->onModified(rect);
 }
 
 void Bitmap::clearRect(int x, int y, int width, int height)
@@ -1042,9 +1692,15 @@ void Bitmap::clearRect(const IntRect &rect)
     GUARD_MEGA;
     GUARD_ANIMATED;
     
+    if (!p->touchesTaintedArea(rect))
+        return;
+    
+    p->unshare();
     p->fillRect(rect, Vec4());
     
-    p->onModified();
+    p->substractTaintedArea(rect);
+    
+    p->onModified(rect);
 }
 
 void Bitmap::blur()
@@ -1054,6 +1710,11 @@ void Bitmap::blur()
     GUARD_MEGA;
     GUARD_ANIMATED;
     
+    if (p->pending())
+        return;
+    
+    p->unshare();
+    
     Quad &quad = shState->gpQuad();
     FloatRect rect(0, 0, width(), height());
     quad.setTexPosRect(rect, rect);
@@ -1090,6 +1751,9 @@ void Bitmap::blur()
     
     shState->texPool().release(auxTex);
     
+    /* Pixels bleed out of the tainted area */
+    p->addTaintedArea(IntRect(0, 0, width(), height()));
+    
     p->onModified();
 }
 
@@ -1100,6 +1764,9 @@ void Bitmap::radialBlur(int angle, int divisions)
     GUARD_MEGA;
     GUARD_ANIMATED;
     
+    if (p->pending())
+        return;
+    
     angle     = clamp<int>(angle, 0, 359);
     divisions = clamp<int>(divisions, 2, 100);
     
@@ -1183,8 +1850,9 @@ void Bitmap::radialBlur(int angle, int divisions)
     glState.blendMode.pop();
     glState.clearColor.pop();
     
-    shState->texPool().release(p->gl);
-    p->gl = newTex;
+    p->replaceTex(newTex);
+    
+    p->addTaintedArea(rect());
     
     p->onModified();
 }
@@ -1196,6 +1864,11 @@ void Bitmap::clear()
     GUARD_MEGA;
     GUARD_ANIMATED;
     
+    /* Already clear */
+    if (p->pending() || !pixman_region_not_empty(&p->tainted))
+        return;
+    
+    p->unshare(false);
     p->bindFBO();
     
     glState.clearColor.pushSet(Vec4());
@@ -1227,18 +1900,7 @@ Color Bitmap::getPixel(int x, int y) const
     if (x < 0 || y < 0 || x >= width() || y >= height())
         return Vec4();
     
-    if (!p->surface)
-    {
-        p->allocSurface();
-        
-        FBO::bind(p->gl.fbo);
-        
-        glState.viewport.pushSet(IntRect(0, 0, width(), height()));
-        
-        gl.ReadPixels(0, 0, width(), height(), GL_RGBA, GL_UNSIGNED_BYTE, p->surface->pixels);
-        
-        glState.viewport.pop();
-    }
+    p->readPixelTile(x, y);
     
     uint32_t pixel = getPixelAt(p->surface, p->format, x, y);
     
@@ -1263,30 +1925,79 @@ void Bitmap::setPixel(int x, int y, const Color &color)
         (uint8_t) clamp<double>(color.alpha, 0, 255)
     };
     
-    TEX::bind(p->gl.tex);
-    TEX::uploadSubImage(x, y, 1, 1, &pixel, GL_RGBA);
+    if (x < 0 || y < 0 || x >= width() || y >= height())
+        return;
     
-    p->addTaintedArea(IntRect(x, y, 1, 1));
+    /* Pending writes mean the texture isn't shared anymore,
+     * and unsharing would flush them */
+    if (p->dirtyTiles == 0)
+        p->unshare();
     
-    /* Setting just a single pixel is no reason to throw away the
-     * whole cached surface; we can just apply the same change */
+    bool defer = shState->config().deferPixelWrites;
+    bool cached = p->pixelCached(x, y);
+    
+    /* Many writes in a row: get tiles to collect them in */
+    if (defer && !cached && ++p->pixelWrites > PIXEL_DEFER_THRESHOLD)
+    {
+        p->readPixelTile(x, y);
+        cached = true;
+    }
     
-    if (p->surface)
+    /* Setting just a single pixel is no reason to throw away the
+     * cached tile; we can just apply the same change */
+    if (cached)
     {
         uint32_t &surfPixel = getPixelAt(p->surface, p->format, x, y);
         surfPixel = SDL_MapRGBA(p->format, pixel[0], pixel[1], pixel[2], pixel[3]);
     }
+    else
+    {
+        /* Don't let a pending readback overwrite it */
+        p->invalidate(IntRect(x, y, 1, 1));
+    }
+    
+    if (defer && cached)
+    {
+        p->addPendingPixel(x, y);
+    }
+    else
+    {
+        TEX::bind(p->gl.tex);
+        TEX::uploadSubImage(x, y, 1, 1, &pixel, GL_RGBA);
+    }
+    
+    p->addTaintedArea(IntRect(x, y, 1, 1));
     
     p->onModified(false);
 }
 
+void Bitmap::requestReadback()
+{
+    guardDisposed();
+    
+    GUARD_MEGA;
+    GUARD_ANIMATED;
+    
+    p->requestReadback();
+}
+
+bool Bitmap::readbackReady()
+{
+    guardDisposed();
+    
+    GUARD_MEGA;
+    GUARD_ANIMATED;
+    
+    return p->pollReadback();
+}
+
 bool Bitmap::getRaw(void *output, int output_size)
 {
     if (output_size != width()*height()*4) return false;
     
     guardDisposed();
     
-    if (!p->animation.enabled && (p->surface || p->megaSurface)) {
+    if (!p->animation.enabled && (p->surfaceComplete() || p->megaSurface)) {
         void *src = (p->megaSurface) ? p->megaSurface->pixels : p->surface->pixels;
         memcpy(output, src, output_size);
     }
@@ -1310,6 +2021,8 @@ void Bitmap::replaceRaw(void *pixel_data, int size)
     if (size != w*h*4)
         throw Exception(Exception::MKXPError, "Replacement bitmap data is not large enough (given %i bytes, need %i)", size, requiredsize);
     
+    p->unshare(false);
+    
     TEX::bind(getGLTypes().tex);
     TEX::uploadImage(w, h, pixel_data, GL_RGBA);
     
@@ -1322,9 +2035,10 @@ void Bitmap::saveToFile(const char *filename)
     guardDisposed();
     
     SDL_Surface *surf;
+    bool ownSurf = false;
     
-    if (p->surface || p->megaSurface) {
-        surf = (p->surface) ? p->surface : p->megaSurface;
+    if (p->surfaceComplete() || p->megaSurface) {
+        surf = (p->megaSurface) ? p->megaSurface : p->surface;
     }
     else {
         surf = SDL_CreateRGBSurface(0, width(), height(),p->format->BitsPerPixel, p->format->Rmask,p->format->Gmask,p->format->Bmask,p->format->Amask);
@@ -1332,11 +2046,23 @@ void Bitmap::saveToFile(const char *filename)
         if (!surf)
             throw Exception(Exception::SDLError, "Failed to prepare bitmap for saving: %s", SDL_GetError());
         
+        ownSurf = true;
         getRaw(surf->pixels, surf->w * surf->h * 4);
     }
     
+    std::string fn_normalized = shState->fileSystem().normalize(filename, 1, 1);
+    bool written = writeSurface(surf, fn_normalized.c_str());
+    
+    if (ownSurf)
+        SDL_FreeSurface(surf);
+    
+    if (!written) throw Exception(Exception::SDLError, "%s", SDL_GetError());
+}
+
+bool Bitmap::writeSurface(SDL_Surface *surf, const char *path)
+{
     // Try and determine the intended image format from the filename extension
-    const char *period = strrchr(filename, '.');
+    const char *period = strrchr(path, '.');
     int filetype = 0;
     if (period) {
         period++;
@@ -1353,24 +2079,20 @@ void Bitmap::saveToFile(const char *filename)
         }
     }
     
-    std::string fn_normalized = shState->fileSystem().normalize(filename, 1, 1);
     int rc;
     switch (filetype) {
         case 2:
-            rc = IMG_SaveJPG(surf, fn_normalized.c_str(), 90);
+            rc = IMG_SaveJPG(surf, path, 90);
             break;
         case 1:
-            rc = IMG_SavePNG(surf, fn_normalized.c_str());
+            rc = IMG_SavePNG(surf, path);
             break;
         case 0: default:
-            rc = SDL_SaveBMP(surf, fn_normalized.c_str());
+            rc = SDL_SaveBMP(surf, path);
             break;
     }
     
-    if (!p->surface && !p->megaSurface)
-        SDL_FreeSurface(surf);
-    
-    if (rc) throw Exception(Exception::SDLError, "%s", SDL_GetError());
+    return rc == 0;
 }
 
 void Bitmap::hueChange(int hue)
@@ -1380,7 +2102,7 @@ void Bitmap::hueChange(int hue)
     GUARD_MEGA;
     GUARD_ANIMATED;
     
-    if ((hue % 360) == 0)
+    if ((hue % 360) == 0 || p->pending())
         return;
     
     TEXFBO newTex = shState->texPool().request(width(), height());
@@ -1406,8 +2128,7 @@ void Bitmap::hueChange(int hue)
     
     TEX::unbind();
     
-    shState->texPool().release(p->gl);
-    p->gl = newTex;
+    p->replaceTex(newTex);
     
     p->onModified();
 }
@@ -1434,6 +2155,35 @@ static std::string fixupString(const char *str)
     return s;
 }
 
+/* The font is identified by its pooled TTF_Font (name and size).
+ * Measurements only depend on the style, while images also take
+ * colors, shadow and outline into account (but not the opacity,
+ * which is applied when they're blended into the bitmap) */
+static std::string textCacheKey(TTF_Font *ttf, Font &font, const char *str, bool image)
+{
+    char buf[64];
+    
+    if (image)
+    {
+        SDL_Color c = font.getColor().toSDLColor();
+        SDL_Color o = font.getOutColor().toSDLColor();
+        
+        if (!font.getOutline())
+            o.r = o.g = o.b = 0;
+        
+        snprintf(buf, sizeof(buf), "%p:%d%d%d%d:%02x%02x%02x:%02x%02x%02x:", (void*) ttf,
+                 font.getBold(), font.getItalic(), font.getShadow(), font.getOutline(),
+                 c.r, c.g, c.b, o.r, o.g, o.b);
+    }
+    else
+    {
+        snprintf(buf, sizeof(buf), "%p:%d%d:", (void*) ttf,
+                 font.getBold(), font.getItalic());
+    }
+    
+    return std::string(buf) + str;
+}
+
 static void applyShadow(SDL_Surface *&in, const SDL_PixelFormat &fm, const SDL_Color &c)
 {
     SDL_Surface *out = SDL_CreateRGBSurface
@@ -1537,6 +2287,8 @@ void Bitmap::drawText(const IntRect &rect, const char *str, int align)
     if (str[0] == ' ' && str[1] == '\0')
         return;
     
+    p->unshare();
+    
     TTF_Font *font = p->font->getSdlFont();
     const Color &fontColor = p->font->getColor();
     const Color &outColor = p->font->getOutColor();
@@ -1546,49 +2298,92 @@ void Bitmap::drawText(const IntRect &rect, const char *str, int align)
     
     float txtAlpha = fontColor.norm.w;
     
-    SDL_Surface *txtSurf;
-    
-    if (p->font->isSolid())
-        txtSurf = TTF_RenderUTF8_Solid(font, str, c);
-    else
-        txtSurf = TTF_RenderUTF8_Blended(font, str, c);
-    
-    if (!txtSurf)
-        throw Exception(Exception::SDLError, "Failed to render text: %s", TTF_GetError());
+    /* Size of the text image, wherever it ends up */
+    Vec2i txtSize;
+    int rawTxtSurfH;
     
-    p->ensureFormat(txtSurf, SDL_PIXELFORMAT_ABGR8888);
+    TEXFBO *txtTex = 0;
+    SDL_Surface *txtSurf = 0;
     
-    int rawTxtSurfH = txtSurf->h;
+    TextCache &textCache = shState->textCache();
+    std::string cacheKey;
     
-    if (p->font->getShadow())
-        applyShadow(txtSurf, *p->format, c);
+    if (textCache.enabled())
+    {
+        cacheKey = textCacheKey(font, *p->font, str, true);
+        txtTex = textCache.lookup(cacheKey, txtSize, rawTxtSurfH);
+    }
     
-    /* outline using TTF_Outline and blending it together with SDL_BlitSurface
-     * FIXME: outline is forced to have the same opacity as the font color */
-    if (p->font->getOutline())
+    if (!txtTex)
     {
-        SDL_Color co = outColor.toSDLColor();
-        co.a = 255;
-        SDL_Surface *outline;
-        /* set the next font render to render the outline */
-        TTF_SetFontOutline(font, OUTLINE_SIZE);
         if (p->font->isSolid())
-            outline = TTF_RenderUTF8_Solid(font, str, co);
+            shState->glyphAtlas().countFallback();
         else
-            outline = TTF_RenderUTF8_Blended(font, str, co);
-        
-        if (!outline)
-            throw Exception(Exception::SDLError, "Failed to render text outline: %s", TTF_GetError());
+            txtTex = shState->glyphAtlas().render(font, str, fontColor.norm, outColor.norm,
+                                                  p->font->getShadow(),
+                                                  p->font->getOutline() ? OUTLINE_SIZE : 0,
+                                                  txtSize, rawTxtSurfH);
         
-        p->ensureFormat(outline, SDL_PIXELFORMAT_ABGR8888);
-        SDL_Rect outRect = {OUTLINE_SIZE, OUTLINE_SIZE, txtSurf->w, txtSurf->h};
+        if (!txtTex)
+        {
+            if (p->font->isSolid())
+                txtSurf = TTF_RenderUTF8_Solid(font, str, c);
+            else
+                txtSurf = TTF_RenderUTF8_Blended(font, str, c);
+            
+            if (!txtSurf)
+                throw Exception(Exception::SDLError, "Failed to render text: %s", TTF_GetError());
+            
+            p->ensureFormat(txtSurf, SDL_PIXELFORMAT_ABGR8888);
+            
+            rawTxtSurfH = txtSurf->h;
+            
+            if (p->font->getShadow())
+                applyShadow(txtSurf, *p->format, c);
+            
+            /* outline using TTF_Outline and blending it together with SDL_BlitSurface
+             * FIXME: outline is forced to have the same opacity as the font color */
+            if (p->font->getOutline())
+            {
+                SDL_Color co = outColor.toSDLColor();
+                co.a = 255;
+                SDL_Surface *outline;
+                /* set the next font render to render the outline */
+                TTF_SetFontOutline(font, OUTLINE_SIZE);
+                if (p->font->isSolid())
+                    outline = TTF_RenderUTF8_Solid(font, str, co);
+                else
+                    outline = TTF_RenderUTF8_Blended(font, str, co);
+            
+                if (!outline)
+                    throw Exception(Exception::SDLError, "Failed to render text outline: %s", TTF_GetError());
+            
+                p->ensureFormat(outline, SDL_PIXELFORMAT_ABGR8888);
+                SDL_Rect outRect = {OUTLINE_SIZE, OUTLINE_SIZE, txtSurf->w, txtSurf->h};
+            
+                SDL_SetSurfaceBlendMode(txtSurf, SDL_BLENDMODE_BLEND);
+                SDL_BlitSurface(txtSurf, NULL, outline, &outRect);
+                SDL_FreeSurface(txtSurf);
+                txtSurf = outline;
+                /* reset outline to 0 */
+                TTF_SetFontOutline(font, 0);
+            }
+            
+            txtSize = Vec2i(txtSurf->w, txtSurf->h);
+        }
         
-        SDL_SetSurfaceBlendMode(txtSurf, SDL_BLENDMODE_BLEND);
-        SDL_BlitSurface(txtSurf, NULL, outline, &outRect);
-        SDL_FreeSurface(txtSurf);
-        txtSurf = outline;
-        /* reset outline to 0 */
-        TTF_SetFontOutline(font, 0);
+        if (!cacheKey.empty())
+        {
+            TEXFBO *cached = textCache.store(cacheKey, txtTex, txtSurf,
+                                             txtSize, rawTxtSurfH);
+            
+            if (cached)
+            {
+                txtTex = cached;
+                SDL_FreeSurface(txtSurf);
+                txtSurf = 0;
+            }
+        }
     }
     
     int alignX = rect.x;
@@ -1600,11 +2395,11 @@ void Bitmap::drawText(const IntRect &rect, const char *str, int align)
             break;
             
         case Center :
-            alignX += (rect.w - txtSurf->w) / 2;
+            alignX += (rect.w - txtSize.x) / 2;
             break;
             
         case Right :
-            alignX += rect.w - txtSurf->w;
+            alignX += rect.w - txtSize.x;
             break;
     }
     
@@ -1613,21 +2408,34 @@ void Bitmap::drawText(const IntRect &rect, const char *str, int align)
     
     int alignY = rect.y + (rect.h - rawTxtSurfH) / 2;
     
-    float squeeze = (float) rect.w / txtSurf->w;
+    float squeeze = (float) rect.w / txtSize.x;
     
     if (squeeze > 1)
         squeeze = 1;
     
-    FloatRect posRect(alignX, alignY, txtSurf->w * squeeze, txtSurf->h);
+    FloatRect posRect(alignX, alignY, txtSize.x * squeeze, txtSize.y);
     
     Vec2i gpTexSize;
-    shState->ensureTexSize(txtSurf->w, txtSurf->h, gpTexSize);
+    
+    if (txtTex)
+        gpTexSize = Vec2i(txtTex->width, txtTex->height);
+    else
+        shState->ensureTexSize(txtSize.x, txtSize.y, gpTexSize);
     
     bool fastBlit = !p->touchesTaintedArea(posRect) && txtAlpha == 1.0f;
     
     if (fastBlit)
     {
-        if (squeeze == 1.0f && !shState->config().subImageFix)
+        if (txtTex)
+        {
+            /* Already on the GPU, just copy it over */
+            GLMeta::blitBegin(p->gl);
+            GLMeta::blitSource(*txtTex);
+            GLMeta::blitRectangle(IntRect(0, 0, txtSize.x, txtSize.y),
+                                  posRect, squeeze != 1.0f);
+            GLMeta::blitEnd();
+        }
+        else if (squeeze == 1.0f && !shState->config().subImageFix)
         {
             /* Even faster: upload directly to bitmap texture.
              * We have to make sure the posRect lies within the texture
@@ -1677,7 +2485,7 @@ void Bitmap::drawText(const IntRect &rect, const char *str, int align)
                 }
                 else
                 {
-                    GLMeta::subRectImageUpload(txtSurf->w, subSrcX, subSrcY,
+                    GLMeta::subRectImageUpload(txtSize.x, subSrcX, subSrcY,
                                                posRect.x, posRect.y,
                                                posRect.w, posRect.h,
                                                txtSurf, GL_RGBA);
@@ -1688,14 +2496,14 @@ void Bitmap::drawText(const IntRect &rect, const char *str, int align)
         else
         {
             /* Squeezing involved: need to use intermediary TexFBO */
-            TEXFBO &gpTF = shState->gpTexFBO(txtSurf->w, txtSurf->h);
+            TEXFBO &gpTF = shState->gpTexFBO(txtSize.x, txtSize.y);
             
             TEX::bind(gpTF.tex);
-            TEX::uploadSubImage(0, 0, txtSurf->w, txtSurf->h, txtSurf->pixels, GL_RGBA);
+            TEX::uploadSubImage(0, 0, txtSize.x, txtSize.y, txtSurf->pixels, GL_RGBA);
             
             GLMeta::blitBegin(p->gl);
             GLMeta::blitSource(gpTF);
-            GLMeta::blitRectangle(IntRect(0, 0, txtSurf->w, txtSurf->h),
+            GLMeta::blitRectangle(IntRect(0, 0, txtSize.x, txtSize.y),
                                   posRect, true);
             GLMeta::blitEnd();
         }
@@ -1723,12 +2531,20 @@ void Bitmap::drawText(const IntRect &rect, const char *str, int align)
         shader.setSubRect(bltRect);
         shader.setOpacity(txtAlpha);
         
-        shState->bindTex();
-        TEX::uploadSubImage(0, 0, txtSurf->w, txtSurf->h, txtSurf->pixels, GL_RGBA);
+        if (txtTex)
+        {
+            TEX::bind(txtTex->tex);
+        }
+        else
+        {
+            shState->bindTex();
+            TEX::uploadSubImage(0, 0, txtSize.x, txtSize.y, txtSurf->pixels, GL_RGBA);
+        }
+        
         TEX::setSmooth(true);
         
         Quad &quad = shState->gpQuad();
-        quad.setTexRect(FloatRect(0, 0, txtSurf->w, txtSurf->h));
+        quad.setTexRect(FloatRect(0, 0, txtSize.x, txtSize.y));
         quad.setPosRect(posRect);
         
         p->bindFBO();
@@ -1742,7 +2558,10 @@ void Bitmap::drawText(const IntRect &rect, const char *str, int align)
     SDL_FreeSurface(txtSurf);
     p->addTaintedArea(posRect);
     
-    p->onModified();
+    int x0 = floor(posRect.x), y0 = floor(posRect.y);
+    p->onModified(IntRect(x0, y0,
+                          ceil(posRect.x + posRect.w) - x0,
+                          ceil(posRect.y + posRect.h) - y0));
 }
 
 /* http://www.lemoda.net/c/utf8-to-ucs2/index.html */
@@ -1801,6 +2620,18 @@ IntRect Bitmap::textSize(const char *str)
     std::string fixed = fixupString(str);
     str = fixed.c_str();
     
+    TextCache &textCache = shState->textCache();
+    std::string cacheKey;
+    IntRect cached;
+    
+    if (textCache.enabled())
+    {
+        cacheKey = textCacheKey(font, *p->font, str, false);
+        
+        if (textCache.lookupSize(cacheKey, cached))
+            return cached;
+    }
+    
     int w, h;
     TTF_SizeUTF8(font, str, &w, &h);
     
@@ -1813,6 +2644,9 @@ IntRect Bitmap::textSize(const char *str)
     if (p->font->getItalic() && *endPtr == '\0')
         TTF_GlyphMetrics(font, ucs2, 0, 0, 0, 0, &w);
     
+    if (!cacheKey.empty())
+        textCache.storeSize(cacheKey, IntRect(0, 0, w, h));
+    
     return IntRect(0, 0, w, h);
 }
 
@@ -1830,12 +2664,14 @@ void Bitmap::setInitFont(Font *value)
 
 TEXFBO &Bitmap::getGLTypes() const
 {
+    p->touchCache();
+    
     return p->getGLTypes();
 }
 
 SDL_Surface *Bitmap::surface() const
 {
-    return p->surface;
+    return p->surfaceComplete() ? p->surface : 0;
 }
 
 SDL_Surface *Bitmap::megaSurface() const
@@ -1949,6 +2785,8 @@ int Bitmap::addFrame(Bitmap &source, int position)
     
     // Convert the bitmap into an animated bitmap if it isn't already one
     if (!p->animation.enabled) {
+        p->unshare();
+        
         p->animation.width = p->gl.width;
         p->animation.height = p->gl.height;
         p->animation.enabled = true;
@@ -1961,16 +2799,14 @@ int Bitmap::addFrame(Bitmap &source, int position)
         
         p->animation.frames.push_back(p->gl);
         
-        if (p->surface)
-            SDL_FreeSurface(p->surface);
+        p->freeSurface();
         p->gl = TEXFBO();
     }
     
     if (source.surface()) {
         TEX::bind(newframe.tex);
         TEX::uploadImage(source.width(), source.height(), source.surface()->pixels, GL_RGBA);
-        SDL_FreeSurface(p->surface);
-        p->surface = 0;
+        p->freeSurface();
     }
     else {
         GLMeta::blitBegin(newframe);
@@ -2106,12 +2942,49 @@ void Bitmap::bindTex(ShaderBase &shader)
 void Bitmap::taintArea(const IntRect &rect)
 {
     p->addTaintedArea(rect);
+    p->invalidate(rect);
+}
+
+bool Bitmap::storagePending() const
+{
+    return p->pending();
+}
+
+Bitmap::StorageStats Bitmap::storageStats()
+{
+    return emptyStorage;
 }
 
 int Bitmap::maxSize(){
     return glState.caps.maxTexSize;
 }
 
+unsigned int Bitmap::preload(const std::vector<std::string> &filenames)
+{
+    DecodePool &pool = shState->decodePool();
+    unsigned int batch = pool.newBatch();
+    
+    for (size_t i = 0; i < filenames.size(); ++i)
+    {
+        const char *filename = filenames[i].c_str();
+        
+        pool.enqueue(batch, bitmapKey(filename),
+                     new BitmapDecodeJob(shState->fileSystem(), filename));
+    }
+    
+    return batch;
+}
+
+bool Bitmap::preloadDone(unsigned int handle)
+{
+    return shState->decodePool().batchDone(handle);
+}
+
+void Bitmap::releasePreload(unsigned int handle)
+{
+    shState->decodePool().releaseBatch(handle);
+}
+
 // This might look ridiculous, but apparently, it is possible
 // to encounter seemingly empty bitmaps during Graphics::update,
 // or specifically, during a Sprite's prepare function.
@@ -2132,6 +3005,9 @@ bool Bitmap::invalid() const {
 
 void Bitmap::releaseResources()
 {
+    p->discardPixels();
+    p->freeSurface();
+    
     if (p->megaSurface)
         SDL_FreeSurface(p->megaSurface);
     else if (p->animation.enabled) {
@@ -2140,8 +3016,15 @@ void Bitmap::releaseResources()
         for (TEXFBO &tex : p->animation.frames)
             shState->texPool().release(tex);
     }
-    else
+    else if (p->cacheEntry)
+        shState->bitmapCache().release(p->cacheEntry);
+    else if (!p->pending())
         shState->texPool().release(p->gl);
     
+    emptyStorage.nominalBytes -= p->emptyBytes;
+    
+    if (!p->pending())
+        emptyStorage.committedBytes -= p->emptyBytes;
+    
     delete p;
 }
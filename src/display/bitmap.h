@@ -28,6 +28,10 @@
 
 #include "sigslot/signal.hpp"
 
+#include <stdint.h>
+#include <string>
+#include <vector>
+
 class Font;
 class ShaderBase;
 struct TEXFBO;
@@ -86,6 +90,11 @@ public:
 
 	Color getPixel(int x, int y) const;
 	void setPixel(int x, int y, const Color &color);
+
+	/* Starts reading back the whole bitmap without waiting for
+	 * the GPU; getPixel won't stall on it once it's ready */
+	void requestReadback();
+	bool readbackReady();
     
     bool getRaw(void *output, int output_size);
     void replaceRaw(void *pixel_data, int size);
@@ -155,9 +164,38 @@ public:
 	/* Adds 'rect' to tainted area */
 	void taintArea(const IntRect &rect);
 
+	/* Whether this was created empty and never written to;
+	 * such a bitmap has no texture yet and draws nothing */
+	bool storagePending() const;
+
+	/* Texture memory of bitmaps created empty: 'nominal' is
+	 * what they'd take up if allocated up front, 'committed'
+	 * what was actually allocated after they were written to */
+	struct StorageStats
+	{
+		uint64_t nominalBytes;
+		uint64_t committedBytes;
+	};
+
+	static StorageStats storageStats();
+
 	sigslot::signal<> modified;
 
 	static int maxSize();
+
+	/* Encodes 'surf' into 'path' (already normalized), picking the
+	 * format from its extension. Touches no GL or filesystem state,
+	 * so it may run on any thread. On failure, SDL_GetError() says why */
+	static bool writeSurface(SDL_Surface *surf, const char *path);
+
+	/* Starts decoding 'filenames' on background threads. A later
+	 * Bitmap(filename) for one of them only uploads the result.
+	 * Returns a handle for 'preloadDone()' / 'releasePreload()' */
+	static unsigned int preload(const std::vector<std::string> &filenames);
+	static bool preloadDone(unsigned int handle);
+
+	/* Frees preloaded images that were never used */
+	static void releasePreload(unsigned int handle);
     
     bool invalid() const;
 
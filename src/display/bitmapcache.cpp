@@ -0,0 +1,251 @@
+/*
+** bitmapcache.cpp
+**
+** This file is part of mkxp.
+**
+** Copyright (C) 2013 - 2021 Amaryllis Kulla <ancurio@mapleshrine.eu>
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "bitmapcache.h"
+
+#include "sharedstate.h"
+#include "texpool.h"
+#include "gl-meta.h"
+#include "boost-hash.h"
+#include "intrulist.h"
+
+#include <assert.h>
+
+static uint64_t byteCount(const TEXFBO &tex)
+{
+	return (uint64_t) tex.width * tex.height * 4;
+}
+
+struct BitmapCacheEntry
+{
+	std::string key;
+	TEXFBO tex;
+
+	/* Number of Bitmaps using 'tex' */
+	unsigned int refCount;
+
+	/* False once evicted; the entry then only lives
+	 * on until its last Bitmap lets go of it */
+	bool cached;
+
+	/* Most recently drawn entries are at the front */
+	IntruListLink<BitmapCacheEntry> link;
+
+	BitmapCacheEntry(const std::string &key, const TEXFBO &tex)
+	    : key(key),
+	      tex(tex),
+	      refCount(1),
+	      cached(true),
+	      link(this)
+	{}
+};
+
+struct BitmapCachePrivate
+{
+	BoostHash<std::string, BitmapCacheEntry*> entries;
+	IntruList<BitmapCacheEntry> lru;
+
+	const uint64_t maxMemSize;
+	uint64_t memSize;
+	uint64_t idleMemSize;
+
+	BitmapCache::Stats stats;
+
+	BitmapCachePrivate(uint64_t maxMemSize)
+	    : maxMemSize(maxMemSize),
+	      memSize(0),
+	      idleMemSize(0)
+	{
+		stats.hits = 0;
+		stats.misses = 0;
+		stats.evictions = 0;
+	}
+
+	void evict(BitmapCacheEntry *entry)
+	{
+		entries.remove(entry->key);
+		lru.remove(entry->link);
+		memSize -= byteCount(entry->tex);
+		entry->cached = false;
+
+		if (entry->refCount == 0)
+		{
+			idleMemSize -= byteCount(entry->tex);
+			destroy(entry);
+		}
+	}
+
+	void destroy(BitmapCacheEntry *entry)
+	{
+		shState->texPool().release(entry->tex);
+		delete entry;
+	}
+
+	/* Evicts idle entries, least recently drawn first */
+	void trim()
+	{
+		IntruListLink<BitmapCacheEntry> *node = lru.end()->prev;
+
+		while (idleMemSize > maxMemSize && node != lru.end())
+		{
+			BitmapCacheEntry *entry = node->data;
+			node = node->prev;
+
+			if (entry->refCount > 0)
+				continue;
+
+			evict(entry);
+			++stats.evictions;
+		}
+	}
+};
+
+BitmapCache::BitmapCache(uint64_t maxMemSize)
+{
+	p = new BitmapCachePrivate(maxMemSize);
+}
+
+BitmapCache::~BitmapCache()
+{
+	/* Bitmaps are gone by now, don't recycle into the TexPool */
+	BoostHash<std::string, BitmapCacheEntry*>::const_iterator iter;
+
+	for (iter = p->entries.cbegin(); iter != p->entries.cend(); ++iter)
+	{
+		TEXFBO::fini(iter->second->tex);
+		delete iter->second;
+	}
+
+	delete p;
+}
+
+bool BitmapCache::enabled() const
+{
+	return p->maxMemSize > 0;
+}
+
+BitmapCacheEntry *BitmapCache::acquire(const std::string &key, TEXFBO &out)
+{
+	if (!p->entries.contains(key))
+	{
+		++p->stats.misses;
+		return 0;
+	}
+
+	BitmapCacheEntry *entry = p->entries[key];
+
+	if (entry->refCount++ == 0)
+		p->idleMemSize -= byteCount(entry->tex);
+
+	touch(entry);
+
+	out = entry->tex;
+	++p->stats.hits;
+
+	return entry;
+}
+
+BitmapCacheEntry *BitmapCache::insert(const std::string &key, const TEXFBO &tex)
+{
+	/* Shouldn't happen as 'acquire()' would have hit,
+	 * but don't leak the old entry if it does */
+	if (p->entries.contains(key))
+		p->evict(p->entries[key]);
+
+	BitmapCacheEntry *entry = new BitmapCacheEntry(key, tex);
+
+	p->entries.insert(key, entry);
+	p->lru.prepend(entry->link);
+	p->memSize += byteCount(tex);
+
+	return entry;
+}
+
+void BitmapCache::release(BitmapCacheEntry *entry)
+{
+	assert(entry->refCount > 0);
+
+	if (--entry->refCount > 0)
+		return;
+
+	if (!entry->cached)
+	{
+		p->destroy(entry);
+		return;
+	}
+
+	p->idleMemSize += byteCount(entry->tex);
+	p->trim();
+}
+
+void BitmapCache::unshare(BitmapCacheEntry *entry, TEXFBO &tex, bool keepContents)
+{
+	/* Already evicted and nobody else is using it,
+	 * so the texture can simply be taken over */
+	if (!entry->cached && entry->refCount == 1)
+	{
+		tex = entry->tex;
+		delete entry;
+
+		return;
+	}
+
+	tex = shState->texPool().request(entry->tex.width, entry->tex.height);
+
+	if (keepContents)
+	{
+		IntRect rect(0, 0, tex.width, tex.height);
+
+		GLMeta::blitBegin(tex);
+		GLMeta::blitSource(entry->tex);
+		GLMeta::blitRectangle(rect, Vec2i());
+		GLMeta::blitEnd();
+	}
+
+	release(entry);
+}
+
+void BitmapCache::touch(BitmapCacheEntry *entry)
+{
+	if (!entry->cached)
+		return;
+
+	p->lru.remove(entry->link);
+	p->lru.prepend(entry->link);
+}
+
+void BitmapCache::clear()
+{
+	while (!p->lru.isEmpty())
+		p->evict(p->lru.tail());
+}
+
+BitmapCache::Stats BitmapCache::stats() const
+{
+	Stats stats = p->stats;
+
+	stats.entries = p->lru.getSize();
+	stats.memSize = p->memSize;
+	stats.idleMemSize = p->idleMemSize;
+	stats.maxMemSize = p->maxMemSize;
+
+	return stats;
+}
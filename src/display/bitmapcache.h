@@ -0,0 +1,93 @@
+/*
+** bitmapcache.h
+**
+** This file is part of mkxp.
+**
+** Copyright (C) 2013 - 2021 Amaryllis Kulla <ancurio@mapleshrine.eu>
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BITMAPCACHE_H
+#define BITMAPCACHE_H
+
+#include "gl-util.h"
+
+#include <stdint.h>
+#include <string>
+
+struct BitmapCacheEntry;
+struct BitmapCachePrivate;
+
+/* Shares the textures of image files loaded through Bitmap(filename)
+ * between all Bitmaps created from the same path. A Bitmap holding
+ * a shared texture must call 'unshare()' before modifying it.
+ *
+ * Textures no Bitmap refers to anymore stay cached until they exceed
+ * the memory budget, at which point the least recently drawn of them
+ * are evicted. Textures still in use don't count against the budget
+ * and are never evicted by it (that would free nothing, and only
+ * lead to the file being loaded a second time). */
+class BitmapCache
+{
+public:
+	struct Stats
+	{
+		uint64_t hits;
+		uint64_t misses;
+		uint64_t evictions;
+
+		uint32_t entries;
+		uint64_t memSize;
+		/* Part of 'memSize' no Bitmap is using */
+		uint64_t idleMemSize;
+		uint64_t maxMemSize;
+	};
+
+	/* A 'maxMemSize' of 0 disables the cache */
+	BitmapCache(uint64_t maxMemSize);
+	~BitmapCache();
+
+	bool enabled() const;
+
+	/* On a hit, adds a reference to the cached texture
+	 * and stores it in 'out'. Returns null on a miss */
+	BitmapCacheEntry *acquire(const std::string &key, TEXFBO &out);
+
+	/* Transfers ownership of 'tex' to the cache. The returned
+	 * entry holds one reference for the calling Bitmap */
+	BitmapCacheEntry *insert(const std::string &key, const TEXFBO &tex);
+
+	/* Drops one reference */
+	void release(BitmapCacheEntry *entry);
+
+	/* Replaces the reference in 'entry' with a texture owned
+	 * solely by the caller, written to 'tex'. Copies the
+	 * contents only if 'keepContents' is set */
+	void unshare(BitmapCacheEntry *entry, TEXFBO &tex, bool keepContents);
+
+	/* Marks 'entry' as most recently drawn */
+	void touch(BitmapCacheEntry *entry);
+
+	/* Frees every texture not in use, and stops handing
+	 * out the ones that are */
+	void clear();
+
+	Stats stats() const;
+
+private:
+	BitmapCachePrivate *p;
+};
+
+#endif // BITMAPCACHE_H
@@ -0,0 +1,336 @@
+/*
+** decodepool.cpp
+**
+** This file is part of mkxp.
+**
+** Copyright (C) 2013 - 2021 Amaryllis Kulla <ancurio@mapleshrine.eu>
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "decodepool.h"
+
+#include "boost-hash.h"
+#include "sdl-util.h"
+
+#include <SDL_cpuinfo.h>
+#include <SDL_mutex.h>
+
+#include <algorithm>
+#include <deque>
+#include <vector>
+
+/* Decoding is mostly bound by zlib/libjpeg, and the
+ * RGSS thread still needs a core of its own */
+#define MAX_WORKERS 4
+
+struct PoolEntry
+{
+	enum State
+	{
+		Queued,
+		Running,
+		Done
+	};
+
+	DecodePool::Job *job;
+	/* Every batch this job was requested for */
+	std::vector<unsigned int> batches;
+	State state;
+
+	/* Released while running; the worker frees it */
+	bool dropped;
+
+	PoolEntry(DecodePool::Job *job, unsigned int batch)
+	    : job(job),
+	      batches(1, batch),
+	      state(Queued),
+	      dropped(false)
+	{}
+
+	bool inBatch(unsigned int batch) const
+	{
+		return std::find(batches.begin(), batches.end(), batch) != batches.end();
+	}
+
+	~PoolEntry()
+	{
+		delete job;
+	}
+};
+
+struct DecodePoolPrivate
+{
+	SDL_mutex *mutex;
+
+	/* Signaled when new work is queued (or on shutdown) */
+	SDL_cond *workCond;
+	/* Signaled whenever a job finishes */
+	SDL_cond *doneCond;
+
+	std::vector<SDL_Thread*> workers;
+
+	/* Every entry not yet taken or released */
+	BoostHash<std::string, PoolEntry*> entries;
+	std::deque<PoolEntry*> queue;
+
+	unsigned int running;
+	unsigned int batchCounter;
+	bool quit;
+
+	DecodePoolPrivate()
+	    : running(0),
+	      batchCounter(0),
+	      quit(false)
+	{
+		mutex = SDL_CreateMutex();
+		workCond = SDL_CreateCond();
+		doneCond = SDL_CreateCond();
+	}
+
+	~DecodePoolPrivate()
+	{
+		SDL_DestroyCond(doneCond);
+		SDL_DestroyCond(workCond);
+		SDL_DestroyMutex(mutex);
+	}
+
+	void startWorkers()
+	{
+		int count = SDL_GetCPUCount() - 1;
+		count = std::max(1, std::min(count, MAX_WORKERS));
+
+		for (int i = 0; i < count; ++i)
+			workers.push_back(createSDLThread
+				<DecodePoolPrivate, &DecodePoolPrivate::workerFun>(this, "decode"));
+	}
+
+	void unqueue(PoolEntry *entry)
+	{
+		std::deque<PoolEntry*>::iterator iter =
+			std::find(queue.begin(), queue.end(), entry);
+
+		if (iter != queue.end())
+			queue.erase(iter);
+	}
+
+	void workerFun()
+	{
+		SDL_LockMutex(mutex);
+
+		while (true)
+		{
+			while (queue.empty() && !quit)
+				SDL_CondWait(workCond, mutex);
+
+			if (quit)
+				break;
+
+			PoolEntry *entry = queue.front();
+			queue.pop_front();
+
+			entry->state = PoolEntry::Running;
+			++running;
+
+			SDL_UnlockMutex(mutex);
+			entry->job->run();
+			SDL_LockMutex(mutex);
+
+			entry->state = PoolEntry::Done;
+			--running;
+
+			if (entry->dropped)
+				delete entry;
+
+			SDL_CondBroadcast(doneCond);
+		}
+
+		SDL_UnlockMutex(mutex);
+	}
+};
+
+DecodePool::DecodePool()
+{
+	p = new DecodePoolPrivate;
+}
+
+DecodePool::~DecodePool()
+{
+	SDL_LockMutex(p->mutex);
+	p->quit = true;
+	SDL_CondBroadcast(p->workCond);
+	SDL_UnlockMutex(p->mutex);
+
+	for (size_t i = 0; i < p->workers.size(); ++i)
+		SDL_WaitThread(p->workers[i], 0);
+
+	BoostHash<std::string, PoolEntry*>::const_iterator iter;
+
+	for (iter = p->entries.cbegin(); iter != p->entries.cend(); ++iter)
+		delete iter->second;
+
+	delete p;
+}
+
+unsigned int DecodePool::newBatch()
+{
+	SDL_LockMutex(p->mutex);
+	unsigned int batch = ++p->batchCounter;
+	SDL_UnlockMutex(p->mutex);
+
+	return batch;
+}
+
+void DecodePool::enqueue(unsigned int batch, const std::string &key, Job *job)
+{
+	SDL_LockMutex(p->mutex);
+
+	if (p->entries.contains(key))
+	{
+		PoolEntry *entry = p->entries[key];
+
+		if (!entry->inBatch(batch))
+			entry->batches.push_back(batch);
+
+		SDL_UnlockMutex(p->mutex);
+		delete job;
+
+		return;
+	}
+
+	if (p->workers.empty())
+		p->startWorkers();
+
+	PoolEntry *entry = new PoolEntry(job, batch);
+	p->entries.insert(key, entry);
+	p->queue.push_back(entry);
+
+	SDL_CondSignal(p->workCond);
+	SDL_UnlockMutex(p->mutex);
+}
+
+bool DecodePool::batchDone(unsigned int batch)
+{
+	bool done = true;
+
+	SDL_LockMutex(p->mutex);
+
+	BoostHash<std::string, PoolEntry*>::const_iterator iter;
+
+	for (iter = p->entries.cbegin(); iter != p->entries.cend(); ++iter)
+	{
+		const PoolEntry *entry = iter->second;
+
+		if (entry->state != PoolEntry::Done && entry->inBatch(batch))
+		{
+			done = false;
+			break;
+		}
+	}
+
+	SDL_UnlockMutex(p->mutex);
+
+	return done;
+}
+
+void DecodePool::releaseBatch(unsigned int batch)
+{
+	SDL_LockMutex(p->mutex);
+
+	std::vector<std::string> keys;
+	BoostHash<std::string, PoolEntry*>::const_iterator iter;
+
+	for (iter = p->entries.cbegin(); iter != p->entries.cend(); ++iter)
+		if (iter->second->inBatch(batch))
+			keys.push_back(iter->first);
+
+	for (size_t i = 0; i < keys.size(); ++i)
+	{
+		PoolEntry *entry = p->entries[keys[i]];
+
+		std::vector<unsigned int> &batches = entry->batches;
+		batches.erase(std::find(batches.begin(), batches.end(), batch));
+
+		/* Still wanted by another batch */
+		if (!batches.empty())
+			continue;
+
+		p->entries.remove(keys[i]);
+
+		switch (entry->state)
+		{
+		case PoolEntry::Queued :
+			p->unqueue(entry);
+			delete entry;
+			break;
+
+		case PoolEntry::Running :
+			entry->dropped = true;
+			break;
+
+		case PoolEntry::Done :
+			delete entry;
+			break;
+		}
+	}
+
+	SDL_UnlockMutex(p->mutex);
+}
+
+DecodePool::Job *DecodePool::take(const std::string &key)
+{
+	SDL_LockMutex(p->mutex);
+
+	if (!p->entries.contains(key))
+	{
+		SDL_UnlockMutex(p->mutex);
+		return 0;
+	}
+
+	PoolEntry *entry = p->entries[key];
+	p->entries.remove(key);
+
+	if (entry->state == PoolEntry::Queued)
+	{
+		/* Nobody got to it yet, faster to just
+		 * run it here than to wait for a worker */
+		p->unqueue(entry);
+		SDL_UnlockMutex(p->mutex);
+
+		entry->job->run();
+	}
+	else
+	{
+		while (entry->state != PoolEntry::Done)
+			SDL_CondWait(p->doneCond, p->mutex);
+
+		SDL_UnlockMutex(p->mutex);
+	}
+
+	Job *job = entry->job;
+	entry->job = 0;
+	delete entry;
+
+	return job;
+}
+
+void DecodePool::wait()
+{
+	SDL_LockMutex(p->mutex);
+
+	while (!p->queue.empty() || p->running > 0)
+		SDL_CondWait(p->doneCond, p->mutex);
+
+	SDL_UnlockMutex(p->mutex);
+}
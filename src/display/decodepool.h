@@ -0,0 +1,79 @@
+/*
+** decodepool.h
+**
+** This file is part of mkxp.
+**
+** Copyright (C) 2013 - 2021 Amaryllis Kulla <ancurio@mapleshrine.eu>
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef DECODEPOOL_H
+#define DECODEPOOL_H
+
+#include <string>
+
+struct DecodePoolPrivate;
+
+/* A small pool of worker threads that run file decoding jobs
+ * (eg. image files into CPU side surfaces) ahead of time, so
+ * the RGSS thread only has to pick up the result later.
+ *
+ * Jobs are keyed by a string, and grouped into batches which
+ * can be polled for completion and released as a whole.
+ * Workers are only spawned once the first job is queued. */
+class DecodePool
+{
+public:
+	struct Job
+	{
+		virtual ~Job() {}
+
+		/* Called on a worker thread, or on the thread
+		 * calling 'take()' if the job hadn't started yet.
+		 * Must neither throw nor touch any GL state */
+		virtual void run() = 0;
+	};
+
+	DecodePool();
+	~DecodePool();
+
+	unsigned int newBatch();
+
+	/* Takes ownership of 'job'. If a job with the same key
+	 * is already pending, 'job' is deleted right away and the
+	 * pending one becomes part of 'batch' as well */
+	void enqueue(unsigned int batch, const std::string &key, Job *job);
+
+	/* Returns true once every job in 'batch' has finished
+	 * (or was taken) */
+	bool batchDone(unsigned int batch);
+
+	/* Discards all results of 'batch' that weren't taken yet,
+	 * unless another batch not yet released shares them */
+	void releaseBatch(unsigned int batch);
+
+	/* Removes the job for 'key' and returns it after it has run,
+	 * waiting for it if necessary. Ownership passes to the caller.
+	 * Returns null if no such job was queued */
+	Job *take(const std::string &key);
+
+	/* Blocks until no job is running or queued anymore */
+	void wait();
+
+private:
+	DecodePoolPrivate *p;
+};
+
+#endif // DECODEPOOL_H
@@ -97,6 +97,7 @@ void initGLFunctions()
     
     /* Assume single digit */
     int glMajor = *ver - '0';
+    int glMinor = (ver[1] == '.') ? ver[2] - '0' : 0;
     
     if (glMajor < 2)
 #ifndef GLES2_HEADER
@@ -177,6 +178,47 @@ void initGLFunctions()
         GL_VAO_FUN;
     }
     
+    /* Program binary entrypoints */
+    if (HAVE_EXT(ARB_get_program_binary) || (gles && glMajor >= 3))
+    {
+#undef EXT_SUFFIX
+#define EXT_SUFFIX ""
+        GL_PROGRAM_BINARY_FUN;
+        GL_PROGRAM_PARAMETER_FUN;
+    }
+    else if (HAVE_EXT(OES_get_program_binary))
+    {
+        /* Binaries are always retrievable here */
+#undef EXT_SUFFIX
+#define EXT_SUFFIX "OES"
+        GL_PROGRAM_BINARY_FUN;
+    }
+    
+    /* Pixel pack buffer mapping and fences (async readback) */
+    bool haveSync = gles ? glMajor >= 3 :
+        (glMajor > 3 || (glMajor == 3 && glMinor >= 2) || HAVE_EXT(ARB_sync));
+    
+    if (haveSync && (glMajor >= 3 || HAVE_EXT(ARB_map_buffer_range)))
+    {
+#undef EXT_SUFFIX
+#define EXT_SUFFIX ""
+        GL_READBACK_FUN;
+    }
+    
+    /* Timestamp queries (profiler) */
+    if (!gles && (glMajor > 3 || (glMajor == 3 && glMinor >= 3) || HAVE_EXT(ARB_timer_query)))
+    {
+#undef EXT_SUFFIX
+#define EXT_SUFFIX ""
+        GL_TIMER_QUERY_FUN;
+    }
+    else if (gles && HAVE_EXT(EXT_disjoint_timer_query))
+    {
+#undef EXT_SUFFIX
+#define EXT_SUFFIX "EXT"
+        GL_TIMER_QUERY_FUN;
+    }
+    
     /* Debug callback entrypoints */
     if (HAVE_EXT(KHR_debug))
     {
@@ -205,3 +247,54 @@ void initGLFunctions()
     if (!gles || glMajor >= 3 || HAVE_EXT(OES_texture_npot))
         gl.npot_repeat = true;
 }
+
+static GLCallCounters *counters;
+
+static _PFNGLDRAWELEMENTSPROC realDrawElements;
+static _PFNGLTEXIMAGE2DPROC realTexImage2D;
+static _PFNGLTEXSUBIMAGE2DPROC realTexSubImage2D;
+
+static void APIENTRY countDrawElements(GLenum mode, GLsizei count, GLenum type, const GLvoid *indices)
+{
+    if (counters)
+        ++counters->drawCalls;
+    
+    realDrawElements(mode, count, type, indices);
+}
+
+static void APIENTRY countTexImage2D(GLenum target, GLint level, GLint internalformat,
+                                     GLsizei width, GLsizei height, GLint border,
+                                     GLenum format, GLenum type, const GLvoid *pixels)
+{
+    /* Allocations without data aren't uploads */
+    if (counters && pixels)
+        ++counters->texUploads;
+    
+    realTexImage2D(target, level, internalformat, width, height, border, format, type, pixels);
+}
+
+static void APIENTRY countTexSubImage2D(GLenum target, GLint level, GLint xoffset, GLint yoffset,
+                                        GLsizei width, GLsizei height,
+                                        GLenum format, GLenum type, const GLvoid *pixels)
+{
+    if (counters)
+        ++counters->texUploads;
+    
+    realTexSubImage2D(target, level, xoffset, yoffset, width, height, format, type, pixels);
+}
+
+void countGLCalls(GLCallCounters *c)
+{
+    if (!realDrawElements)
+    {
+        realDrawElements = gl.DrawElements;
+        realTexImage2D = gl.TexImage2D;
+        realTexSubImage2D = gl.TexSubImage2D;
+        
+        gl.DrawElements = countDrawElements;
+        gl.TexImage2D = countTexImage2D;
+        gl.TexSubImage2D = countTexSubImage2D;
+    }
+    
+    counters = c;
+}
@@ -24,6 +24,7 @@
 
 #include "gl-fun.h"
 #include "etc-internal.h"
+#include "profiler.h"
 
 /* Struct wrapping GLuint for some light type safety */
 #define DEF_GL_ID \
@@ -78,17 +79,19 @@ namespace TEX
 
 	static inline void uploadImage(GLsizei width, GLsizei height, const void *data, GLenum format)
 	{
+		ProfileScope scope(Profiler::TexUpload);
 		gl.TexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, format, GL_UNSIGNED_BYTE, data);
 	}
 
 	static inline void uploadSubImage(GLint x, GLint y, GLsizei width, GLsizei height, const void *data, GLenum format)
 	{
+		ProfileScope scope(Profiler::TexUpload);
 		gl.TexSubImage2D(GL_TEXTURE_2D, 0, x, y, width, height, format, GL_UNSIGNED_BYTE, data);
 	}
 
-	static inline void allocEmpty(GLsizei width, GLsizei height)
+	static inline void allocEmpty(GLsizei width, GLsizei height, GLenum format = GL_RGBA)
 	{
-		gl.TexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+		gl.TexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, 0);
 	}
 
 	static inline void setRepeat(bool mode)
@@ -193,6 +196,9 @@ typedef struct GenericBO<GL_ARRAY_BUFFER> VBO;
 /* Index Buffer Object */
 typedef struct GenericBO<GL_ELEMENT_ARRAY_BUFFER> IBO;
 
+/* Pixel Buffer Object (readback) */
+typedef struct GenericBO<GL_PIXEL_PACK_BUFFER> PBO;
+
 #undef DEF_GL_ID
 
 /* Convenience struct wrapping a framebuffer
@@ -21,6 +21,7 @@
 
 #include "scene.h"
 #include "sharedstate.h"
+#include "spritebatch.h"
 
 Scene::Scene()
 {}
@@ -36,46 +37,65 @@ Scene::~Scene()
 	}
 }
 
-void Scene::insert(SceneElement &element)
+bool Scene::ElementLess::operator()(const SceneElement *a, const SceneElement *b) const
 {
-	IntruListLink<SceneElement> *iter;
+	return *a < *b;
+}
 
-	for (iter = elements.begin(); iter != elements.end(); iter = iter->next)
-	{
-		SceneElement *e = iter->data;
+void Scene::insert(SceneElement &element)
+{
+	ElementIndex::iterator pos = elementIndex.insert(&element).first;
+	element.indexPos = pos;
 
-		if (element < *e)
-		{
-			elements.insertBefore(element.link, *iter);
-			return;
-		}
-	}
+	/* Link in front of the next element in order */
+	ElementIndex::iterator next = pos;
+	++next;
 
-	elements.append(element.link);
+	if (next == elementIndex.end())
+		elements.append(element.link);
+	else
+		elements.insertBefore(element.link, (*next)->link);
 }
 
-void Scene::insertAfter(SceneElement &element, SceneElement &after)
+void Scene::reinsert(SceneElement &element)
 {
-	IntruListLink<SceneElement> *iter;
+	if (!element.link.next)
+	{
+		insert(element);
+		return;
+	}
+
+	/* Changing Z or Y often doesn't move an element past
+	 * its neighbours, in which case the index is still
+	 * valid and nothing needs to be done */
+	ElementIndex::iterator pos = element.indexPos;
+	ElementIndex::iterator next = pos;
+	++next;
+
+	bool afterPrev = (pos == elementIndex.begin());
 
-	for (iter = &after.link; iter != elements.end(); iter = iter->next)
+	if (!afterPrev)
 	{
-		SceneElement *e = iter->data;
+		ElementIndex::iterator prev = pos;
+		--prev;
 
-		if (element < *e)
-		{
-			elements.insertBefore(element.link, *iter);
-			return;
-		}
+		afterPrev = (**prev < element);
 	}
 
-	elements.append(element.link);
+	if (afterPrev && (next == elementIndex.end() || element < **next))
+		return;
+
+	remove(element);
+	insert(element);
 }
 
-void Scene::reinsert(SceneElement &element)
+void Scene::remove(SceneElement &element)
 {
+	if (!element.link.next)
+		return;
+
 	elements.remove(element.link);
-	insert(element);
+	elementIndex.erase(element.indexPos);
 }
 
 void Scene::notifyGeometryChange()
@@ -90,15 +110,47 @@ void Scene::notifyGeometryChange()
 
 void Scene::composite()
 {
+	SpriteBatch &batch = shState->spriteBatch();
 	IntruListLink<SceneElement> *iter;
 
+	/* Consecutive elements of the same kind are profiled
+	 * as one zone, except for viewports */
+	Profiler *prof = Profiler::recording();
+	int profZone = -1;
+
 	for (iter = elements.begin(); iter != elements.end(); iter = iter->next)
 	{
 		SceneElement *e = iter->data;
 
-		if (e->visible)
-			e->draw();
+		if (!e->visible)
+			continue;
+
+		if (!e->batchesDraw())
+			batch.flush();
+
+		if (prof)
+		{
+			Profiler::Zone zone = e->profileZone();
+
+			if (zone != profZone || zone == Profiler::ViewportComposite)
+			{
+				if (profZone >= 0)
+					prof->end();
+
+				prof->begin(zone);
+				profZone = zone;
+			}
+		}
+
+		e->draw();
 	}
+
+	/* Everything must be on screen before the caller
+	 * pops scissor state or applies viewport effects */
+	batch.flush();
+
+	if (profZone >= 0)
+		prof->end();
 }
 
 
@@ -198,5 +250,5 @@ void SceneElement::setSpriteY(int value)
 void SceneElement::unlink()
 {
 	if (scene)
-		scene->elements.remove(link);
+		scene->remove(*this);
 }
@@ -26,6 +26,9 @@
 #include "intrulist.h"
 #include "etc.h"
 #include "etc-internal.h"
+#include "profiler.h"
+
+#include <set>
 
 class SceneElement;
 class Viewport;
@@ -62,14 +65,26 @@ public:
 	const Geometry &getGeometry() const { return geometry; }
 
 protected:
+	struct ElementLess
+	{
+		bool operator()(const SceneElement *a, const SceneElement *b) const;
+	};
+
+	typedef std::set<SceneElement*, ElementLess> ElementIndex;
+
 	void insert(SceneElement &element);
-	void insertAfter(SceneElement &element, SceneElement &after);
 	void reinsert(SceneElement &element);
+	void remove(SceneElement &element);
 
 	/* Notify all elements that geometry has changed */
 	void notifyGeometryChange();
 
 	IntruList<SceneElement> elements;
+
+	/* Holds the same elements in the same order as 'elements',
+	 * so the insert position can be found in O(log n) */
+	ElementIndex elementIndex;
+
 	Geometry geometry;
 
 	friend class SceneElement;
@@ -112,6 +127,14 @@ protected:
 	 */
 	virtual void draw() = 0;
 
+	/* Elements that submit their geometry through the shared
+	 * SpriteBatch return true here; for every other element,
+	 * the pending batch is flushed before its 'draw()' is called */
+	virtual bool batchesDraw() const { return false; }
+
+	/* The profiler zone this element's 'draw()' is counted in */
+	virtual Profiler::Zone profileZone() const { return Profiler::OtherElements; }
+
 	// FIXME: This should be a signal
 	virtual void onGeometryChange(const Scene::Geometry &) {}
 
@@ -123,12 +146,18 @@ protected:
 	void unlink();
 
 	IntruListLink<SceneElement> link;
+
+	/* Position in the scene's index; only valid while linked.
+	 * The element's sort key (z, spriteY) may only change
+	 * right before the scene reinserts it */
+	Scene::ElementIndex::iterator indexPos;
 	const unsigned int creationStamp;
 	int z;
 	bool visible;
 	Scene *scene;
 
 	friend class Scene;
+	friend struct Scene::ElementLess;
 	friend class Viewport;
 	friend struct TilemapPrivate;
 
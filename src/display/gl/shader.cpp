@@ -23,6 +23,9 @@
 #include "sharedstate.h"
 #include "glstate.h"
 #include "exception.h"
+#include "shadercache.h"
+
+#include <SDL_timer.h>
 
 #include <assert.h>
 #include <string.h>
@@ -35,8 +38,10 @@
 #include "trans.frag.xxd"
 #include "transSimple.frag.xxd"
 #include "bitmapBlit.frag.xxd"
+#include "textGlyph.frag.xxd"
+#include "textCompose.frag.xxd"
 #include "plane.frag.xxd"
-#include "gray.frag.xxd"
+#include "viewportEffect.frag.xxd"
 #include "flatColor.frag.xxd"
 #include "simple.frag.xxd"
 #include "simpleColor.frag.xxd"
@@ -176,11 +181,46 @@ static void setupShaderSource(GLuint shader, GLenum type,
 	gl.ShaderSource(shader, i, shaderSrc, shaderSrcSize);
 }
 
+static uint64_t hashShaderSources(const unsigned char *vert, int vertSize,
+                                  const unsigned char *frag, int fragSize)
+{
+	/* Covers everything setupShaderSource() feeds the compiler */
+	uint64_t hash = ShaderCache::hashData(&gl.glsles, sizeof(gl.glsles));
+
+#ifndef MKXPZ_BUILD_XCODE
+	hash = ShaderCache::hashData(___shader_common_h, ___shader_common_h_len, hash);
+#else
+	hash = ShaderCache::hashData(Shader::commonHeader().c_str(), Shader::commonHeader().length(), hash);
+#endif
+
+	hash = ShaderCache::hashData(&vertSize, sizeof(vertSize), hash);
+	hash = ShaderCache::hashData(vert, vertSize, hash);
+	hash = ShaderCache::hashData(&fragSize, sizeof(fragSize), hash);
+	hash = ShaderCache::hashData(frag, fragSize, hash);
+
+	return hash;
+}
+
 void Shader::init(const unsigned char *vert, int vertSize,
                   const unsigned char *frag, int fragSize,
                   const char *vertName, const char *fragName,
                   const char *programName)
 {
+	ShaderCache *cache = ShaderCache::instance();
+	uint64_t sourceHash = 0;
+	uint64_t startTicks = SDL_GetPerformanceCounter();
+
+	if (cache)
+	{
+		sourceHash = hashShaderSources(vert, vertSize, frag, fragSize);
+
+		if (cache->load(program, programName, sourceHash))
+		{
+			cache->addTiming(true, SDL_GetPerformanceCounter() - startTicks);
+			return;
+		}
+	}
+
 	GLint success;
 
 	/* Compile vertex shader */
@@ -219,6 +259,9 @@ void Shader::init(const unsigned char *vert, int vertSize,
 	gl.BindAttribLocation(program, TexCoord, "texCoord");
 	gl.BindAttribLocation(program, Color, "color");
 
+	if (cache)
+		cache->prepareLink(program);
+
 	gl.LinkProgram(program);
 
 	gl.GetProgramiv(program, GL_LINK_STATUS, &success);
@@ -230,6 +273,12 @@ void Shader::init(const unsigned char *vert, int vertSize,
 	                    "GLSL: An error occured while linking program '%s' (vertex '%s', fragment '%s')",
 	                    programName, vertName, fragName);
 	}
+
+	if (cache)
+	{
+		cache->store(program, programName, sourceHash);
+		cache->addTiming(false, SDL_GetPerformanceCounter() - startTicks);
+	}
 }
 
 void Shader::initFromFile(const char *_vertFile, const char *_fragFile,
@@ -583,18 +632,24 @@ void PlaneShader::setOpacity(float value)
 }
 
 
-GrayShader::GrayShader()
+ViewportEffectShader::ViewportEffectShader()
 {
-	INIT_SHADER(simple, gray, GrayShader);
+	INIT_SHADER(simple, viewportEffect, ViewportEffectShader);
 
 	ShaderBase::init();
 
 	GET_U(gray);
+	GET_U(tone);
+	GET_U(color);
+	GET_U(flash);
 }
 
-void GrayShader::setGray(float value)
+void ViewportEffectShader::setEffects(const Vec4 &tone, const Vec4 &color, const Vec4 &flash)
 {
-	gl.Uniform1f(u_gray, value);
+	gl.Uniform1f(u_gray, tone.w);
+	setVec4Uniform(u_tone, tone);
+	setVec4Uniform(u_color, color);
+	setVec4Uniform(u_flash, flash);
 }
 
 
@@ -733,3 +788,34 @@ void BltShader::setOpacity(float value)
 {
 	gl.Uniform1f(u_opacity, value);
 }
+
+
+TextGlyphShader::TextGlyphShader()
+{
+	INIT_SHADER(simpleColor, textGlyph, TextGlyphShader);
+
+	ShaderBase::init();
+}
+
+
+TextComposeShader::TextComposeShader()
+{
+	INIT_SHADER(simple, textCompose, TextComposeShader);
+
+	ShaderBase::init();
+
+	GET_U(textColor);
+	GET_U(outColor);
+	GET_U(outline);
+}
+
+void TextComposeShader::setColors(const Vec4 &text, const Vec4 &outline)
+{
+	setVec4Uniform(u_textColor, text);
+	setVec4Uniform(u_outColor, outline);
+}
+
+void TextComposeShader::setOutline(bool value)
+{
+	gl.Uniform1f(u_outline, value ? 1.0f : 0.0f);
+}
@@ -219,15 +219,17 @@ private:
 	GLint u_tone, u_color, u_flash, u_opacity;
 };
 
-class GrayShader : public ShaderBase
+/* Applies a viewport's tone (including gray), color and flash
+ * to a copy of the screen area it covers, in a single pass */
+class ViewportEffectShader : public ShaderBase
 {
 public:
-	GrayShader();
+	ViewportEffectShader();
 
-	void setGray(float value);
+	void setEffects(const Vec4 &tone, const Vec4 &color, const Vec4 &flash);
 
 private:
-	GLint u_gray;
+	GLint u_gray, u_tone, u_color, u_flash;
 };
 
 class TilemapShader : public ShaderBase
@@ -326,6 +328,24 @@ private:
 	GLint u_source, u_destination, u_subRect, u_opacity;
 };
 
+class TextGlyphShader : public ShaderBase
+{
+public:
+	TextGlyphShader();
+};
+
+class TextComposeShader : public ShaderBase
+{
+public:
+	TextComposeShader();
+
+	void setColors(const Vec4 &text, const Vec4 &outline);
+	void setOutline(bool value);
+
+private:
+	GLint u_textColor, u_outColor, u_outline;
+};
+
 /* Global object containing all available shaders */
 struct ShaderSet
 {
@@ -337,7 +357,7 @@ struct ShaderSet
 	AlphaSpriteShader alphaSprite;
 	SpriteShader sprite;
 	PlaneShader plane;
-	GrayShader gray;
+	ViewportEffectShader viewportEffect;
 	TilemapShader tilemap;
 	FlashMapShader flashMap;
 	TransShader trans;
@@ -347,6 +367,8 @@ struct ShaderSet
 	SimpleMatrixShader simpleMatrix;
 	BlurShader blur;
 	TilemapVXShader tilemapVX;
+	TextGlyphShader textGlyph;
+	TextComposeShader textCompose;
 };
 
 #endif // SHADER_H
@@ -0,0 +1,374 @@
+/*
+** shadercache.cpp
+**
+** This file is part of mkxp.
+**
+** Copyright (C) 2013 - 2021 Amaryllis Kulla <ancurio@mapleshrine.eu>
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "shadercache.h"
+
+#include "config.h"
+#include "boost-hash.h"
+#include "debugwriter.h"
+
+#include <SDL_timer.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#define CACHE_FILE "shaders.cache"
+
+/* Bump when changing the file layout */
+static const char cacheMagic[8] = { 'M', 'K', 'X', 'P', 'S', 'H', 'D', 'R' };
+static const uint32_t cacheVersion = 1;
+
+struct CacheEntry
+{
+	uint64_t sourceHash;
+	uint32_t format;
+	std::vector<uint8_t> binary;
+};
+
+struct ShaderCachePrivate
+{
+	std::string path;
+
+	/* Vendor, renderer and version strings of the
+	 * current driver; binaries are only valid for it */
+	std::string driver;
+
+	bool enabled;
+	bool dirty;
+
+	BoostHash<std::string, CacheEntry> entries;
+
+	struct
+	{
+		unsigned int hits, compiles;
+		uint64_t hitTicks, compileTicks;
+	} stats;
+
+	static ShaderCache *instance;
+
+	ShaderCachePrivate()
+	    : enabled(false),
+	      dirty(false)
+	{
+		memset(&stats, 0, sizeof(stats));
+	}
+
+	static bool readU32(FILE *f, uint32_t &value)
+	{
+		return fread(&value, sizeof(value), 1, f) == 1;
+	}
+
+	static bool readU64(FILE *f, uint64_t &value)
+	{
+		return fread(&value, sizeof(value), 1, f) == 1;
+	}
+
+	static bool readString(FILE *f, std::string &str)
+	{
+		uint32_t len;
+
+		if (!readU32(f, len) || len > 0x10000)
+			return false;
+
+		str.resize(len);
+
+		return len == 0 || fread(&str[0], 1, len, f) == len;
+	}
+
+	static bool writeString(FILE *f, const std::string &str)
+	{
+		uint32_t len = str.size();
+
+		return fwrite(&len, sizeof(len), 1, f) == 1 &&
+		       (len == 0 || fwrite(str.c_str(), 1, len, f) == len);
+	}
+
+	void readCache()
+	{
+		FILE *f = fopen(path.c_str(), "rb");
+
+		if (!f)
+			return;
+
+		char magic[sizeof(cacheMagic)];
+		uint32_t version, count;
+		std::string fileDriver;
+
+		if (fread(magic, sizeof(magic), 1, f) != 1 ||
+		    memcmp(magic, cacheMagic, sizeof(magic)) ||
+		    !readU32(f, version) || version != cacheVersion ||
+		    !readString(f, fileDriver) || !readU32(f, count))
+		{
+			fclose(f);
+			dirty = true;
+			return;
+		}
+
+		/* Driver changed, everything in here is stale */
+		if (fileDriver != driver)
+		{
+			fclose(f);
+			dirty = true;
+			return;
+		}
+
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			std::string name;
+			CacheEntry entry;
+			uint32_t size;
+
+			if (!readString(f, name) ||
+			    !readU64(f, entry.sourceHash) ||
+			    !readU32(f, entry.format) ||
+			    !readU32(f, size) || size > 0x4000000)
+			{
+				/* Keep what we got so far */
+				dirty = true;
+				break;
+			}
+
+			entry.binary.resize(size);
+
+			if (size > 0 && fread(&entry.binary[0], 1, size, f) != size)
+			{
+				dirty = true;
+				break;
+			}
+
+			entries.insert(name, entry);
+		}
+
+		fclose(f);
+	}
+
+	void writeCache()
+	{
+		FILE *f = fopen(path.c_str(), "wb");
+
+		if (!f)
+		{
+			Debug() << "Could not write shader cache" << path;
+			return;
+		}
+
+		uint32_t count = 0;
+		BoostHash<std::string, CacheEntry>::const_iterator iter;
+
+		for (iter = entries.cbegin(); iter != entries.cend(); ++iter)
+			++count;
+
+		bool ok = fwrite(cacheMagic, sizeof(cacheMagic), 1, f) == 1 &&
+		          fwrite(&cacheVersion, sizeof(cacheVersion), 1, f) == 1 &&
+		          writeString(f, driver) &&
+		          fwrite(&count, sizeof(count), 1, f) == 1;
+
+		for (iter = entries.cbegin(); ok && iter != entries.cend(); ++iter)
+		{
+			const CacheEntry &entry = iter->second;
+			uint32_t size = entry.binary.size();
+
+			ok = writeString(f, iter->first) &&
+			     fwrite(&entry.sourceHash, sizeof(entry.sourceHash), 1, f) == 1 &&
+			     fwrite(&entry.format, sizeof(entry.format), 1, f) == 1 &&
+			     fwrite(&size, sizeof(size), 1, f) == 1 &&
+			     fwrite(&entry.binary[0], 1, size, f) == size;
+		}
+
+		fclose(f);
+
+		/* Don't leave a truncated file behind */
+		if (!ok)
+			remove(path.c_str());
+	}
+};
+
+ShaderCache *ShaderCachePrivate::instance = 0;
+
+static std::string glString(GLenum name)
+{
+	const char *str = (const char*) gl.GetString(name);
+
+	return str ? str : "";
+}
+
+ShaderCache::ShaderCache(const Config &conf)
+{
+	p = new ShaderCachePrivate;
+
+	if (ShaderCachePrivate::instance == 0)
+		ShaderCachePrivate::instance = this;
+
+	if (!conf.shaderCache || conf.customDataPath.empty())
+		return;
+
+	if (!gl.GetProgramBinary || !gl.ProgramBinary)
+		return;
+
+	/* Some drivers expose the entrypoints
+	 * but don't support any format */
+	GLint formats = 0;
+	gl.GetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+
+	if (formats <= 0)
+		return;
+
+	p->enabled = true;
+	p->path = conf.customDataPath + "/" CACHE_FILE;
+	p->driver = glString(GL_VENDOR) + "\n" +
+	            glString(GL_RENDERER) + "\n" +
+	            glString(GL_VERSION);
+
+	p->readCache();
+}
+
+ShaderCache::~ShaderCache()
+{
+	if (ShaderCachePrivate::instance == this)
+		ShaderCachePrivate::instance = 0;
+
+	delete p;
+}
+
+bool ShaderCache::load(GLuint program, const char *name, uint64_t sourceHash)
+{
+	if (!p->enabled || !p->entries.contains(name))
+		return false;
+
+	const CacheEntry &entry = p->entries[name];
+
+	if (entry.sourceHash != sourceHash || entry.binary.empty())
+	{
+		p->entries.remove(name);
+		p->dirty = true;
+
+		return false;
+	}
+
+	gl.ProgramBinary(program, entry.format, &entry.binary[0], entry.binary.size());
+
+	GLint success;
+	gl.GetProgramiv(program, GL_LINK_STATUS, &success);
+
+	if (!success)
+	{
+		/* Rejected by the driver (eg. after an update
+		 * that kept the version string) */
+		p->entries.remove(name);
+		p->dirty = true;
+
+		return false;
+	}
+
+	return true;
+}
+
+void ShaderCache::prepareLink(GLuint program)
+{
+	if (p->enabled && gl.ProgramParameteri)
+		gl.ProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+}
+
+void ShaderCache::store(GLuint program, const char *name, uint64_t sourceHash)
+{
+	if (!p->enabled)
+		return;
+
+	GLint length = 0;
+	gl.GetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+
+	if (length <= 0)
+		return;
+
+	CacheEntry entry;
+	entry.sourceHash = sourceHash;
+	entry.binary.resize(length);
+
+	GLenum format;
+	GLsizei written = 0;
+	gl.GetProgramBinary(program, length, &written, &format, &entry.binary[0]);
+
+	if (written <= 0)
+		return;
+
+	entry.format = format;
+	entry.binary.resize(written);
+
+	p->entries.insert(name, entry);
+	p->dirty = true;
+}
+
+void ShaderCache::addTiming(bool cacheHit, uint64_t ticks)
+{
+	if (cacheHit)
+	{
+		++p->stats.hits;
+		p->stats.hitTicks += ticks;
+	}
+	else
+	{
+		++p->stats.compiles;
+		p->stats.compileTicks += ticks;
+	}
+}
+
+void ShaderCache::finish()
+{
+	if (ShaderCachePrivate::instance == this)
+		ShaderCachePrivate::instance = 0;
+
+	if (p->enabled && p->dirty)
+	{
+		p->writeCache();
+		p->dirty = false;
+	}
+
+	const double freq = SDL_GetPerformanceFrequency() / 1000.0;
+	char buf[128];
+
+	snprintf(buf, sizeof(buf),
+	         "Shaders: %u compiled in %.2f ms, %u loaded from cache in %.2f ms%s",
+	         p->stats.compiles, p->stats.compileTicks / freq,
+	         p->stats.hits, p->stats.hitTicks / freq,
+	         p->enabled ? "" : " (cache unavailable)");
+
+	Debug() << buf;
+}
+
+ShaderCache *ShaderCache::instance()
+{
+	return ShaderCachePrivate::instance;
+}
+
+uint64_t ShaderCache::hashData(const void *data, size_t size, uint64_t hash)
+{
+	const uint8_t *bytes = static_cast<const uint8_t*>(data);
+
+	for (size_t i = 0; i < size; ++i)
+	{
+		hash ^= bytes[i];
+		hash *= 0x100000001b3ULL;
+	}
+
+	return hash;
+}
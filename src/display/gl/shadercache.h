@@ -0,0 +1,69 @@
+/*
+** shadercache.h
+**
+** This file is part of mkxp.
+**
+** Copyright (C) 2013 - 2021 Amaryllis Kulla <ancurio@mapleshrine.eu>
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SHADERCACHE_H
+#define SHADERCACHE_H
+
+#include "gl-fun.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct Config;
+struct ShaderCachePrivate;
+
+/* On-disk cache of linked shader program binaries, stored in
+ * the user data directory. Entries are keyed by program name,
+ * and only used if both the driver (vendor, renderer, version
+ * strings) and the hash of the program's sources match.
+ *
+ * From construction until 'finish()', Shader::init consults
+ * it before compiling, and reports the time spent either way. */
+class ShaderCache
+{
+public:
+	ShaderCache(const Config &conf);
+	~ShaderCache();
+
+	/* Tries to restore a linked program from the cache */
+	bool load(GLuint program, const char *name, uint64_t sourceHash);
+
+	/* Call before linking a program that is to be stored */
+	void prepareLink(GLuint program);
+	void store(GLuint program, const char *name, uint64_t sourceHash);
+
+	void addTiming(bool cacheHit, uint64_t ticks);
+
+	/* Writes back the cache file if it changed
+	 * and logs the startup timings */
+	void finish();
+
+	static ShaderCache *instance();
+
+	/* FNV-1a, chainable through 'hash' */
+	static uint64_t hashData(const void *data, size_t size,
+	                         uint64_t hash = 0xcbf29ce484222325ULL);
+
+private:
+	ShaderCachePrivate *p;
+};
+
+#endif // SHADERCACHE_H
@@ -0,0 +1,83 @@
+/*
+** spritebatch.cpp
+**
+** This file is part of mkxp.
+**
+** Copyright (C) 2013 - 2021 Amaryllis Kulla <ancurio@mapleshrine.eu>
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "spritebatch.h"
+
+#include "sharedstate.h"
+#include "glstate.h"
+#include "shader.h"
+#include "vertex.h"
+
+/* Keep well below what 16 bit indices can address */
+#define MAX_BATCH_QUADS 4096
+
+SpriteBatch::SpriteBatch()
+    : quads(0),
+      blendType(BlendNormal)
+{}
+
+void SpriteBatch::push(const TEXFBO &tex, BlendType blendType,
+                       const Vertex vert[4])
+{
+	if (quads > 0 && (tex.tex != this->tex ||
+	                  blendType != this->blendType ||
+	                  quads == MAX_BATCH_QUADS))
+		flush();
+
+	if (quads == 0)
+	{
+		this->tex = tex.tex;
+		this->texSize = Vec2i(tex.width, tex.height);
+		this->blendType = blendType;
+	}
+
+	array.resize(++quads);
+
+	Vertex *dst = &array.vertices[(quads-1)*4];
+
+	for (int i = 0; i < 4; ++i)
+		dst[i] = vert[i];
+}
+
+void SpriteBatch::flush()
+{
+	if (quads == 0)
+		return;
+
+	array.commit();
+
+	SimpleAlphaShader &shader = shState->shaders().simpleAlpha;
+	shader.bind();
+	shader.applyViewportProj();
+	shader.setTranslation(Vec2i());
+	shader.setTexSize(texSize);
+
+	TEX::bind(tex);
+
+	glState.blendMode.pushSet(blendType);
+
+	array.draw();
+
+	glState.blendMode.pop();
+
+	array.clear();
+	quads = 0;
+}
@@ -0,0 +1,65 @@
+/*
+** spritebatch.h
+**
+** This file is part of mkxp.
+**
+** Copyright (C) 2013 - 2021 Amaryllis Kulla <ancurio@mapleshrine.eu>
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SPRITEBATCH_H
+#define SPRITEBATCH_H
+
+#include "gl-util.h"
+#include "quadarray.h"
+#include "etc.h"
+#include "etc-internal.h"
+
+struct Vertex;
+
+/* Collects consecutive sprites that need no per-sprite shader
+ * state (no color/tone/flash/bush/pattern/wave effects) into
+ * one streamed vertex buffer. The quads are transformed on the
+ * CPU and drawn with the simpleAlpha shader, with the sprite
+ * opacity carried in the vertex color alpha.
+ *
+ * A batch is broken whenever the bound texture or blend type
+ * changes, or when any non-batching element is about to draw,
+ * so submission order (and thus Z order) is preserved. */
+class SpriteBatch
+{
+public:
+	SpriteBatch();
+
+	/* Appends one pre-transformed quad. Flushes first
+	 * if the quad can't join the pending batch */
+	void push(const TEXFBO &tex, BlendType blendType,
+	          const Vertex vert[4]);
+
+	/* Draws and empties the pending batch (if any) */
+	void flush();
+
+	bool empty() const { return quads == 0; }
+
+private:
+	ColorQuadArray array;
+	size_t quads;
+
+	TEX::ID tex;
+	Vec2i texSize;
+	BlendType blendType;
+};
+
+#endif // SPRITEBATCH_H
@@ -24,106 +24,156 @@
 #include "sharedstate.h"
 #include "glstate.h"
 #include "boost-hash.h"
+#include "intrulist.h"
 #include "debugwriter.h"
 
-#include <list>
 #include <utility>
+#include <algorithm>
 #include <assert.h>
-#include <string.h>
+
+#define SIZE_CLASS_STEP 32
+
+#define LARGEST_COUNT 8
 
 typedef std::pair<uint16_t, uint16_t> Size;
 
-static uint32_t byteCount(Size &s)
+static uint64_t byteCount(const TEXFBO &obj)
+{
+	return (uint64_t) obj.width * obj.height * 4;
+}
+
+static Size sizeClass(int width, int height)
 {
-	return s.first * s.second * 4;
+	return Size((width + SIZE_CLASS_STEP - 1) / SIZE_CLASS_STEP,
+	            (height + SIZE_CLASS_STEP - 1) / SIZE_CLASS_STEP);
 }
 
 struct CacheNode
 {
 	TEXFBO obj;
-	std::list<TEXFBO>::iterator prioIter;
 
-	bool operator==(const CacheNode &o) const
-	{
-		return obj == o.obj;
-	}
+	/* Most recently released nodes are at the front
+	 * of all three lists */
+	IntruListLink<CacheNode> prioLink;
+	IntruListLink<CacheNode> sizeLink;
+	IntruListLink<CacheNode> classLink;
+
+	CacheNode(const TEXFBO &obj)
+	    : obj(obj),
+	      prioLink(this),
+	      sizeLink(this),
+	      classLink(this)
+	{}
 };
 
-typedef std::list<CacheNode> CNodeList;
+typedef IntruList<CacheNode> CNodeList;
 
 struct TexPoolPrivate
 {
-	/* Contains all cached TexFBOs, grouped by size */
-	BoostHash<Size, CNodeList> poolHash;
+	/* Contains all cached TexFBOs, grouped by exact size
+	 * and by size class. Empty lists are removed */
+	BoostHash<Size, CNodeList> sizeHash;
+	BoostHash<Size, CNodeList> classHash;
 
 	/* Contains all cached TexFBOs, sorted by release time */
-	std::list<TEXFBO> priorityQueue;
+	CNodeList priorityQueue;
 
 	/* Maximal allowed cache memory */
-	const uint32_t maxMemSize;
+	const uint64_t maxMemSize;
 
 	/* Current amound of memory consumed by the cache */
-	uint32_t memSize;
-
-	/* Current amount of TexFBOs cached */
-	uint16_t objCount;
+	uint64_t memSize;
 
 	/* Has this pool been disabled? */
 	bool disabled;
 
-	TexPoolPrivate(uint32_t maxMemSize)
+	TexPool::Stats stats;
+
+	TexPoolPrivate(uint64_t maxMemSize)
 	    : maxMemSize(maxMemSize),
 	      memSize(0),
-	      objCount(0),
 	      disabled(false)
-	{}
+	{
+		stats.hits = 0;
+		stats.classHits = 0;
+		stats.misses = 0;
+		stats.evictions = 0;
+	}
+
+	static void unlinkFrom(BoostHash<Size, CNodeList> &hash, const Size &key,
+	                       IntruListLink<CacheNode> &link)
+	{
+		CNodeList &list = hash[key];
+		list.remove(link);
+
+		if (list.isEmpty())
+			hash.remove(key);
+	}
+
+	/* Takes 'node' out of the cache and frees it, handing
+	 * back the texture it held */
+	TEXFBO take(CacheNode *node)
+	{
+		TEXFBO obj = node->obj;
+
+		priorityQueue.remove(node->prioLink);
+		unlinkFrom(sizeHash, Size(obj.width, obj.height), node->sizeLink);
+		unlinkFrom(classHash, sizeClass(obj.width, obj.height), node->classLink);
+
+		memSize -= byteCount(obj);
+		delete node;
+
+		return obj;
+	}
+
+	void insert(const TEXFBO &obj)
+	{
+		CacheNode *node = new CacheNode(obj);
+
+		priorityQueue.prepend(node->prioLink);
+		sizeHash[Size(obj.width, obj.height)].prepend(node->sizeLink);
+		classHash[sizeClass(obj.width, obj.height)].prepend(node->classLink);
+
+		memSize += byteCount(obj);
+	}
+
+	static CacheNode *first(CNodeList &list)
+	{
+		return list.begin()->data;
+	}
 };
 
-TexPool::TexPool(uint32_t maxMemSize)
+TexPool::TexPool(uint64_t maxMemSize)
 {
 	p = new TexPoolPrivate(maxMemSize);
 }
 
 TexPool::~TexPool()
 {
-	std::list<TEXFBO>::iterator iter;
-
-	for (iter = p->priorityQueue.begin();
-	     iter != p->priorityQueue.end();
-	     ++iter)
+	while (!p->priorityQueue.isEmpty())
 	{
-		TEXFBO obj = *iter;
+		TEXFBO obj = p->take(p->priorityQueue.tail());
 		TEXFBO::fini(obj);
-		--p->objCount;
 	}
 
-	assert(p->objCount == 0);
+	assert(p->memSize == 0);
 
 	delete p;
 }
 
 TEXFBO TexPool::request(int width, int height)
 {
-	CacheNode cnode;
 	Size size(width, height);
 
 	/* See if we can statisfy request from cache */
-	CNodeList &bucket = p->poolHash[size];
-
-	if (!bucket.empty())
+	if (p->sizeHash.contains(size))
 	{
 		/* Found one! */
-		cnode = bucket.back();
-		bucket.pop_back();
-
-		p->priorityQueue.erase(cnode.prioIter);
-
-		p->memSize -= byteCount(size);
-		--p->objCount;
+		++p->stats.hits;
 
 //		Debug() << "TexPool: <?+> (" << width << height << ")";
 
-		return cnode.obj;
+		return p->take(TexPoolPrivate::first(p->sizeHash[size]));
 	}
 
 	int maxSize = glState.caps.maxTexSize;
@@ -132,14 +182,32 @@ TEXFBO TexPool::request(int width, int height)
 		                "Texture dimensions [%d, %d] exceed hardware capabilities",
 		                width, height);
 
+	Size cls = sizeClass(width, height);
+
+	if (p->classHash.contains(cls))
+	{
+		/* Close enough, keep the objects but resize the storage */
+		TEXFBO obj = p->take(TexPoolPrivate::first(p->classHash[cls]));
+		TEXFBO::allocEmpty(obj, width, height);
+
+		++p->stats.classHits;
+
+//		Debug() << "TexPool: <?~> (" << width << height << ")";
+
+		return obj;
+	}
+
 	/* Nope, create it instead */
-	TEXFBO::init(cnode.obj);
-	TEXFBO::allocEmpty(cnode.obj, width, height);
-	TEXFBO::linkFBO(cnode.obj);
+	TEXFBO obj;
+	TEXFBO::init(obj);
+	TEXFBO::allocEmpty(obj, width, height);
+	TEXFBO::linkFBO(obj);
+
+	++p->stats.misses;
 
 //	Debug() << "TexPool: <?-> (" << width << height << ")";
 
-	return cnode.obj;
+	return obj;
 }
 
 void TexPool::release(TEXFBO &obj)
@@ -158,52 +226,32 @@ void TexPool::release(TEXFBO &obj)
 		return;
 	}
 
-	Size size(obj.width, obj.height);
+	uint64_t objSize = byteCount(obj);
 
-	uint32_t newMemSize = p->memSize + byteCount(size);
+	/* Never going to fit */
+	if (objSize > p->maxMemSize)
+	{
+		TEXFBO::fini(obj);
+		return;
+	}
 
 	/* If caching this object would spill over the allowed memory budget,
 	 * delete least used objects until we're good again */
-	while (newMemSize > p->maxMemSize)
+	while (p->memSize + objSize > p->maxMemSize)
 	{
-		if (p->objCount == 0)
-			break;
-
 //		Debug() << "TexPool: <!~> Size:" << p->memSize;
 
 		/* Retrieve object with lowest priority for deletion */
-		CacheNode last;
-		last.obj = p->priorityQueue.back();
-		Size removedSize(last.obj.width, last.obj.height);
-
-		CNodeList &bucket = p->poolHash[removedSize];
-
-		std::list<CacheNode>::iterator toRemove =
-		        std::find(bucket.begin(), bucket.end(), last);
-		assert(toRemove != bucket.end());
-		bucket.erase(toRemove);
-
-		p->priorityQueue.pop_back();
+		TEXFBO last = p->take(p->priorityQueue.tail());
+		TEXFBO::fini(last);
 
-		TEXFBO::fini(last.obj);
+		++p->stats.evictions;
 
-		newMemSize -= byteCount(removedSize);
-		--p->objCount;
-
-//		Debug() << "TexPool: <!-> (" << last.obj.width << last.obj.height << ")";
+//		Debug() << "TexPool: <!-> (" << last.width << last.height << ")";
 	}
 
-	p->memSize = newMemSize;
-
 	/* Retain object */
-	p->priorityQueue.push_front(obj);
-	CacheNode cnode;
-	cnode.obj = obj;
-	cnode.prioIter = p->priorityQueue.begin();
-	CNodeList &bucket = p->poolHash[size];
-	bucket.push_back(cnode);
-
-	++p->objCount;
+	p->insert(obj);
 
 //	Debug() << "TexPool: <!+> (" << obj.width << obj.height << ") Current size:" << p->memSize;
 }
@@ -213,4 +261,27 @@ void TexPool::disable()
 	p->disabled = true;
 }
 
+static bool largerThan(const Vec2i &a, const Vec2i &b)
+{
+	return a.x * a.y > b.x * b.y;
+}
+
+TexPool::Stats TexPool::stats() const
+{
+	Stats stats = p->stats;
+
+	stats.entries = p->priorityQueue.getSize();
+	stats.memSize = p->memSize;
+	stats.maxMemSize = p->maxMemSize;
 
+	for (IntruListLink<CacheNode> *iter = p->priorityQueue.begin();
+	     iter != p->priorityQueue.end(); iter = iter->next)
+		stats.largest.push_back(Vec2i(iter->data->obj.width, iter->data->obj.height));
+
+	size_t count = std::min<size_t>(stats.largest.size(), LARGEST_COUNT);
+	std::partial_sort(stats.largest.begin(), stats.largest.begin() + count,
+	                  stats.largest.end(), largerThan);
+	stats.largest.resize(count);
+
+	return stats;
+}
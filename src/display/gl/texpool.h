@@ -24,12 +24,43 @@
 
 #include "gl-util.h"
 
+#include <stdint.h>
+#include <vector>
+
 struct TexPoolPrivate;
 
+/* Keeps released textures around for later requests. A request
+ * is served by a cached texture of the exact same size if there
+ * is one, or else by one of the same size class (both dimensions
+ * rounded up to a multiple of 32), whose storage is then
+ * reallocated at the requested size. That only saves creating
+ * the GL objects, as textures are always sampled in their full
+ * size, but it keeps odd sized textures from piling up.
+ *
+ * Once the cached textures exceed the memory budget, the least
+ * recently released ones are deleted first. */
 class TexPool
 {
 public:
-	TexPool(uint32_t maxMemSize = 20000000 /* 20 MB */);
+	struct Stats
+	{
+		/* Requests served by the exact size / by
+		 * a resized texture of the same size class */
+		uint64_t hits;
+		uint64_t classHits;
+		uint64_t misses;
+		uint64_t evictions;
+
+		uint32_t entries;
+		uint64_t memSize;
+		uint64_t maxMemSize;
+
+		/* Sizes of the largest cached textures,
+		 * largest first */
+		std::vector<Vec2i> largest;
+	};
+
+	TexPool(uint64_t maxMemSize = 20 * 1024 * 1024 /* 20 MiB */);
 	~TexPool();
 
 	TEXFBO request(int width, int height);
@@ -37,6 +68,8 @@ public:
 
 	void disable();
 
+	Stats stats() const;
+
 private:
 	TexPoolPrivate *p;
 };
@@ -0,0 +1,744 @@
+/*
+** glyphatlas.cpp
+**
+** This file is part of mkxp.
+**
+** Copyright (C) 2013 - 2021 Amaryllis Kulla <ancurio@mapleshrine.eu>
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "glyphatlas.h"
+
+#include "sharedstate.h"
+#include "gl-util.h"
+#include "glstate.h"
+#include "shader.h"
+#include "quad.h"
+#include "quadarray.h"
+#include "boost-hash.h"
+#include "etc-internal.h"
+#include "util.h"
+
+#include <SDL_ttf.h>
+
+#include <algorithm>
+#include <vector>
+#include <string.h>
+
+#define PAGE_SIZE 1024
+
+/* Every size of every font gets a page of its own, so games
+ * varying font sizes a lot would otherwise never stop
+ * allocating them. 16 pages are 16 MiB */
+#define MAX_PAGES 16
+
+/* Keeps neighbouring glyphs from touching */
+#define GLYPH_PADDING 1
+
+#define HAVE_GLYPH_KERNING \
+	(SDL_TTF_MAJOR_VERSION > 2 || (SDL_TTF_MAJOR_VERSION == 2 && \
+	(SDL_TTF_MINOR_VERSION > 0 || SDL_TTF_PATCHLEVEL >= 14)))
+
+struct Glyph
+{
+	/* Trimmed bitmap in the page; 'w == 0' for blank glyphs */
+	int16_t x, y, w, h;
+
+	/* Position of the trimmed bitmap inside the
+	 * surface SDL_ttf renders for this glyph alone */
+	int16_t offX, offY;
+
+	/* Size of that surface */
+	int16_t surfW, surfH;
+
+	int16_t minx;
+	int16_t advance;
+};
+
+struct AtlasPage
+{
+	TEX::ID tex;
+
+	/* Glyphs are packed into rows ("shelves") from top
+	 * to bottom, each as high as its tallest glyph */
+	int shelfX, shelfY, shelfH;
+
+	/* Key: codepoint | style << 16 | outlined << 18 */
+	BoostHash<uint32_t, Glyph> glyphs;
+	uint32_t glyphCount;
+
+	/* Stamp of the last render using this page */
+	uint64_t lastUse;
+
+	AtlasPage(int size)
+	    : shelfX(0), shelfY(0), shelfH(0),
+	      glyphCount(0),
+	      lastUse(0)
+	{
+		/* Only coverage is stored, the color comes later */
+		tex = TEX::gen();
+		TEX::bind(tex);
+		TEX::setRepeat(false);
+		TEX::setSmooth(false);
+		TEX::allocEmpty(size, size, GL_ALPHA);
+	}
+
+	~AtlasPage()
+	{
+		TEX::del(tex);
+	}
+
+	void reset()
+	{
+		glyphs.clear();
+		glyphCount = 0;
+		shelfX = shelfY = shelfH = 0;
+	}
+
+	bool allocate(int size, int w, int h, int &x, int &y)
+	{
+		w += GLYPH_PADDING;
+		h += GLYPH_PADDING;
+
+		if (shelfX + w > size)
+		{
+			shelfX = 0;
+			shelfY += shelfH;
+			shelfH = 0;
+		}
+
+		if (shelfX + w > size || shelfY + h > size)
+			return false;
+
+		x = shelfX;
+		y = shelfY;
+
+		shelfX += w;
+		shelfH = std::max(shelfH, h);
+
+		return true;
+	}
+};
+
+/* SDL_ttf lays out strings glyph by glyph, so anything that
+ * would need shaping or reordering (combining marks, RTL and
+ * Brahmic scripts, joiners) is better left to it in one piece */
+static bool needsShaping(uint16_t c)
+{
+	return (c >= 0x0300 && c <= 0x036F)
+	    || (c >= 0x0590 && c <= 0x08FF)
+	    || (c >= 0x0900 && c <= 0x0DFF)
+	    || (c >= 0x0E00 && c <= 0x0EFF)
+	    || (c >= 0x1000 && c <= 0x109F)
+	    || (c >= 0x1780 && c <= 0x17FF)
+	    || (c >= 0x200C && c <= 0x200F)
+	    || (c >= 0xFB1D && c <= 0xFDFF)
+	    || (c >= 0xFE70 && c <= 0xFEFF);
+}
+
+/* Returns false for malformed UTF-8, codepoints outside the
+ * BMP (which TTF_GlyphMetrics can't address) and text that
+ * needs shaping */
+static bool decodeText(const char *str, std::vector<uint16_t> &out)
+{
+	const unsigned char *s = reinterpret_cast<const unsigned char*>(str);
+	out.clear();
+
+	while (*s)
+	{
+		uint32_t c;
+		int len;
+
+		if (s[0] < 0x80)
+		{
+			c = s[0];
+			len = 1;
+		}
+		else if ((s[0] & 0xE0) == 0xC0)
+		{
+			c = s[0] & 0x1F;
+			len = 2;
+		}
+		else if ((s[0] & 0xF0) == 0xE0)
+		{
+			c = s[0] & 0x0F;
+			len = 3;
+		}
+		else
+		{
+			return false;
+		}
+
+		for (int i = 1; i < len; ++i)
+		{
+			if ((s[i] & 0xC0) != 0x80)
+				return false;
+
+			c = (c << 6) | (s[i] & 0x3F);
+		}
+
+		if (c >= 0xD800 && c <= 0xDFFF)
+			return false;
+
+		if (needsShaping(c))
+			return false;
+
+		out.push_back(c);
+		s += len;
+	}
+
+	return !out.empty();
+}
+
+static void encodeChar(uint16_t c, char *buf)
+{
+	if (c < 0x80)
+	{
+		*buf++ = c;
+	}
+	else if (c < 0x800)
+	{
+		*buf++ = 0xC0 | (c >> 6);
+		*buf++ = 0x80 | (c & 0x3F);
+	}
+	else
+	{
+		*buf++ = 0xE0 | (c >> 12);
+		*buf++ = 0x80 | ((c >> 6) & 0x3F);
+		*buf++ = 0x80 | (c & 0x3F);
+	}
+
+	*buf = '\0';
+}
+
+static int kerning(TTF_Font *font, uint16_t prev, uint16_t c)
+{
+#if HAVE_GLYPH_KERNING
+	if (TTF_GetFontKerning(font))
+		return TTF_GetFontKerningSizeGlyphs(font, prev, c);
+#else
+	(void) font; (void) prev; (void) c;
+#endif
+
+	return 0;
+}
+
+struct GlyphAtlasPrivate
+{
+	enum Result
+	{
+		Done,
+		PageFull,
+		Failed
+	};
+
+	bool enabled;
+	int pageSize;
+
+	BoostHash<TTF_Font*, AtlasPage*> pages;
+	uint64_t useCounter;
+
+	/* Created on first use, as QuadArray needs shState */
+	ColorQuadArray *quads;
+	size_t quadCount;
+
+	/* Per channel glyph coverage of the current string,
+	 * and the final composition sampled by drawText */
+	TEXFBO coverage;
+	TEXFBO composed;
+
+	std::vector<uint16_t> codes;
+	std::vector<Glyph> textGlyphs;
+	std::vector<Glyph> outGlyphs;
+	std::vector<uint8_t> pixels;
+
+	GlyphAtlas::Stats stats;
+
+	GlyphAtlasPrivate(bool enabled)
+	    : enabled(enabled),
+	      pageSize(0),
+	      useCounter(0),
+	      quads(0),
+	      quadCount(0)
+	{
+		stats.hits = 0;
+		stats.misses = 0;
+		stats.fallbacks = 0;
+		stats.resets = 0;
+		stats.evictions = 0;
+	}
+
+	~GlyphAtlasPrivate()
+	{
+		BoostHash<TTF_Font*, AtlasPage*>::const_iterator iter;
+
+		for (iter = pages.cbegin(); iter != pages.cend(); ++iter)
+			delete iter->second;
+
+		delete quads;
+
+		if (coverage.tex != TEX::ID(0))
+		{
+			TEXFBO::fini(coverage);
+			TEXFBO::fini(composed);
+		}
+	}
+
+	AtlasPage &getPage(TTF_Font *font)
+	{
+		AtlasPage *page = pages.value(font, 0);
+
+		if (!page)
+			page = newPage(font);
+
+		page->lastUse = ++useCounter;
+
+		return *page;
+	}
+
+	AtlasPage *newPage(TTF_Font *font)
+	{
+		if (pages.size() >= MAX_PAGES)
+		{
+			/* Hand the least recently used page over */
+			BoostHash<TTF_Font*, AtlasPage*>::const_iterator iter, lru;
+			lru = pages.cbegin();
+
+			for (iter = pages.cbegin(); iter != pages.cend(); ++iter)
+				if (iter->second->lastUse < lru->second->lastUse)
+					lru = iter;
+
+			AtlasPage *page = lru->second;
+			TTF_Font *oldFont = lru->first;
+			pages.remove(oldFont);
+
+			page->reset();
+			pages.insert(font, page);
+			++stats.evictions;
+
+			return page;
+		}
+
+		if (!quads)
+		{
+			pageSize = std::min(PAGE_SIZE, glState.caps.maxTexSize);
+			quads = new ColorQuadArray;
+
+			TEXFBO::init(coverage);
+			TEXFBO::init(composed);
+		}
+
+		AtlasPage *page = new AtlasPage(pageSize);
+		pages.insert(font, page);
+
+		return page;
+	}
+
+	static void ensureSize(TEXFBO &tex, int w, int h)
+	{
+		if (w <= tex.width && h <= tex.height)
+			return;
+
+		TEXFBO::allocEmpty(tex, findNextPow2(std::max(w, tex.width)),
+		                        findNextPow2(std::max(h, tex.height)));
+		TEXFBO::linkFBO(tex);
+	}
+
+	/* Renders 'c' on its own at the font's current outline
+	 * setting, and stores its coverage in 'page' */
+	Result rasterize(AtlasPage &page, TTF_Font *font, uint16_t c, Glyph &g)
+	{
+		int minx;
+
+		if (TTF_GlyphMetrics(font, c, &minx, 0, 0, 0, 0) < 0)
+			return Failed;
+
+		/* SDL_ttf doesn't expose the pen advance including
+		 * bold overhang, so derive it from the layout */
+		char buf[8];
+		encodeChar(c, buf);
+		encodeChar(c, buf + strlen(buf));
+
+		int w1, w2, h;
+
+		if (TTF_SizeUTF8(font, buf + strlen(buf) / 2, &w1, &h) < 0 ||
+		    TTF_SizeUTF8(font, buf, &w2, &h) < 0)
+			return Failed;
+
+		g.minx = minx;
+		g.advance = w2 - w1 - kerning(font, c, c);
+		g.surfW = w1;
+		g.surfH = h;
+		g.x = g.y = g.w = g.h = 0;
+		g.offX = g.offY = 0;
+
+		SDL_Color white = { 255, 255, 255, 255 };
+		SDL_Surface *surf = TTF_RenderGlyph_Blended(font, c, white);
+
+		/* Zero width glyphs (eg. spaces) fail to render */
+		if (!surf)
+			return Done;
+
+		if (surf->format->BytesPerPixel != 4)
+		{
+			SDL_Surface *conv =
+				SDL_ConvertSurfaceFormat(surf, SDL_PIXELFORMAT_ARGB8888, 0);
+			SDL_FreeSurface(surf);
+
+			if (!conv)
+				return Failed;
+
+			surf = conv;
+		}
+
+		g.surfW = surf->w;
+		g.surfH = surf->h;
+
+		const SDL_PixelFormat &fm = *surf->format;
+
+		/* Trim fully transparent borders */
+		int x0 = surf->w, y0 = surf->h, x1 = -1, y1 = -1;
+
+		for (int y = 0; y < surf->h; ++y)
+		{
+			const uint32_t *row = (const uint32_t*)
+				((const uint8_t*) surf->pixels + y*surf->pitch);
+
+			for (int x = 0; x < surf->w; ++x)
+			{
+				if (!(row[x] & fm.Amask))
+					continue;
+
+				x0 = std::min(x0, x);
+				x1 = std::max(x1, x);
+				y0 = std::min(y0, y);
+				y1 = std::max(y1, y);
+			}
+		}
+
+		if (x1 < 0)
+		{
+			SDL_FreeSurface(surf);
+			return Done;
+		}
+
+		int w = x1 - x0 + 1;
+		int hh = y1 - y0 + 1;
+		int px, py;
+
+		if (!page.allocate(pageSize, w, hh, px, py))
+		{
+			SDL_FreeSurface(surf);
+			return PageFull;
+		}
+
+		/* Just the glyph's coverage */
+		pixels.resize(w*hh);
+
+		for (int y = 0; y < hh; ++y)
+		{
+			const uint32_t *row = (const uint32_t*)
+				((const uint8_t*) surf->pixels + (y0+y)*surf->pitch) + x0;
+			uint8_t *dst = &pixels[y*w];
+
+			for (int x = 0; x < w; ++x)
+				dst[x] = (row[x] & fm.Amask) >> fm.Ashift;
+		}
+
+		SDL_FreeSurface(surf);
+
+		/* Rows are tightly packed */
+		gl.PixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		TEX::bind(page.tex);
+		TEX::uploadSubImage(px, py, w, hh, &pixels[0], GL_ALPHA);
+		gl.PixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+		g.x = px;
+		g.y = py;
+		g.w = w;
+		g.h = hh;
+		g.offX = x0;
+		g.offY = y0;
+
+		return Done;
+	}
+
+	/* Looks up all glyphs of 'codes' at 'outlineSize',
+	 * rasterizing the missing ones */
+	Result resolve(AtlasPage &page, TTF_Font *font, int style,
+	               int outlineSize, std::vector<Glyph> &out)
+	{
+		out.resize(codes.size());
+
+		/* Changing the outline flushes SDL_ttf's own glyph
+		 * cache, so only do it if there's something to render */
+		bool outlineSet = false;
+		Result result = Done;
+
+		for (size_t i = 0; i < codes.size(); ++i)
+		{
+			uint32_t key = codes[i] | style << 16 | (outlineSize > 0) << 18;
+			BoostHash<uint32_t, Glyph>::const_iterator iter = page.glyphs.find(key);
+
+			if (iter != page.glyphs.cend())
+			{
+				out[i] = iter->second;
+				++stats.hits;
+
+				continue;
+			}
+
+			++stats.misses;
+
+			if (outlineSize > 0 && !outlineSet)
+			{
+				TTF_SetFontOutline(font, outlineSize);
+				outlineSet = true;
+			}
+
+			result = rasterize(page, font, codes[i], out[i]);
+
+			if (result != Done)
+				break;
+
+			page.glyphs.insert(key, out[i]);
+			++page.glyphCount;
+		}
+
+		if (outlineSet)
+			TTF_SetFontOutline(font, 0);
+
+		return result;
+	}
+
+	/* Queues the quads of one layer at 'origin', with 'channel'
+	 * selecting where its coverage ends up. Returns the size of
+	 * the surface SDL_ttf would have rendered for it */
+	Vec2i addLayer(TTF_Font *font, const std::vector<Glyph> &glyphs,
+	               const Vec2i &origin, const Vec4 &channel)
+	{
+		std::vector<Vertex> &vert = quads->vertices;
+		Vec2i extent;
+
+		/* SDL_ttf shifts the whole line right
+		 * if the first glyph overhangs its origin */
+		int pen = -std::min<int>(glyphs[0].minx, 0);
+
+		for (size_t i = 0; i < glyphs.size(); ++i)
+		{
+			const Glyph &g = glyphs[i];
+
+			if (i > 0)
+				pen += kerning(font, codes[i-1], codes[i]);
+
+			int left = pen + std::min<int>(g.minx, 0);
+
+			extent.x = std::max(extent.x, left + g.surfW);
+			extent.y = std::max(extent.y, (int) g.surfH);
+
+			if (g.w > 0)
+			{
+				FloatRect tex(g.x, g.y, g.w, g.h);
+				FloatRect pos(origin.x + left + g.offX,
+				              origin.y + g.offY, g.w, g.h);
+
+				vert.resize((quadCount+1)*4);
+				Quad::setTexPosRect(&vert[quadCount*4], tex, pos);
+				Quad::setColor(&vert[quadCount*4], channel);
+				++quadCount;
+			}
+
+			pen += g.advance;
+		}
+
+		return extent;
+	}
+
+	void drawCoverage(const AtlasPage &page, const Vec2i &size)
+	{
+		quads->resize(quadCount);
+		quads->commit();
+
+		ensureSize(coverage, size.x, size.y);
+
+		FBO::bind(coverage.fbo);
+		glState.viewport.pushSet(IntRect(0, 0, coverage.width, coverage.height));
+
+		glState.clearColor.pushSet(Vec4());
+		FBO::clear();
+		glState.clearColor.pop();
+
+		/* Overlapping glyphs add up, like SDL_ttf's blending */
+		glState.blend.pushSet(true);
+		glState.blendMode.pushSet(BlendAddition);
+
+		TextGlyphShader &shader = shState->shaders().textGlyph;
+		shader.bind();
+		shader.applyViewportProj();
+		shader.setTranslation(Vec2i());
+		shader.setTexSize(Vec2i(pageSize, pageSize));
+
+		TEX::bind(page.tex);
+		quads->draw();
+
+		glState.blendMode.pop();
+		glState.blend.pop();
+		glState.viewport.pop();
+	}
+
+	void compose(const Vec2i &size, const Vec4 &color,
+	             const Vec4 &outColor, bool outline)
+	{
+		ensureSize(composed, size.x, size.y);
+
+		FBO::bind(composed.fbo);
+		glState.viewport.pushSet(IntRect(0, 0, composed.width, composed.height));
+		glState.blend.pushSet(false);
+
+		TextComposeShader &shader = shState->shaders().textCompose;
+		shader.bind();
+		shader.applyViewportProj();
+		shader.setTranslation(Vec2i());
+		shader.setTexSize(Vec2i(coverage.width, coverage.height));
+		shader.setColors(color, outColor);
+		shader.setOutline(outline);
+
+		TEX::bind(coverage.tex);
+
+		Quad &quad = shState->gpQuad();
+		quad.setTexPosRect(FloatRect(0, 0, size.x, size.y),
+		                   FloatRect(0, 0, size.x, size.y));
+		quad.draw();
+
+		glState.blend.pop();
+		glState.viewport.pop();
+	}
+};
+
+GlyphAtlas::GlyphAtlas(bool enabled)
+{
+	p = new GlyphAtlasPrivate(enabled);
+}
+
+GlyphAtlas::~GlyphAtlas()
+{
+	delete p;
+}
+
+TEXFBO *GlyphAtlas::render(TTF_Font *font, const char *str,
+                           const Vec4 &color, const Vec4 &outColor,
+                           bool shadow, int outlineSize,
+                           Vec2i &size, int &textH)
+{
+	if (!p->enabled)
+		return 0;
+
+	int style = TTF_GetFontStyle(font);
+
+	/* Underlines and strikethroughs span the whole line */
+	if (style & ~(TTF_STYLE_BOLD | TTF_STYLE_ITALIC) || !decodeText(str, p->codes))
+	{
+		++p->stats.fallbacks;
+		return 0;
+	}
+
+	AtlasPage &page = p->getPage(font);
+
+	for (int attempt = 0; ; ++attempt)
+	{
+		GlyphAtlasPrivate::Result result =
+			p->resolve(page, font, style, 0, p->textGlyphs);
+
+		if (result == GlyphAtlasPrivate::Done && outlineSize > 0)
+			result = p->resolve(page, font, style, outlineSize, p->outGlyphs);
+
+		if (result == GlyphAtlasPrivate::Done)
+			break;
+
+		/* Start over with an empty page, unless even
+		 * that didn't fit the string */
+		if (result == GlyphAtlasPrivate::Failed || attempt > 0)
+		{
+			++p->stats.fallbacks;
+			return 0;
+		}
+
+		page.reset();
+		++p->stats.resets;
+	}
+
+	/* Coverage channels: red for the text, green
+	 * for the outline, blue for the drop shadow */
+	p->quadCount = 0;
+
+	Vec2i textOrigin;
+
+	if (outlineSize > 0)
+	{
+		size = p->addLayer(font, p->outGlyphs, Vec2i(), Vec4(0, 1, 0, 1));
+		textOrigin = Vec2i(outlineSize, outlineSize);
+	}
+
+	Vec2i textSize = p->addLayer(font, p->textGlyphs, textOrigin, Vec4(1, 0, 0, 1));
+	textH = textSize.y;
+
+	if (shadow)
+	{
+		p->addLayer(font, p->textGlyphs, textOrigin + Vec2i(1, 1), Vec4(0, 0, 1, 1));
+		textSize += Vec2i(1, 1);
+	}
+
+	/* The outline surface clips the text blitted onto it */
+	if (outlineSize <= 0)
+		size = textSize;
+
+	if (size.x <= 0 || size.y <= 0 ||
+	    size.x > glState.caps.maxTexSize || size.y > glState.caps.maxTexSize)
+	{
+		++p->stats.fallbacks;
+		return 0;
+	}
+
+	p->drawCoverage(page, size);
+	p->compose(size, color, outColor, outlineSize > 0);
+
+	return &p->composed;
+}
+
+void GlyphAtlas::countFallback()
+{
+	if (p->enabled)
+		++p->stats.fallbacks;
+}
+
+GlyphAtlas::Stats GlyphAtlas::stats() const
+{
+	Stats stats = p->stats;
+
+	stats.pages = 0;
+	stats.glyphs = 0;
+
+	BoostHash<TTF_Font*, AtlasPage*>::const_iterator iter;
+
+	for (iter = p->pages.cbegin(); iter != p->pages.cend(); ++iter)
+	{
+		++stats.pages;
+		stats.glyphs += iter->second->glyphCount;
+	}
+
+	stats.memSize = (uint64_t) stats.pages * p->pageSize * p->pageSize;
+
+	return stats;
+}
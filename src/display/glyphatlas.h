@@ -0,0 +1,86 @@
+/*
+** glyphatlas.h
+**
+** This file is part of mkxp.
+**
+** Copyright (C) 2013 - 2021 Amaryllis Kulla <ancurio@mapleshrine.eu>
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef GLYPHATLAS_H
+#define GLYPHATLAS_H
+
+#include <stdint.h>
+
+struct _TTF_Font;
+struct TEXFBO;
+struct Vec2i;
+struct Vec4;
+struct GlyphAtlasPrivate;
+
+/* Caches rasterized glyphs in one alpha-only texture page per
+ * TTF_Font (up to a fixed number of pages, the least recently
+ * used one being handed to the next new font), so
+ * Bitmap#draw_text can assemble strings out of textured quads
+ * instead of having SDL_ttf render and upload a new surface
+ * every time. Outline glyphs are kept next to the regular ones.
+ *
+ * Glyphs are rasterized lazily on first use. When a page runs
+ * full, it is emptied and refilled with what's needed next.
+ * Strings SDL_ttf's per-glyph API can't represent faithfully
+ * (solid fonts, scripts relying on shaping, codepoints outside
+ * the BMP) are left to the surface path. */
+class GlyphAtlas
+{
+public:
+	struct Stats
+	{
+		uint64_t hits;
+		uint64_t misses;
+		uint64_t fallbacks;
+		uint64_t resets;
+		uint64_t evictions;
+
+		uint32_t pages;
+		uint32_t glyphs;
+		uint64_t memSize;
+	};
+
+	GlyphAtlas(bool enabled);
+	~GlyphAtlas();
+
+	/* Renders 'str' the way Bitmap::drawText composes the
+	 * TTF_RenderUTF8_Blended surface, including the drop shadow
+	 * and an outline of 'outlineSize' pixels (0 for none), into
+	 * the top left 'size' area of the returned texture.
+	 * 'textH' receives the height of the text without outline.
+	 *
+	 * The texture is scratch space, valid until the next call.
+	 * Returns null if the string has to take the surface path */
+	TEXFBO *render(_TTF_Font *font, const char *str,
+	               const Vec4 &color, const Vec4 &outColor,
+	               bool shadow, int outlineSize,
+	               Vec2i &size, int &textH);
+
+	/* Called for strings the caller didn't even try to render */
+	void countFallback();
+
+	Stats stats() const;
+
+private:
+	GlyphAtlasPrivate *p;
+};
+
+#endif // GLYPHATLAS_H
@@ -23,6 +23,7 @@
 
 #include "alstream.h"
 #include "audio.h"
+#include "benchmark.h"
 #include "binding.h"
 #include "bitmap.h"
 #include "config.h"
@@ -35,10 +36,13 @@
 #include "gl-util.h"
 #include "glstate.h"
 #include "intrulist.h"
+#include "presenter.h"
+#include "profiler.h"
 #include "quad.h"
 #include "scene.h"
 #include "shader.h"
 #include "sharedstate.h"
+#include "screenshotqueue.h"
 #include "texpool.h"
 #include "theoraplay/theoraplay.h"
 #include "util.h"
@@ -63,6 +67,7 @@
 #include <time.h>
 #include <cmath>
 #include <climits>
+#include <atomic>
 
 
 #define DEF_SCREEN_W 1280
@@ -491,7 +496,7 @@ private:
 
 class ScreenScene : public Scene {
 public:
-    ScreenScene(int width, int height) : pp(width, height) {
+    ScreenScene(int width, int height) : pp(width, height), effectPixels(0) {
         updateReso(width, height);
         
         brightEffect = false;
@@ -502,7 +507,14 @@ public:
         const int w = geometry.rect.w;
         const int h = geometry.rect.h;
         
-        shState->prepareDraw();
+        ProfileScope scope(Profiler::Composite);
+        
+        effectPixels = 0;
+        
+        {
+            ProfileScope prepareScope(Profiler::PrepareDraw);
+            shState->prepareDraw();
+        }
         
         pp.startRender();
         
@@ -523,106 +535,96 @@ public:
     }
     
     void requestViewportRender(const Vec4 &c, const Vec4 &f, const Vec4 &t) {
+        /* Effects only cover the visible part of the viewport,
+         * which is the current scissor box */
         const IntRect &viewpRect = glState.scissorBox.get();
         const IntRect &screenRect = geometry.rect;
         
-        const bool toneRGBEffect = t.xyzNotNull();
+        SDL_Rect r1 = { viewpRect.x, viewpRect.y, viewpRect.w, viewpRect.h };
+        SDL_Rect r2 = { screenRect.x, screenRect.y, screenRect.w, screenRect.h };
+        SDL_Rect area;
+        
+        if (!SDL_IntersectRect(&r1, &r2, &area))
+            return;
+        
+        const IntRect rect(area.x, area.y, area.w, area.h);
+        
+        const bool toneAddEffect = t.x > 0 || t.y > 0 || t.z > 0;
+        const bool toneSubEffect = t.x < 0 || t.y < 0 || t.z < 0;
         const bool toneGrayEffect = t.w != 0;
         const bool colorEffect = c.w > 0;
         const bool flashEffect = f.w > 0;
         
-        if (toneGrayEffect) {
-            pp.swapRender();
+        const int blendPasses = toneAddEffect + toneSubEffect + colorEffect + flashEffect;
+        
+        effectQuad.setTexPosRect(rect, rect);
+        
+        if (toneGrayEffect || blendPasses > 1) {
+            /* Gray needs to read the scene anyway, so copy the area
+             * into the back buffer and apply everything from there
+             * in one pass, instead of one blended pass per effect */
+            GLMeta::blitBegin(pp.backBuffer());
+            GLMeta::blitSource(pp.frontBuffer());
+            GLMeta::blitRectangle(rect, rect.pos());
+            GLMeta::blitEnd();
             
-            if (!viewpRect.encloses(screenRect)) {
-                /* Scissor test _does_ affect FBO blit operations,
-                 * and since we're inside the draw cycle, it will
-                 * be turned on, so turn it off temporarily */
-                glState.scissorTest.pushSet(false);
-                
-                GLMeta::blitBegin(pp.frontBuffer());
-                GLMeta::blitSource(pp.backBuffer());
-                GLMeta::blitRectangle(geometry.rect, Vec2i());
-                GLMeta::blitEnd();
-                
-                glState.scissorTest.pop();
-            }
+            pp.startRender();
             
-            GrayShader &shader = shState->shaders().gray;
+            ViewportEffectShader &shader = shState->shaders().viewportEffect;
             shader.bind();
-            shader.setGray(t.w);
             shader.applyViewportProj();
             shader.setTexSize(screenRect.size());
+            shader.setEffects(t, colorEffect ? c : Vec4(), flashEffect ? f : Vec4());
             
             TEX::bind(pp.backBuffer().tex);
             
             glState.blend.pushSet(false);
-            screenQuad.draw();
+            effectQuad.draw();
             glState.blend.pop();
+            
+            effectPixels += 2 * (uint64_t) rect.w * rect.h;
+            
+            return;
         }
         
-        if (!toneRGBEffect && !colorEffect && !flashEffect)
+        if (blendPasses == 0)
             return;
         
+        /* A single effect is cheapest as one blended pass */
         FlatColorShader &shader = shState->shaders().flatColor;
         shader.bind();
         shader.applyViewportProj();
         
-        if (toneRGBEffect) {
-            /* First split up additive / substractive components */
-            Vec4 add, sub;
-            
-            if (t.x > 0)
-                add.x = t.x;
-            if (t.y > 0)
-                add.y = t.y;
-            if (t.z > 0)
-                add.z = t.z;
-            
-            if (t.x < 0)
-                sub.x = -t.x;
-            if (t.y < 0)
-                sub.y = -t.y;
-            if (t.z < 0)
-                sub.z = -t.z;
-            
-            /* Then apply them using hardware blending */
+        if (toneAddEffect) {
+            gl.BlendEquation(GL_FUNC_ADD);
             gl.BlendFuncSeparate(GL_ONE, GL_ONE, GL_ZERO, GL_ONE);
-            
-            if (add.xyzNotNull()) {
-                gl.BlendEquation(GL_FUNC_ADD);
-                shader.setColor(add);
-                
-                screenQuad.draw();
-            }
-            
-            if (sub.xyzNotNull()) {
-                gl.BlendEquation(GL_FUNC_REVERSE_SUBTRACT);
-                shader.setColor(sub);
-                
-                screenQuad.draw();
-            }
+            shader.setColor(Vec4(std::max(t.x, 0.0f), std::max(t.y, 0.0f),
+                                 std::max(t.z, 0.0f), 0));
         }
-        
-        if (colorEffect || flashEffect) {
+        else if (toneSubEffect) {
+            gl.BlendEquation(GL_FUNC_REVERSE_SUBTRACT);
+            gl.BlendFuncSeparate(GL_ONE, GL_ONE, GL_ZERO, GL_ONE);
+            shader.setColor(Vec4(std::max(-t.x, 0.0f), std::max(-t.y, 0.0f),
+                                 std::max(-t.z, 0.0f), 0));
+        }
+        else {
             gl.BlendEquation(GL_FUNC_ADD);
             gl.BlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ZERO,
                                  GL_ONE);
+            shader.setColor(colorEffect ? c : f);
         }
         
-        if (colorEffect) {
-            shader.setColor(c);
-            screenQuad.draw();
-        }
+        effectQuad.draw();
         
-        if (flashEffect) {
-            shader.setColor(f);
-            screenQuad.draw();
-        }
+        effectPixels += (uint64_t) rect.w * rect.h;
         
         glState.blendMode.refresh();
     }
     
+    /* Pixels written by viewport effects during
+     * the last composition */
+    uint64_t getEffectPixels() const { return effectPixels; }
+    
     void setBrightness(float norm) {
         brightnessQuad.setColor(Vec4(0, 0, 0, 1.0f - norm));
         
@@ -633,7 +635,6 @@ public:
         geometry.rect.w = width;
         geometry.rect.h = height;
         
-        screenQuad.setTexPosRect(geometry.rect, geometry.rect);
         brightnessQuad.setTexPosRect(geometry.rect, geometry.rect);
         
         notifyGeometryChange();
@@ -648,7 +649,8 @@ public:
     
 private:
     PingPong pp;
-    Quad screenQuad;
+    Quad effectQuad;
+    uint64_t effectPixels;
     
     Quad brightnessQuad;
     bool brightEffect;
@@ -820,9 +822,27 @@ struct GraphicsPrivate {
     double last_avg_update;
     SDL_mutex *avgFPSLock;
     
+    /* Held while a Ruby thread touches graphics objects
+     * (Graphics.update runs without the GVL). Recursive; the
+     * owner check lets nested and repeated locking by the same
+     * thread skip the mutex */
     SDL_mutex *glResourceLock;
+    std::atomic<SDL_threadID> lockOwner;
+    int lockDepth;
     bool multithreadedMode;
     
+    /* The thread the GL context is current on. It is only
+     * moved when a different thread needs to issue GL calls */
+    SDL_threadID contextThread;
+    
+    /* Only set when benchmarking */
+    Benchmark *benchmark;
+    
+    /* Only set when presenting from a separate thread */
+    FramePresenter *presenter;
+    
+    Profiler profiler;
+    
     /* Global list of all live Disposables
      * (disposed on reset) */
     IntruList<Disposable> dispList;
@@ -831,12 +851,15 @@ struct GraphicsPrivate {
     : scRes(DEF_SCREEN_W, DEF_SCREEN_H), scSize(scRes),
     winSize(rtData->config.defScreenW, rtData->config.defScreenH),
     screen(scRes.x, scRes.y), threadData(rtData),
-    glCtx(SDL_GL_GetCurrentContext()), multithreadedMode(true),
+    glCtx(SDL_GL_GetCurrentContext()), lockOwner(0), lockDepth(0),
+    multithreadedMode(true), contextThread(SDL_ThreadID()),
     frameRate(DEF_FRAMERATE), frameCount(0), brightness(255),
     fpsLimiter(frameRate), useFrameSkip(rtData->config.frameSkip), frozen(false),
     last_update(0), last_avg_update(0), backingScaleFactor(1), integerScaleFactor(0, 0),
     integerScaleActive(rtData->config.integerScaling.active),
-    integerLastMileScaling(rtData->config.integerScaling.lastMileScaling) {
+    integerLastMileScaling(rtData->config.integerScaling.lastMileScaling),
+    benchmark(0), presenter(0),
+    profiler(rtData->config.profilerTrace, rtData->config.profilerOverlay) {
         avgFPSData = std::vector<double>();
         avgFPSLock = SDL_CreateMutex();
         glResourceLock = SDL_CreateMutex();
@@ -857,15 +880,39 @@ struct GraphicsPrivate {
         screenQuad.setTexPosRect(screenRect, screenRect);
         
         fpsLimiter.resetFrameAdjust();
+        
+        if (rtData->config.benchmarkFrames > 0)
+            benchmark = new Benchmark(rtData->config.benchmarkFrames,
+                                      rtData->config.benchmarkOutput);
+        
+        if (rtData->presentContext)
+            initPresenter(rtData);
     }
     
     ~GraphicsPrivate() {
+        delete presenter;
+        delete benchmark;
         TEXFBO::fini(frozenScene);
         TEXFBO::fini(integerScaleBuffer);
         SDL_DestroyMutex(avgFPSLock);
         SDL_DestroyMutex(glResourceLock);
     }
     
+    void initPresenter(RGSSThreadData *rtData) {
+        if (!FramePresenter::supported()) {
+            Debug() << "presentThread needs framebuffer blits and sync objects, disabling";
+            return;
+        }
+        
+        try {
+            presenter = new FramePresenter(rtData->window, rtData->presentContext,
+                                           rtData->config.vsync ||
+                                           rtData->config.syncToRefreshrate);
+        } catch (const Exception &exc) {
+            Debug() << exc.msg;
+        }
+    }
+    
     void updateScreenResoRatio(RGSSThreadData *rtData) {
         Vec2 &ratio = rtData->sizeResoRatio;
         ratio.x = (float)scRes.x / scSize.x * backingScaleFactor;
@@ -990,17 +1037,96 @@ struct GraphicsPrivate {
     }
     
     void swapGLBuffer() {
-        fpsLimiter.delay();
-        SDL_GL_SwapWindow(threadData->window);
+        {
+            ProfileScope scope(Profiler::FrameWait);
+            fpsLimiter.delay();
+        }
+        
+        {
+            ProfileScope scope(Profiler::Present);
+            
+            /* Nothing to present to, but frame times should
+             * still include the GPU work */
+            if (threadData->config.headless)
+                gl.Finish();
+            else
+                swapWindow();
+        }
         
         ++frameCount;
         
         threadData->ethread->notifyFrame();
     }
     
-    void compositeToBuffer(TEXFBO &buffer) {
+    /* Hands the frame over to the present thread, which scales
+     * it into the window and swaps while the next one runs */
+    void queueFrame() {
+        Vec2i srcSize = scRes;
+        bool smooth = threadData->config.smoothScaling;
+        
+        if (integerScaleStepApplicable()) {
+            if (integerLastMileScaling)
+                srcSize = Vec2i(scRes.x * integerScaleFactor.x,
+                                scRes.y * integerScaleFactor.y);
+            else
+                smooth = false;
+        }
+        
+        TEXFBO &buf = presenter->acquire(srcSize);
+        
+        GLMeta::blitBegin(buf);
+        GLMeta::blitSource(screen.getPP().frontBuffer());
+        GLMeta::blitRectangle(IntRect(0, 0, scRes.x, scRes.y),
+                              IntRect(0, 0, srcSize.x, srcSize.y), false);
+        GLMeta::blitEnd();
+        
+        {
+            ProfileScope scope(Profiler::FrameWait);
+            fpsLimiter.delay();
+        }
+        
+        {
+            ProfileScope scope(Profiler::Present);
+            presenter->submit(IntRect(scOffset.x, scSize.y + scOffset.y,
+                                      scSize.x, -scSize.y), smooth);
+        }
+        
+        ++frameCount;
+        
+        threadData->ethread->notifyFrame();
+    }
+    
+    /* Must precede anything drawing to the window on this
+     * thread, as the present thread may still be showing
+     * a queued frame in it */
+    void beginWindowDraw() {
+        if (presenter)
+            presenter->finish();
+    }
+    
+    void swapWindow() {
+        SDL_GL_SwapWindow(threadData->window);
+    }
+    
+    /* Ends the benchmark once enough frames were recorded */
+    void endBenchmarkFrame() {
+        if (benchmark && benchmark->frameEnd())
+            threadData->ethread->requestTerminate();
+    }
+    
+    void composite() {
+        if (benchmark)
+            benchmark->compositeBegin();
+        
         screen.composite();
         
+        if (benchmark)
+            benchmark->compositeEnd(screen.getEffectPixels());
+    }
+    
+    void compositeToBuffer(TEXFBO &buffer) {
+        composite();
+        
         GLMeta::blitBegin(buffer);
         GLMeta::blitSource(screen.getPP().frontBuffer());
         GLMeta::blitRectangle(IntRect(0, 0, scRes.x, scRes.y), Vec2i());
@@ -1025,7 +1151,22 @@ struct GraphicsPrivate {
     }
     
     void redrawScreen() {
-        screen.composite();
+        composite();
+        
+        if (threadData->config.headless) {
+            swapGLBuffer();
+            recordFrameTime();
+            return;
+        }
+        
+        /* The overlay is drawn straight into the window */
+        if (presenter && !profiler.overlayShown()) {
+            queueFrame();
+            recordFrameTime();
+            return;
+        }
+        
+        beginWindowDraw();
         
         // maybe unspaghetti this later
         if (integerScaleStepApplicable() && !integerLastMileScaling)
@@ -1037,6 +1178,7 @@ struct GraphicsPrivate {
             metaBlitBufferFlippedScaled(scRes, true);
             GLMeta::blitEnd();
             
+            profiler.drawOverlay(winSize);
             swapGLBuffer();
             return;
         }
@@ -1075,8 +1217,12 @@ struct GraphicsPrivate {
         
         GLMeta::blitEnd();
         
+        profiler.drawOverlay(winSize);
         swapGLBuffer();
-        
+        recordFrameTime();
+    }
+    
+    void recordFrameTime() {
         SDL_LockMutex(avgFPSLock);
         if (avgFPSData.size() > 40)
             avgFPSData.erase(avgFPSData.begin());
@@ -1094,9 +1240,13 @@ struct GraphicsPrivate {
         /* Releasing the GL context before sleeping and making it
          * current again on wakeup seems to avoid the context loss
          * when the app moves into the background on Android */
+        if (presenter)
+            presenter->finish();
+        
         SDL_GL_MakeCurrent(threadData->window, 0);
         threadData->syncPoint.waitMainSync();
         SDL_GL_MakeCurrent(threadData->window, glCtx);
+        contextThread = SDL_ThreadID();
         
         fpsLimiter.resetFrameAdjust();
     }
@@ -1112,16 +1262,36 @@ struct GraphicsPrivate {
         return ret;
     }
     
-    void setLock(bool force = false) {
+    void setLock(bool force, bool bindContext) {
         if (!(force || multithreadedMode)) return;
         
-        SDL_LockMutex(glResourceLock);
-        SDL_GL_MakeCurrent(threadData->window, threadData->glContext);
+        SDL_threadID self = SDL_ThreadID();
+        
+        if (lockOwner.load(std::memory_order_relaxed) == self) {
+            ++lockDepth;
+        } else {
+            SDL_LockMutex(glResourceLock);
+            lockOwner.store(self, std::memory_order_relaxed);
+            lockDepth = 1;
+        }
+        
+        if (bindContext && contextThread != self) {
+            SDL_GL_MakeCurrent(threadData->window, threadData->glContext);
+            contextThread = self;
+        }
     }
     
-    void releaseLock(bool force = false) {
+    void releaseLock(bool force) {
         if (!(force || multithreadedMode)) return;
         
+        /* Unbalanced, eg. thread_safe was turned on while locked */
+        if (lockOwner.load(std::memory_order_relaxed) != SDL_ThreadID())
+            return;
+        
+        if (--lockDepth > 0)
+            return;
+        
+        lockOwner.store(0, std::memory_order_relaxed);
         SDL_UnlockMutex(glResourceLock);
     }
 };
@@ -1136,6 +1306,10 @@ Graphics::Graphics(RGSSThreadData *data) {
     } else if (data->config.fixedFramerate < 0) {
         p->fpsLimiter.disabled = true;
     }
+    
+    /* Run as fast as possible */
+    if (data->config.headless)
+        p->fpsLimiter.disabled = true;
 }
 
 Graphics::~Graphics() { delete p; }
@@ -1149,6 +1323,14 @@ double Graphics::lastUpdate() {
 }
 
 void Graphics::update(bool checkForShutdown) {
+    if (p->threadData->rqProfilerOverlay) {
+        p->threadData->rqProfilerOverlay.clear();
+        p->profiler.toggleOverlay();
+    }
+    
+    p->profiler.frameStart();
+    ProfileScope scope(Profiler::Update);
+    
     p->threadData->rqWindowAdjust.wait();
     p->last_update = shState->runTime();
     
@@ -1166,6 +1348,8 @@ void Graphics::update(bool checkForShutdown) {
     
     p->checkSyncLock();
     
+    /* Also while frozen, so files keep getting written */
+    shState->screenshotQueue().update();
     
 #ifdef MKXPZ_STEAM
     if (STEAMSHIM_alive())
@@ -1181,6 +1365,7 @@ void Graphics::update(bool checkForShutdown) {
             p->fpsLimiter.delay();
             ++p->frameCount;
             p->threadData->ethread->notifyFrame();
+            p->endBenchmarkFrame();
             
             return;
         } else {
@@ -1191,6 +1376,7 @@ void Graphics::update(bool checkForShutdown) {
     
     p->checkResize();
     p->redrawScreen();
+    p->endBenchmarkFrame();
 }
 
 void Graphics::freeze() {
@@ -1215,7 +1401,7 @@ void Graphics::transition(int duration, const char *filename, int vague) {
     setBrightness(255);
     
     /* Capture new scene */
-    p->screen.composite();
+    p->composite();
     
     /* The PP frontbuffer will hold the current scene after the
      * composition step. Since the backbuffer is unused during
@@ -1288,6 +1474,7 @@ void Graphics::transition(int duration, const char *filename, int vague) {
         p->checkResize();
         
         /* Then blit it flipped and scaled to the screen */
+        p->beginWindowDraw();
         FBO::unbind();
         FBO::clear();
         
@@ -1348,6 +1535,7 @@ void Graphics::fadeout(int duration) {
         setBrightness(diff + (curr / duration) * i);
         
         if (p->frozen) {
+            p->beginWindowDraw();
             GLMeta::blitBeginScreen(p->scSize);
             GLMeta::blitSource(p->frozenScene);
             
@@ -1373,6 +1561,7 @@ void Graphics::fadein(int duration) {
         setBrightness(curr + (diff / duration) * i);
         
         if (p->frozen) {
+            p->beginWindowDraw();
             GLMeta::blitBeginScreen(p->scSize);
             GLMeta::blitSource(p->frozenScene);
             
@@ -1497,6 +1686,23 @@ void Graphics::screenshot(const char *filename) {
     delete ss;
 }
 
+unsigned int Graphics::screenshotAsync(const char *filename) {
+    p->threadData->rqWindowAdjust.wait();
+    
+    std::string path = shState->fileSystem().normalize(filename, 1, 1);
+    
+    /* Read straight from the composited frame,
+     * no need for an intermediate Bitmap */
+    p->composite();
+    
+    return shState->screenshotQueue().request(p->screen.getPP().frontBuffer(),
+                                              p->scRes.x, p->scRes.y, path);
+}
+
+bool Graphics::screenshotDone(unsigned int handle, std::string &error) {
+    return shState->screenshotQueue().done(handle, error);
+}
+
 DEF_ATTR_RD_SIMPLE(Graphics, Brightness, int, p->brightness)
 
 void Graphics::setBrightness(int value) {
@@ -1648,6 +1854,7 @@ void Graphics::repaintWait(const AtomicFlag &exitCond, bool checkReset) {
     
     /* Repaint the screen with the last good frame we drew */
     TEXFBO &lastFrame = p->screen.getPP().frontBuffer();
+    p->beginWindowDraw();
     GLMeta::blitBeginScreen(p->winSize);
     GLMeta::blitSource(lastFrame);
     
@@ -1659,7 +1866,7 @@ void Graphics::repaintWait(const AtomicFlag &exitCond, bool checkReset) {
         
         FBO::clear();
         p->metaBlitBufferFlippedScaled();
-        SDL_GL_SwapWindow(p->threadData->window);
+        p->swapWindow();
         p->fpsLimiter.delay();
         
         p->threadData->ethread->notifyFrame();
@@ -1668,8 +1875,8 @@ void Graphics::repaintWait(const AtomicFlag &exitCond, bool checkReset) {
     GLMeta::blitEnd();
 }
 
-void Graphics::lock(bool force) {
-    p->setLock(force);
+void Graphics::lock(bool force, bool bindContext) {
+    p->setLock(force, bindContext);
 }
 
 void Graphics::unlock(bool force) {
@@ -24,6 +24,8 @@
 
 #include "util.h"
 
+#include <string>
+
 class Scene;
 class Bitmap;
 class Disposable;
@@ -67,6 +69,12 @@ public:
 	void playMovie(const char *filename, int volume, bool skippable);
 	void screenshot(const char *filename);
 
+	/* Like 'screenshot()', but the file is written in the background.
+	 * Returns a handle to check on it with 'screenshotDone()', which
+	 * behaves like ScreenshotQueue::done() */
+	unsigned int screenshotAsync(const char *filename);
+	bool screenshotDone(unsigned int handle, std::string &error);
+
 	void reset();
     void center();
 
@@ -90,7 +98,12 @@ public:
 	void repaintWait(const AtomicFlag &exitCond,
 	                 bool checkReset = true);
     
-    void lock(bool force = false);
+    /* Serializes access to graphics objects between Ruby
+     * threads while "thread_safe" is set (or if 'force').
+     * 'bindContext' also makes the GL context current on the
+     * calling thread; calls that only modify CPU side state
+     * don't need it */
+    void lock(bool force = false, bool bindContext = true);
     void unlock(bool force = false);
 
 private:
@@ -109,4 +122,8 @@ private:
 #define GFX_LOCK shState->graphics().lock()
 #define GFX_UNLOCK shState->graphics().unlock()
 
+/* For calls that don't issue GL commands */
+#define GFX_STATE_LOCK shState->graphics().lock(false, false)
+#define GFX_STATE_UNLOCK shState->graphics().unlock()
+
 #endif // GRAPHICS_H
@@ -53,6 +53,7 @@ private:
 	PlanePrivate *p;
 
 	void draw();
+	Profiler::Zone profileZone() const { return Profiler::Planes; }
 	void onGeometryChange(const Scene::Geometry &);
 
 	void releaseResources();
@@ -0,0 +1,273 @@
+/*
+** presenter.cpp
+**
+** This file is part of mkxp.
+**
+** Copyright (C) 2013 - 2021 Amaryllis Kulla <ancurio@mapleshrine.eu>
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "presenter.h"
+
+#include "gl-fun.h"
+#include "gl-util.h"
+#include "etc-internal.h"
+#include "exception.h"
+
+#include <SDL_thread.h>
+#include <SDL_mutex.h>
+
+#define FRAME_COUNT 2
+
+/* Nanoseconds */
+#define FENCE_WAIT_STEP 100000000
+
+struct PresentFrame
+{
+	TEXFBO buf;
+
+	/* Set while queued */
+	bool queued;
+	void *fence;
+
+	IntRect dst;
+	bool smooth;
+};
+
+struct FramePresenterPrivate
+{
+	SDL_Window *window;
+	SDL_GLContext ctx;
+	const bool vsync;
+
+	PresentFrame frames[FRAME_COUNT];
+
+	/* Next frame to be acquired (RGSS thread) and
+	 * shown (present thread); both go round robin */
+	int acquireIdx;
+	int presentIdx;
+
+	SDL_mutex *mutex;
+	/* Signalled when a frame is queued, or on quit */
+	SDL_cond *queuedCond;
+	/* Signalled when a frame was shown */
+	SDL_cond *shownCond;
+	bool quit;
+
+	SDL_Thread *thread;
+
+	FramePresenterPrivate(SDL_Window *window, SDL_GLContext ctx, bool vsync)
+	    : window(window),
+	      ctx(ctx),
+	      vsync(vsync),
+	      acquireIdx(0),
+	      presentIdx(0),
+	      quit(false),
+	      thread(0)
+	{
+		for (int i = 0; i < FRAME_COUNT; ++i)
+		{
+			frames[i].queued = false;
+			frames[i].fence = 0;
+			frames[i].smooth = false;
+		}
+
+		mutex = SDL_CreateMutex();
+		queuedCond = SDL_CreateCond();
+		shownCond = SDL_CreateCond();
+	}
+
+	~FramePresenterPrivate()
+	{
+		SDL_DestroyCond(shownCond);
+		SDL_DestroyCond(queuedCond);
+		SDL_DestroyMutex(mutex);
+	}
+
+	static void waitFence(void *fence)
+	{
+		while (gl.ClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+		                         FENCE_WAIT_STEP) == GL_TIMEOUT_EXPIRED);
+	}
+
+	void show(PresentFrame &frame, GLuint readFBO)
+	{
+		/* Wait until the RGSS thread's context finished drawing
+		 * the frame; contexts don't synchronize on their own */
+		waitFence(frame.fence);
+		gl.DeleteSync(frame.fence);
+		frame.fence = 0;
+
+		gl.BindFramebuffer(GL_READ_FRAMEBUFFER, readFBO);
+		gl.FramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+		                        GL_TEXTURE_2D, frame.buf.tex.gl, 0);
+		gl.BindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+
+		gl.Clear(GL_COLOR_BUFFER_BIT);
+
+		const IntRect &dst = frame.dst;
+		gl.BlitFramebuffer(0, 0, frame.buf.width, frame.buf.height,
+		                   dst.x, dst.y, dst.x + dst.w, dst.y + dst.h,
+		                   GL_COLOR_BUFFER_BIT, frame.smooth ? GL_LINEAR : GL_NEAREST);
+
+		void *blitted = gl.FenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+		SDL_GL_SwapWindow(window);
+
+		/* The buffer may only be drawn to again once
+		 * the blit has read it */
+		waitFence(blitted);
+		gl.DeleteSync(blitted);
+	}
+
+	void run()
+	{
+		SDL_GL_MakeCurrent(window, ctx);
+		SDL_GL_SetSwapInterval(vsync ? 1 : 0);
+
+		gl.ClearColor(0, 0, 0, 1);
+
+		GLuint readFBO;
+		gl.GenFramebuffers(1, &readFBO);
+
+		SDL_LockMutex(mutex);
+
+		while (true)
+		{
+			PresentFrame &frame = frames[presentIdx];
+
+			/* Queued frames are shown before quitting */
+			while (!frame.queued && !quit)
+				SDL_CondWait(queuedCond, mutex);
+
+			if (!frame.queued)
+				break;
+
+			SDL_UnlockMutex(mutex);
+			show(frame, readFBO);
+			SDL_LockMutex(mutex);
+
+			frame.queued = false;
+			presentIdx = (presentIdx + 1) % FRAME_COUNT;
+
+			SDL_CondBroadcast(shownCond);
+		}
+
+		SDL_UnlockMutex(mutex);
+
+		gl.DeleteFramebuffers(1, &readFBO);
+		SDL_GL_MakeCurrent(window, 0);
+	}
+
+	static int threadFunc(void *data)
+	{
+		static_cast<FramePresenterPrivate*>(data)->run();
+
+		return 0;
+	}
+};
+
+bool FramePresenter::supported()
+{
+	return gl.BlitFramebuffer && gl.FenceSync;
+}
+
+FramePresenter::FramePresenter(SDL_Window *window, SDL_GLContext ctx, bool vsync)
+{
+	p = new FramePresenterPrivate(window, ctx, vsync);
+	p->thread = SDL_CreateThread(FramePresenterPrivate::threadFunc, "present", p);
+
+	if (!p->thread)
+	{
+		delete p;
+		throw Exception(Exception::SDLError, "Error starting present thread: %s",
+		                SDL_GetError());
+	}
+
+	for (int i = 0; i < FRAME_COUNT; ++i)
+	{
+		TEXFBO::init(p->frames[i].buf);
+		TEXFBO::allocEmpty(p->frames[i].buf, 1, 1);
+		TEXFBO::linkFBO(p->frames[i].buf);
+	}
+}
+
+FramePresenter::~FramePresenter()
+{
+	SDL_LockMutex(p->mutex);
+	p->quit = true;
+	SDL_CondSignal(p->queuedCond);
+	SDL_UnlockMutex(p->mutex);
+
+	SDL_WaitThread(p->thread, 0);
+
+	for (int i = 0; i < FRAME_COUNT; ++i)
+	{
+		if (p->frames[i].fence)
+			gl.DeleteSync(p->frames[i].fence);
+
+		TEXFBO::fini(p->frames[i].buf);
+	}
+
+	delete p;
+}
+
+TEXFBO &FramePresenter::acquire(const Vec2i &size)
+{
+	PresentFrame &frame = p->frames[p->acquireIdx];
+
+	SDL_LockMutex(p->mutex);
+
+	while (frame.queued)
+		SDL_CondWait(p->shownCond, p->mutex);
+
+	SDL_UnlockMutex(p->mutex);
+
+	if (frame.buf.width != size.x || frame.buf.height != size.y)
+		TEXFBO::allocEmpty(frame.buf, size.x, size.y);
+
+	return frame.buf;
+}
+
+void FramePresenter::submit(const IntRect &dst, bool smooth)
+{
+	PresentFrame &frame = p->frames[p->acquireIdx];
+
+	frame.dst = dst;
+	frame.smooth = smooth;
+	frame.fence = gl.FenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+	/* Get the commands to the GPU, or the other
+	 * context could wait on the fence forever */
+	gl.Flush();
+
+	SDL_LockMutex(p->mutex);
+	frame.queued = true;
+	SDL_CondSignal(p->queuedCond);
+	SDL_UnlockMutex(p->mutex);
+
+	p->acquireIdx = (p->acquireIdx + 1) % FRAME_COUNT;
+}
+
+void FramePresenter::finish()
+{
+	SDL_LockMutex(p->mutex);
+
+	for (int i = 0; i < FRAME_COUNT; ++i)
+		while (p->frames[i].queued)
+			SDL_CondWait(p->shownCond, p->mutex);
+
+	SDL_UnlockMutex(p->mutex);
+}
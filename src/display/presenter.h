@@ -0,0 +1,71 @@
+/*
+** presenter.h
+**
+** This file is part of mkxp.
+**
+** Copyright (C) 2013 - 2021 Amaryllis Kulla <ancurio@mapleshrine.eu>
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PRESENTER_H
+#define PRESENTER_H
+
+#include <SDL_video.h>
+
+struct TEXFBO;
+struct Vec2i;
+struct IntRect;
+struct FramePresenterPrivate;
+
+/* Shows composited frames from a thread of its own, so scaling
+ * them into the window and waiting for the buffer swap (vsync)
+ * overlaps with the scripts running the next frame.
+ *
+ * The RGSS thread draws each frame into one of two buffers and
+ * queues it; the present thread blits it into the window through
+ * a second GL context sharing objects with the first one. With
+ * both buffers queued, acquiring the next one waits, so the game
+ * never runs more than one frame ahead of the display. */
+class FramePresenter
+{
+public:
+	/* Whether the loaded GL functions allow presenting
+	 * from another context */
+	static bool supported();
+
+	/* 'ctx' must share objects with the context current on the
+	 * calling thread, and stays owned by the caller */
+	FramePresenter(SDL_Window *window, SDL_GLContext ctx, bool vsync);
+
+	/* Shows all queued frames first */
+	~FramePresenter();
+
+	/* Returns a buffer of 'size' to draw the next frame into */
+	TEXFBO &acquire(const Vec2i &size);
+
+	/* Queues the buffer returned by the last acquire() to be
+	 * blitted to 'dst' in window coordinates (a negative height
+	 * flips it), filtered linearly if 'smooth' */
+	void submit(const IntRect &dst, bool smooth);
+
+	/* Waits until all queued frames were shown. Must be
+	 * called before drawing to the window directly */
+	void finish();
+
+private:
+	FramePresenterPrivate *p;
+};
+
+#endif // PRESENTER_H
@@ -0,0 +1,597 @@
+/*
+** profiler.cpp
+**
+** This file is part of mkxp.
+**
+** Copyright (C) 2013 - 2021 Amaryllis Kulla <ancurio@mapleshrine.eu>
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "profiler.h"
+
+#include "gl-fun.h"
+#include "gl-util.h"
+#include "glstate.h"
+#include "shader.h"
+#include "quad.h"
+#include "font.h"
+#include "sharedstate.h"
+#include "etc-internal.h"
+#include "debugwriter.h"
+
+#include <SDL_timer.h>
+#include <SDL_surface.h>
+#include <SDL_ttf.h>
+
+#include <stdio.h>
+#include <stdint.h>
+#include <algorithm>
+#include <deque>
+#include <vector>
+
+/* Zones past this many per frame are timed on the CPU only */
+#define MAX_FRAME_QUERIES 2048
+
+/* Frames whose GPU results are still outstanding; once
+ * exceeded, the oldest one is waited for */
+#define MAX_PENDING_FRAMES 4
+
+/* Roughly 40MB worth of trace */
+#define MAX_TRACE_EVENTS (1 << 20)
+
+#define OVERLAY_INTERVAL_MS 500
+#define OVERLAY_W 300
+#define OVERLAY_LINE_H 16
+#define OVERLAY_PAD 6
+#define OVERLAY_BAR_X 200
+#define OVERLAY_BAR_W 92
+
+/* Frame budget represented by a full overlay bar */
+#define OVERLAY_BAR_MS (1000.0 / 60)
+
+static const char *zoneNames[] =
+{
+	"Update",
+	"Frame wait",
+	"Composite",
+	"prepareDraw",
+	"Viewport",
+	"Sprites",
+	"Tilemaps",
+	"Windows",
+	"Planes",
+	"Other elements",
+	"Texture upload",
+	"Present"
+};
+
+struct ProfileEvent
+{
+	int zone;
+
+	/* Performance counter ticks; 'cpuEnd' is
+	 * 0 while the zone is open */
+	uint64_t cpuBegin, cpuEnd;
+
+	/* Indices into the frame's queries, -1 if none */
+	int queryBegin, queryEnd;
+};
+
+struct ProfileFrame
+{
+	std::vector<ProfileEvent> events;
+	std::vector<GLuint> queries;
+};
+
+struct TraceEvent
+{
+	int zone;
+	bool gpu;
+
+	/* Microseconds since the profiler was created */
+	double ts;
+	double dur;
+};
+
+struct ZoneStats
+{
+	double cpuMs;
+	double gpuMs;
+};
+
+struct ProfilerPrivate
+{
+	const std::string tracePath;
+	bool overlay;
+
+	const uint64_t startTicks;
+	const double ticksPerUs;
+
+	/* Recorded into while 'Profiler::current' is set */
+	ProfileFrame *frame;
+	std::vector<size_t> openEvents;
+
+	/* Closed frames waiting for their GPU results */
+	std::deque<ProfileFrame*> pending;
+	std::vector<ProfileFrame*> spareFrames;
+
+	std::vector<GLuint> spareQueries;
+
+	std::vector<TraceEvent> trace;
+	bool traceFull;
+
+	/* Offset from GPU timestamps (ns) to trace time (us),
+	 * taken from the first GPU zone */
+	bool haveGpuOffset;
+	double gpuOffset;
+
+	/* Accumulated for the overlay */
+	ZoneStats stats[Profiler::ZoneCount];
+	bool statsGpu;
+	int statsFrames;
+	uint64_t statsStart;
+
+	_TTF_Font *font;
+	SDL_Surface *overlaySurf;
+	TEX::ID overlayTex;
+	Vec2i overlaySize;
+	Quad overlayQuad;
+
+	ProfilerPrivate(const std::string &tracePath, bool overlay)
+	    : tracePath(tracePath),
+	      overlay(overlay),
+	      startTicks(SDL_GetPerformanceCounter()),
+	      ticksPerUs(SDL_GetPerformanceFrequency() / 1000000.0),
+	      frame(0),
+	      traceFull(false),
+	      haveGpuOffset(false),
+	      gpuOffset(0),
+	      font(0),
+	      overlaySurf(0),
+	      overlayTex(0)
+	{
+		resetStats();
+	}
+
+	~ProfilerPrivate()
+	{
+		for (size_t i = 0; i < spareFrames.size(); ++i)
+			delete spareFrames[i];
+
+		if (!spareQueries.empty())
+			gl.DeleteQueries(spareQueries.size(), &spareQueries[0]);
+
+		if (overlayTex != TEX::ID(0))
+			TEX::del(overlayTex);
+
+		if (overlaySurf)
+			SDL_FreeSurface(overlaySurf);
+
+		if (font)
+			TTF_CloseFont(font);
+	}
+
+	bool recording() const
+	{
+		return !tracePath.empty() || overlay;
+	}
+
+	double toUs(uint64_t ticks) const
+	{
+		return (ticks - startTicks) / ticksPerUs;
+	}
+
+	ProfileFrame *newFrame()
+	{
+		if (spareFrames.empty())
+			return new ProfileFrame;
+
+		ProfileFrame *f = spareFrames.back();
+		spareFrames.pop_back();
+
+		return f;
+	}
+
+	/* Returns the query index, or -1 if none was issued */
+	int timestamp()
+	{
+		if (!gl.QueryCounter || frame->queries.size() >= MAX_FRAME_QUERIES)
+			return -1;
+
+		if (spareQueries.empty())
+		{
+			spareQueries.resize(64);
+			gl.GenQueries(spareQueries.size(), &spareQueries[0]);
+		}
+
+		GLuint query = spareQueries.back();
+		spareQueries.pop_back();
+
+		gl.QueryCounter(query, GL_TIMESTAMP);
+		frame->queries.push_back(query);
+
+		return frame->queries.size() - 1;
+	}
+
+	void closeFrame()
+	{
+		/* Zones left open (there shouldn't be any)
+		 * are cut off at the frame boundary */
+		uint64_t now = SDL_GetPerformanceCounter();
+
+		for (size_t i = 0; i < openEvents.size(); ++i)
+		{
+			ProfileEvent &e = frame->events[openEvents[i]];
+			e.cpuEnd = now;
+			e.queryEnd = -1;
+		}
+
+		openEvents.clear();
+
+		pending.push_back(frame);
+		frame = 0;
+	}
+
+	/* Finishes pending frames whose GPU results are in.
+	 * With 'wait', all of them are waited for */
+	void collect(bool wait)
+	{
+		std::vector<uint64_t> times;
+
+		while (!pending.empty())
+		{
+			ProfileFrame *f = pending.front();
+
+			if (!f->queries.empty() && !wait && pending.size() <= MAX_PENDING_FRAMES)
+			{
+				/* Results become available in order */
+				GLint available = 0;
+				gl.GetQueryObjectiv(f->queries.back(), GL_QUERY_RESULT_AVAILABLE, &available);
+
+				if (!available)
+					break;
+			}
+
+			times.resize(f->queries.size());
+
+			for (size_t i = 0; i < f->queries.size(); ++i)
+				gl.GetQueryObjectui64v(f->queries[i], GL_QUERY_RESULT, &times[i]);
+
+			finishFrame(*f, times);
+
+			spareQueries.insert(spareQueries.end(), f->queries.begin(), f->queries.end());
+			f->queries.clear();
+			f->events.clear();
+
+			pending.pop_front();
+			spareFrames.push_back(f);
+		}
+	}
+
+	void finishFrame(const ProfileFrame &f, const std::vector<uint64_t> &times)
+	{
+		for (size_t i = 0; i < f.events.size(); ++i)
+		{
+			const ProfileEvent &e = f.events[i];
+
+			double ts = toUs(e.cpuBegin);
+			double dur = (e.cpuEnd - e.cpuBegin) / ticksPerUs;
+
+			stats[e.zone].cpuMs += dur / 1000.0;
+			addTrace(e.zone, false, ts, dur);
+
+			if (e.queryBegin < 0 || e.queryEnd < 0)
+				continue;
+
+			uint64_t gpuBegin = times[e.queryBegin];
+			double gpuDur = (times[e.queryEnd] - gpuBegin) / 1000.0;
+
+			if (!haveGpuOffset)
+			{
+				/* The GPU only starts on a zone some time after it was
+				 * submitted, so this puts the GPU track slightly ahead */
+				gpuOffset = ts - gpuBegin / 1000.0;
+				haveGpuOffset = true;
+			}
+
+			stats[e.zone].gpuMs += gpuDur / 1000.0;
+			statsGpu = true;
+			addTrace(e.zone, true, gpuBegin / 1000.0 + gpuOffset, gpuDur);
+		}
+
+		++statsFrames;
+	}
+
+	void addTrace(int zone, bool gpu, double ts, double dur)
+	{
+		if (tracePath.empty() || traceFull)
+			return;
+
+		if (trace.size() >= MAX_TRACE_EVENTS)
+		{
+			Debug() << "Profiler trace is full, recording stopped";
+			traceFull = true;
+
+			return;
+		}
+
+		TraceEvent e = { zone, gpu, ts, dur };
+		trace.push_back(e);
+	}
+
+	void writeTrace()
+	{
+		FILE *f = fopen(tracePath.c_str(), "w");
+
+		if (!f)
+		{
+			Debug() << "Failed to open profiler trace" << tracePath;
+			return;
+		}
+
+		fputs("{\"traceEvents\":[\n", f);
+		fputs("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,"
+		      "\"args\":{\"name\":\"RGSS (CPU)\"}},\n", f);
+		fputs("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,"
+		      "\"args\":{\"name\":\"GPU\"}}", f);
+
+		for (size_t i = 0; i < trace.size(); ++i)
+		{
+			const TraceEvent &e = trace[i];
+
+			fprintf(f, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,"
+			           "\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+			        zoneNames[e.zone], e.gpu ? "gpu" : "cpu", e.gpu ? 2 : 1, e.ts, e.dur);
+		}
+
+		fputs("\n],\"displayTimeUnit\":\"ms\"}\n", f);
+		fclose(f);
+
+		Debug() << "Profiler trace written to" << tracePath;
+	}
+
+	void resetStats()
+	{
+		for (int i = 0; i < Profiler::ZoneCount; ++i)
+			stats[i].cpuMs = stats[i].gpuMs = 0;
+
+		statsGpu = false;
+		statsFrames = 0;
+		statsStart = SDL_GetPerformanceCounter();
+	}
+
+	void drawLine(int line, const char *text, const SDL_Color &color)
+	{
+		SDL_Surface *txt = TTF_RenderUTF8_Blended(font, text, color);
+
+		if (!txt)
+			return;
+
+		SDL_Rect dst = { OVERLAY_PAD, OVERLAY_PAD + line * OVERLAY_LINE_H, 0, 0 };
+		SDL_BlitSurface(txt, 0, overlaySurf, &dst);
+		SDL_FreeSurface(txt);
+	}
+
+	void drawBar(int line, int offset, int height, double ms, Uint32 color)
+	{
+		int w = (int) (ms / OVERLAY_BAR_MS * OVERLAY_BAR_W + 0.5);
+
+		SDL_Rect rect = { OVERLAY_BAR_X, OVERLAY_PAD + line * OVERLAY_LINE_H + offset,
+		                  std::min(w, OVERLAY_BAR_W), height };
+		SDL_FillRect(overlaySurf, &rect, color);
+	}
+
+	/* Redraws the overlay from the averages since the last update */
+	void updateOverlay()
+	{
+		if (!font)
+		{
+			font = SharedFontState::openBundled(13);
+
+			if (!font)
+				return;
+		}
+
+		int lines = 1;
+
+		for (int i = 0; i < Profiler::ZoneCount; ++i)
+			if (stats[i].cpuMs > 0)
+				++lines;
+
+		Vec2i size(OVERLAY_W, lines * OVERLAY_LINE_H + OVERLAY_PAD * 2);
+
+		if (overlaySurf && (overlaySurf->w != size.x || overlaySurf->h != size.y))
+		{
+			SDL_FreeSurface(overlaySurf);
+			overlaySurf = 0;
+		}
+
+		if (!overlaySurf)
+		{
+			int bpp;
+			Uint32 rMask, gMask, bMask, aMask;
+			SDL_PixelFormatEnumToMasks(SDL_PIXELFORMAT_ABGR8888,
+			                           &bpp, &rMask, &gMask, &bMask, &aMask);
+
+			overlaySurf = SDL_CreateRGBSurface(0, size.x, size.y, bpp,
+			                                   rMask, gMask, bMask, aMask);
+
+			if (!overlaySurf)
+				return;
+		}
+
+		const SDL_PixelFormat *fmt = overlaySurf->format;
+		SDL_FillRect(overlaySurf, 0, SDL_MapRGBA(fmt, 0, 0, 0, 176));
+
+		const SDL_Color white = { 255, 255, 255, 255 };
+		const double n = statsFrames;
+		char buf[64];
+
+		snprintf(buf, sizeof(buf), "ms/frame (%d frames)   CPU / %s",
+		         statsFrames, statsGpu ? "GPU" : "no GPU");
+		drawLine(0, buf, white);
+
+		for (int i = 0, line = 1; i < Profiler::ZoneCount; ++i)
+		{
+			if (stats[i].cpuMs <= 0)
+				continue;
+
+			double cpu = stats[i].cpuMs / n;
+			double gpu = stats[i].gpuMs / n;
+
+			if (statsGpu)
+				snprintf(buf, sizeof(buf), "%s  %.2f / %.2f", zoneNames[i], cpu, gpu);
+			else
+				snprintf(buf, sizeof(buf), "%s  %.2f", zoneNames[i], cpu);
+
+			drawLine(line, buf, white);
+			drawBar(line, 3, 5, cpu, SDL_MapRGBA(fmt, 96, 200, 96, 255));
+
+			if (statsGpu)
+				drawBar(line, 9, 5, gpu, SDL_MapRGBA(fmt, 224, 128, 64, 255));
+
+			++line;
+		}
+
+		if (overlayTex == TEX::ID(0))
+		{
+			overlayTex = TEX::gen();
+			TEX::bind(overlayTex);
+			TEX::setRepeat(false);
+			TEX::setSmooth(false);
+		}
+
+		TEX::bind(overlayTex);
+		TEX::uploadImage(size.x, size.y, overlaySurf->pixels, GL_RGBA);
+
+		overlaySize = size;
+
+		FloatRect rect(0, 0, size.x, size.y);
+		overlayQuad.setTexPosRect(rect, rect);
+	}
+};
+
+Profiler *Profiler::current = 0;
+
+Profiler::Profiler(const std::string &tracePath, bool overlay)
+{
+	p = new ProfilerPrivate(tracePath, overlay);
+}
+
+Profiler::~Profiler()
+{
+	if (current == this)
+	{
+		p->closeFrame();
+		current = 0;
+	}
+
+	p->collect(true);
+
+	if (!p->tracePath.empty())
+		p->writeTrace();
+
+	delete p;
+}
+
+void Profiler::begin(Zone zone)
+{
+	ProfileEvent e;
+	e.zone = zone;
+	e.cpuEnd = 0;
+	e.queryEnd = -1;
+	e.queryBegin = p->timestamp();
+	e.cpuBegin = SDL_GetPerformanceCounter();
+
+	p->openEvents.push_back(p->frame->events.size());
+	p->frame->events.push_back(e);
+}
+
+void Profiler::end()
+{
+	/* The frame may have been closed under this zone */
+	if (p->openEvents.empty())
+		return;
+
+	ProfileEvent &e = p->frame->events[p->openEvents.back()];
+	p->openEvents.pop_back();
+
+	e.cpuEnd = SDL_GetPerformanceCounter();
+
+	if (e.queryBegin >= 0)
+		e.queryEnd = p->timestamp();
+}
+
+void Profiler::frameStart()
+{
+	if (current == this)
+	{
+		p->closeFrame();
+		current = 0;
+	}
+
+	p->collect(false);
+
+	if (p->overlay && p->statsFrames > 0 &&
+	    p->toUs(SDL_GetPerformanceCounter()) - p->toUs(p->statsStart) >= OVERLAY_INTERVAL_MS * 1000)
+	{
+		p->updateOverlay();
+		p->resetStats();
+	}
+
+	if (p->recording())
+	{
+		p->frame = p->newFrame();
+		current = this;
+	}
+}
+
+void Profiler::toggleOverlay()
+{
+	p->overlay = !p->overlay;
+	p->resetStats();
+}
+
+bool Profiler::overlayShown() const
+{
+	return p->overlay;
+}
+
+void Profiler::drawOverlay(const Vec2i &winSize)
+{
+	if (!p->overlay || p->overlayTex == TEX::ID(0))
+		return;
+
+	FBO::unbind();
+
+	glState.viewport.pushSet(IntRect(0, 0, winSize.x, winSize.y));
+	glState.scissorTest.pushSet(false);
+	glState.blend.pushSet(true);
+	glState.blendMode.pushSet(BlendNormal);
+
+	SimpleShader &shader = shState->shaders().simple;
+	shader.bind();
+	shader.applyViewportProj();
+	shader.setTranslation(Vec2i(OVERLAY_PAD, OVERLAY_PAD));
+	shader.setTexSize(p->overlaySize);
+
+	TEX::bind(p->overlayTex);
+	p->overlayQuad.draw();
+
+	glState.blendMode.pop();
+	glState.blend.pop();
+	glState.scissorTest.pop();
+	glState.viewport.pop();
+}
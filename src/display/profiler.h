@@ -0,0 +1,109 @@
+/*
+** profiler.h
+**
+** This file is part of mkxp.
+**
+** Copyright (C) 2013 - 2021 Amaryllis Kulla <ancurio@mapleshrine.eu>
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <string>
+
+struct Vec2i;
+struct ProfilerPrivate;
+
+/* Records nested, timed zones of each frame on the RGSS thread,
+ * with CPU timings and, where timestamp queries are supported,
+ * GPU timings. Results are shown in an overlay and/or written
+ * to a Chrome trace event file on exit.
+ *
+ * Zones are opened through ProfileScope, which costs a single
+ * pointer check while nothing is being recorded. Recording only
+ * starts or stops between frames (see 'frameStart()'). */
+class Profiler
+{
+public:
+	enum Zone
+	{
+		Update = 0,
+		FrameWait,
+		Composite,
+		PrepareDraw,
+		ViewportComposite,
+		Sprites,
+		Tilemaps,
+		Windows,
+		Planes,
+		OtherElements,
+		TexUpload,
+		Present,
+
+		ZoneCount
+	};
+
+	/* An empty 'tracePath' disables writing a trace */
+	Profiler(const std::string &tracePath, bool overlay);
+
+	/* Writes the trace (if any) */
+	~Profiler();
+
+	/* The profiler recording the current frame, or null */
+	static Profiler *recording() { return current; }
+
+	void begin(Zone zone);
+	void end();
+
+	/* Closes the previous frame and collects GPU results
+	 * that became available since. Called at the start of
+	 * every Graphics.update */
+	void frameStart();
+
+	void toggleOverlay();
+	bool overlayShown() const;
+
+	/* Draws the overlay into the top left corner of the
+	 * window framebuffer, if it is shown */
+	void drawOverlay(const Vec2i &winSize);
+
+private:
+	static Profiler *current;
+
+	ProfilerPrivate *p;
+};
+
+class ProfileScope
+{
+public:
+	ProfileScope(Profiler::Zone zone)
+	    : prof(Profiler::recording())
+	{
+		if (prof)
+			prof->begin(zone);
+	}
+
+	~ProfileScope()
+	{
+		if (prof)
+			prof->end();
+	}
+
+private:
+	Profiler *prof;
+};
+
+#endif // PROFILER_H
@@ -0,0 +1,315 @@
+/*
+** screenshotqueue.cpp
+**
+** This file is part of mkxp.
+**
+** Copyright (C) 2013 - 2021 Amaryllis Kulla <ancurio@mapleshrine.eu>
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "screenshotqueue.h"
+
+#include "decodepool.h"
+#include "bitmap.h"
+#include "gl-util.h"
+#include "debugwriter.h"
+
+#include <SDL_surface.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <map>
+#include <vector>
+
+/* Results nobody asked for are only kept this long */
+#define MAX_FINISHED 64
+
+struct ScreenshotJob : DecodePool::Job
+{
+	SDL_Surface *surf;
+	std::string path;
+	std::string error;
+
+	ScreenshotJob(SDL_Surface *surf, const std::string &path)
+	    : surf(surf),
+	      path(path)
+	{}
+
+	~ScreenshotJob()
+	{
+		if (surf)
+			SDL_FreeSurface(surf);
+	}
+
+	void run()
+	{
+		if (!Bitmap::writeSurface(surf, path.c_str()))
+			error = SDL_GetError();
+
+		SDL_FreeSurface(surf);
+		surf = 0;
+	}
+};
+
+struct PendingShot
+{
+	unsigned int handle;
+	std::string path;
+	int width, height;
+
+	/* Set while the readback is in flight */
+	PBO::ID buf;
+	void *sync;
+
+	/* Valid once handed over to the workers */
+	unsigned int batch;
+	bool encoding;
+
+	std::string key() const
+	{
+		char buf[32];
+		snprintf(buf, sizeof(buf), "screenshot:%u", handle);
+
+		return buf;
+	}
+};
+
+struct ScreenshotQueuePrivate
+{
+	DecodePool &pool;
+
+	std::vector<PendingShot> shots;
+	unsigned int nextHandle;
+
+	/* Handle -> error message (empty on success) */
+	std::map<unsigned int, std::string> finished;
+
+	ScreenshotQueuePrivate(DecodePool &pool)
+	    : pool(pool),
+	      nextHandle(0)
+	{}
+
+	SDL_Surface *createSurface(int width, int height)
+	{
+		int bpp;
+		Uint32 rMask, gMask, bMask, aMask;
+		SDL_PixelFormatEnumToMasks(SDL_PIXELFORMAT_ABGR8888,
+		                           &bpp, &rMask, &gMask, &bMask, &aMask);
+
+		return SDL_CreateRGBSurface(0, width, height, bpp, rMask, gMask, bMask, aMask);
+	}
+
+	void encode(PendingShot &shot, SDL_Surface *surf)
+	{
+		shot.batch = pool.newBatch();
+		shot.encoding = true;
+
+		pool.enqueue(shot.batch, shot.key(), new ScreenshotJob(surf, shot.path));
+	}
+
+	void fail(PendingShot &shot, const char *error)
+	{
+		/* An empty batch is done right away */
+		shot.batch = pool.newBatch();
+		shot.encoding = true;
+
+		record(shot, error);
+	}
+
+	/* Maps the pixel buffer of 'shot', waiting for the
+	 * transfer if necessary, and starts encoding it */
+	void collect(PendingShot &shot)
+	{
+		int pitch = shot.width * 4;
+
+		PBO::bind(shot.buf);
+		const uint8_t *data = (const uint8_t*)
+			gl.MapBufferRange(GL_PIXEL_PACK_BUFFER, 0, pitch * shot.height, GL_MAP_READ_BIT);
+
+		SDL_Surface *surf = data ? createSurface(shot.width, shot.height) : 0;
+
+		if (surf)
+		{
+			for (int y = 0; y < shot.height; ++y)
+				memcpy((uint8_t*) surf->pixels + y * surf->pitch, data + y * pitch, pitch);
+		}
+
+		if (data)
+			gl.UnmapBuffer(GL_PIXEL_PACK_BUFFER);
+
+		PBO::unbind();
+		PBO::del(shot.buf);
+		shot.buf = PBO::ID(0);
+
+		gl.DeleteSync(shot.sync);
+		shot.sync = 0;
+
+		if (surf)
+			encode(shot, surf);
+		else
+			fail(shot, data ? SDL_GetError() : "Failed to map screenshot buffer");
+	}
+
+	void record(PendingShot &shot, const std::string &error)
+	{
+		if (!error.empty())
+			Debug() << "Failed to write screenshot" << shot.path << ":" << error;
+
+		pool.releaseBatch(shot.batch);
+
+		finished[shot.handle] = error;
+
+		while (finished.size() > MAX_FINISHED)
+			finished.erase(finished.begin());
+	}
+
+	/* Moves written files from 'shots' into 'finished' */
+	void reap()
+	{
+		for (size_t i = 0; i < shots.size();)
+		{
+			PendingShot &shot = shots[i];
+
+			if (!shot.encoding || !pool.batchDone(shot.batch))
+			{
+				++i;
+				continue;
+			}
+
+			ScreenshotJob *job = static_cast<ScreenshotJob*>(pool.take(shot.key()));
+
+			/* Taken jobs have run; a missing one was failed before */
+			if (job)
+				record(shot, job->error);
+
+			delete job;
+			shots.erase(shots.begin() + i);
+		}
+	}
+};
+
+ScreenshotQueue::ScreenshotQueue(DecodePool &pool)
+{
+	p = new ScreenshotQueuePrivate(pool);
+}
+
+ScreenshotQueue::~ScreenshotQueue()
+{
+	finish();
+
+	delete p;
+}
+
+unsigned int ScreenshotQueue::request(const TEXFBO &frame, int width, int height,
+                                      const std::string &path)
+{
+	PendingShot shot;
+	shot.handle = ++p->nextHandle;
+	shot.path = path;
+	shot.width = width;
+	shot.height = height;
+	shot.sync = 0;
+	shot.batch = 0;
+	shot.encoding = false;
+
+	FBO::bind(frame.fbo);
+
+	if (gl.FenceSync)
+	{
+		shot.buf = PBO::gen();
+		PBO::bind(shot.buf);
+		PBO::allocEmpty(width * height * 4, GL_STREAM_READ);
+
+		gl.ReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+
+		PBO::unbind();
+
+		shot.sync = gl.FenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+	else
+	{
+		SDL_Surface *surf = p->createSurface(width, height);
+
+		if (surf)
+		{
+			gl.ReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, surf->pixels);
+			p->encode(shot, surf);
+		}
+		else
+		{
+			p->fail(shot, SDL_GetError());
+		}
+	}
+
+	p->shots.push_back(shot);
+
+	return shot.handle;
+}
+
+void ScreenshotQueue::update()
+{
+	for (size_t i = 0; i < p->shots.size(); ++i)
+	{
+		PendingShot &shot = p->shots[i];
+
+		if (shot.encoding)
+			continue;
+
+		GLenum result = gl.ClientWaitSync(shot.sync, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+
+		if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED)
+			p->collect(shot);
+	}
+
+	p->reap();
+}
+
+bool ScreenshotQueue::done(unsigned int handle, std::string &error)
+{
+	update();
+
+	std::map<unsigned int, std::string>::iterator iter = p->finished.find(handle);
+
+	if (iter != p->finished.end())
+	{
+		error = iter->second;
+		p->finished.erase(iter);
+
+		return true;
+	}
+
+	for (size_t i = 0; i < p->shots.size(); ++i)
+		if (p->shots[i].handle == handle)
+			return false;
+
+	/* Never requested, already reported, or its result was
+	 * dropped to make room; either way, nothing says it worked */
+	char buf[128];
+	snprintf(buf, sizeof(buf), "Unknown screenshot handle %u (already "
+	         "reported, or its result was discarded)", handle);
+	error = buf;
+
+	return true;
+}
+
+void ScreenshotQueue::finish()
+{
+	for (size_t i = 0; i < p->shots.size(); ++i)
+		if (!p->shots[i].encoding)
+			p->collect(p->shots[i]);
+
+	p->pool.wait();
+	p->reap();
+}
@@ -0,0 +1,70 @@
+/*
+** screenshotqueue.h
+**
+** This file is part of mkxp.
+**
+** Copyright (C) 2013 - 2021 Amaryllis Kulla <ancurio@mapleshrine.eu>
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SCREENSHOTQUEUE_H
+#define SCREENSHOTQUEUE_H
+
+#include <string>
+
+struct TEXFBO;
+class DecodePool;
+struct ScreenshotQueuePrivate;
+
+/* Writes frames to image files without stalling the RGSS thread.
+ * A frame is first copied into a pixel buffer object, which is
+ * picked up once the GPU signals it's done (usually a frame or
+ * two later). Encoding and writing the file then happens on a
+ * DecodePool worker.
+ *
+ * Without fence support, the readback itself is synchronous,
+ * but encoding still moves off the RGSS thread. */
+class ScreenshotQueue
+{
+public:
+	ScreenshotQueue(DecodePool &pool);
+
+	/* Writes out everything still pending */
+	~ScreenshotQueue();
+
+	/* Starts reading back the top left 'width' x 'height' area
+	 * of 'frame', to be written to 'path' (already normalized).
+	 * Returns a handle for 'done()' */
+	unsigned int request(const TEXFBO &frame, int width, int height,
+	                     const std::string &path);
+
+	/* Hands finished readbacks over to the workers.
+	 * Should be called once per frame */
+	void update();
+
+	/* Returns false while the file for 'handle' is still being
+	 * written. Once it returns true, 'error' is empty on success,
+	 * and the handle is forgotten. Unknown handles (including
+	 * ones whose result was discarded) count as failed */
+	bool done(unsigned int handle, std::string &error);
+
+	/* Blocks until all requested files are written */
+	void finish();
+
+private:
+	ScreenshotQueuePrivate *p;
+};
+
+#endif // SCREENSHOTQUEUE_H
@@ -33,6 +33,7 @@
 #include "shader.h"
 #include "glstate.h"
 #include "quadarray.h"
+#include "spritebatch.h"
 
 #include <math.h>
 #ifndef M_PI
@@ -597,6 +598,36 @@ void Sprite::draw()
     p->invert             ||
     (p->pattern && !p->pattern->isDisposed());
     
+    SpriteBatch &batch = shState->spriteBatch();
+    
+    if (!renderEffect && !p->wave.active)
+    {
+        /* Would only blend transparent pixels */
+        if (p->bitmap->storagePending())
+            return;
+        
+        /* Plain sprite: transform the quad on the CPU and let
+         * it join neighbouring sprites in a single draw call */
+        const float *m = p->trans.getMatrix();
+        Vertex vert[4];
+        
+        for (int i = 0; i < 4; ++i)
+        {
+            const Vec2 &pos = p->quad.vert[i].pos;
+            
+            vert[i].pos = Vec2(m[0] * pos.x + m[4] * pos.y + m[12],
+                               m[1] * pos.x + m[5] * pos.y + m[13]);
+            vert[i].texPos = p->quad.vert[i].texPos;
+            vert[i].color = Vec4(1, 1, 1, p->opacity.norm);
+        }
+        
+        batch.push(p->bitmap->getGLTypes(), p->blendType, vert);
+        return;
+    }
+    
+    /* Keep submission order with sprites batched before us */
+    batch.flush();
+    
     if (renderEffect)
     {
         SpriteShader &shader = shState->shaders().sprite;
@@ -610,7 +641,9 @@ void Sprite::draw()
         shader.setBushDepth(p->efBushDepth);
         shader.setBushOpacity(p->bushOpacity.norm);
         
-        if (p->pattern && p->patternOpacity > 0) {
+        /* A blank pattern blends to nothing, and must not get
+         * its texture committed in the middle of drawing */
+        if (p->pattern && p->patternOpacity > 0 && !p->pattern->storagePending()) {
             shader.setPattern(p->pattern->getGLTypes().tex, Vec2(p->pattern->width(), p->pattern->height()));
             shader.setPatternBlendType(p->patternBlendType);
             shader.setPatternTile(p->patternTile);
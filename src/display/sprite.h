@@ -82,6 +82,8 @@ private:
 	SpritePrivate *p;
 
 	void draw();
+	bool batchesDraw() const { return true; }
+	Profiler::Zone profileZone() const { return Profiler::Sprites; }
 	void onGeometryChange(const Scene::Geometry &);
 
 	void releaseResources();
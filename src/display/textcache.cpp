@@ -0,0 +1,264 @@
+/*
+** textcache.cpp
+**
+** This file is part of mkxp.
+**
+** Copyright (C) 2013 - 2021 Amaryllis Kulla <ancurio@mapleshrine.eu>
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "textcache.h"
+
+#include "sharedstate.h"
+#include "texpool.h"
+#include "gl-meta.h"
+#include "etc-internal.h"
+#include "boost-hash.h"
+#include "intrulist.h"
+
+#include <SDL_surface.h>
+
+/* Measurements are tiny, a count is enough to bound them */
+#define MAX_SIZE_ENTRIES 4096
+
+/* A single image may take at most this fraction of the budget,
+ * so one huge string can't flush everything else out */
+#define MAX_ENTRY_FRACTION 4
+
+struct TextCacheEntry
+{
+	std::string key;
+	TEXFBO tex;
+
+	Vec2i size;
+	int textH;
+
+	/* Most recently drawn entries are at the front */
+	IntruListLink<TextCacheEntry> link;
+
+	TextCacheEntry(const std::string &key, const TEXFBO &tex,
+	               const Vec2i &size, int textH)
+	    : key(key),
+	      tex(tex),
+	      size(size),
+	      textH(textH),
+	      link(this)
+	{}
+
+	uint64_t byteCount() const
+	{
+		return (uint64_t) tex.width * tex.height * 4;
+	}
+};
+
+struct TextSizeEntry
+{
+	std::string key;
+	IntRect rect;
+
+	IntruListLink<TextSizeEntry> link;
+
+	TextSizeEntry(const std::string &key, const IntRect &rect)
+	    : key(key),
+	      rect(rect),
+	      link(this)
+	{}
+};
+
+struct TextCachePrivate
+{
+	BoostHash<std::string, TextCacheEntry*> entries;
+	IntruList<TextCacheEntry> lru;
+
+	BoostHash<std::string, TextSizeEntry*> sizeEntries;
+	IntruList<TextSizeEntry> sizeLru;
+
+	const uint64_t maxMemSize;
+	uint64_t memSize;
+
+	TextCache::Stats stats;
+
+	TextCachePrivate(uint64_t maxMemSize)
+	    : maxMemSize(maxMemSize),
+	      memSize(0)
+	{
+		stats.hits = 0;
+		stats.misses = 0;
+		stats.evictions = 0;
+		stats.sizeHits = 0;
+		stats.sizeMisses = 0;
+	}
+
+	void evict(TextCacheEntry *entry)
+	{
+		entries.remove(entry->key);
+		lru.remove(entry->link);
+		memSize -= entry->byteCount();
+
+		shState->texPool().release(entry->tex);
+		delete entry;
+	}
+
+	void evictSize(TextSizeEntry *entry)
+	{
+		sizeEntries.remove(entry->key);
+		sizeLru.remove(entry->link);
+
+		delete entry;
+	}
+};
+
+TextCache::TextCache(uint64_t maxMemSize)
+{
+	p = new TextCachePrivate(maxMemSize);
+}
+
+TextCache::~TextCache()
+{
+	/* Nothing is drawn anymore, don't recycle into the TexPool */
+	BoostHash<std::string, TextCacheEntry*>::const_iterator iter;
+
+	for (iter = p->entries.cbegin(); iter != p->entries.cend(); ++iter)
+	{
+		TEXFBO::fini(iter->second->tex);
+		delete iter->second;
+	}
+
+	BoostHash<std::string, TextSizeEntry*>::const_iterator sIter;
+
+	for (sIter = p->sizeEntries.cbegin(); sIter != p->sizeEntries.cend(); ++sIter)
+		delete sIter->second;
+
+	delete p;
+}
+
+bool TextCache::enabled() const
+{
+	return p->maxMemSize > 0;
+}
+
+TEXFBO *TextCache::lookup(const std::string &key, Vec2i &size, int &textH)
+{
+	TextCacheEntry *entry = p->entries.value(key, 0);
+
+	if (!entry)
+	{
+		++p->stats.misses;
+		return 0;
+	}
+
+	p->lru.remove(entry->link);
+	p->lru.prepend(entry->link);
+
+	size = entry->size;
+	textH = entry->textH;
+	++p->stats.hits;
+
+	return &entry->tex;
+}
+
+TEXFBO *TextCache::store(const std::string &key, TEXFBO *tex,
+                         const SDL_Surface *surf, const Vec2i &size, int textH)
+{
+	if ((uint64_t) size.x * size.y * 4 > p->maxMemSize / MAX_ENTRY_FRACTION)
+		return 0;
+
+	if (p->entries.contains(key))
+		p->evict(p->entries[key]);
+
+	TEXFBO copy = shState->texPool().request(size.x, size.y);
+
+	if (tex)
+	{
+		GLMeta::blitBegin(copy);
+		GLMeta::blitSource(*tex);
+		GLMeta::blitRectangle(IntRect(0, 0, size.x, size.y), Vec2i());
+		GLMeta::blitEnd();
+	}
+	else
+	{
+		TEX::bind(copy.tex);
+		TEX::uploadSubImage(0, 0, size.x, size.y, surf->pixels, GL_RGBA);
+	}
+
+	TextCacheEntry *entry = new TextCacheEntry(key, copy, size, textH);
+
+	p->entries.insert(key, entry);
+	p->lru.prepend(entry->link);
+	p->memSize += entry->byteCount();
+
+	/* Never evicts 'entry' itself, as it fits the budget on its own */
+	while (p->memSize > p->maxMemSize)
+	{
+		p->evict(p->lru.tail());
+		++p->stats.evictions;
+	}
+
+	return &entry->tex;
+}
+
+bool TextCache::lookupSize(const std::string &key, IntRect &rect)
+{
+	TextSizeEntry *entry = p->sizeEntries.value(key, 0);
+
+	if (!entry)
+	{
+		++p->stats.sizeMisses;
+		return false;
+	}
+
+	p->sizeLru.remove(entry->link);
+	p->sizeLru.prepend(entry->link);
+
+	rect = entry->rect;
+	++p->stats.sizeHits;
+
+	return true;
+}
+
+void TextCache::storeSize(const std::string &key, const IntRect &rect)
+{
+	if (p->sizeEntries.contains(key))
+		p->evictSize(p->sizeEntries[key]);
+
+	TextSizeEntry *entry = new TextSizeEntry(key, rect);
+
+	p->sizeEntries.insert(key, entry);
+	p->sizeLru.prepend(entry->link);
+
+	while (p->sizeLru.getSize() > MAX_SIZE_ENTRIES)
+		p->evictSize(p->sizeLru.tail());
+}
+
+void TextCache::clear()
+{
+	while (!p->lru.isEmpty())
+		p->evict(p->lru.tail());
+
+	while (!p->sizeLru.isEmpty())
+		p->evictSize(p->sizeLru.tail());
+}
+
+TextCache::Stats TextCache::stats() const
+{
+	Stats stats = p->stats;
+
+	stats.entries = p->lru.getSize();
+	stats.memSize = p->memSize;
+	stats.maxMemSize = p->maxMemSize;
+	stats.sizeEntries = p->sizeLru.getSize();
+
+	return stats;
+}
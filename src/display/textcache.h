@@ -0,0 +1,91 @@
+/*
+** textcache.h
+**
+** This file is part of mkxp.
+**
+** Copyright (C) 2013 - 2021 Amaryllis Kulla <ancurio@mapleshrine.eu>
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TEXTCACHE_H
+#define TEXTCACHE_H
+
+#include "gl-util.h"
+
+#include <stdint.h>
+#include <string>
+
+struct IntRect;
+struct Vec2i;
+struct SDL_Surface;
+struct TextCachePrivate;
+
+/* Keeps the final images of recently drawn strings (after shadow
+ * and outline were applied, before opacity), and the results of
+ * recent Bitmap#text_size calls, so that labels drawn over and
+ * over don't have to be rasterized and measured each time.
+ *
+ * Keys are built by the caller and must cover everything that
+ * affects the result (font, style, colors, string). Images are
+ * evicted least recently used first once their memory budget
+ * is exceeded; measurements are capped by count. */
+class TextCache
+{
+public:
+	struct Stats
+	{
+		uint64_t hits;
+		uint64_t misses;
+		uint64_t evictions;
+
+		uint32_t entries;
+		uint64_t memSize;
+		uint64_t maxMemSize;
+
+		uint64_t sizeHits;
+		uint64_t sizeMisses;
+		uint32_t sizeEntries;
+	};
+
+	/* A 'maxMemSize' of 0 disables the cache */
+	TextCache(uint64_t maxMemSize);
+	~TextCache();
+
+	bool enabled() const;
+
+	/* On a hit, returns the cached image and writes its size
+	 * and unoutlined text height. Returns null on a miss.
+	 * The texture is only valid until the next 'store()' */
+	TEXFBO *lookup(const std::string &key, Vec2i &size, int &textH);
+
+	/* Copies the top left 'size' area of either 'tex' or 'surf'
+	 * (whichever is non-null) into the cache. Returns the cached
+	 * copy, or null if the image is too large to be cached */
+	TEXFBO *store(const std::string &key, TEXFBO *tex,
+	              const SDL_Surface *surf, const Vec2i &size, int textH);
+
+	bool lookupSize(const std::string &key, IntRect &rect);
+	void storeSize(const std::string &key, const IntRect &rect);
+
+	/* Frees all cached images and measurements */
+	void clear();
+
+	Stats stats() const;
+
+private:
+	TextCachePrivate *p;
+};
+
+#endif // TEXTCACHE_H
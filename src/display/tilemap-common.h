@@ -63,6 +63,15 @@ tableGetWrapped(const Table &t, int x, int y, int z = 0)
 	             z);
 }
 
+/* Whether map tile x/y shows up in 'viewp', which
+ * may extend past the map edges (the map wraps) */
+static inline bool
+viewportShowsTile(const IntRect &viewp, const Table &t, int x, int y)
+{
+	return wrap(x - viewp.x, t.xSize()) < viewp.w &&
+	       wrap(y - viewp.y, t.ySize()) < viewp.h;
+}
+
 /* Calculate the tile x/y on which this pixel x/y lies */
 static inline Vec2i
 getTilePos(const Vec2i &pixelPos)
@@ -131,6 +140,7 @@ struct FlashMap
 		GLMeta::vaoFini(vao);
 		VBO::del(vao.vbo);
 		dataCon.disconnect();
+		dataCellCon.disconnect();
 	}
 
 	Table *getData() const
@@ -145,14 +155,14 @@ struct FlashMap
 
 		data = value;
 		dataCon.disconnect();
+		dataCellCon.disconnect();
 		dirty = true;
 
 		if (!data)
 			return;
 
-        
-        
-        dataCon = data->modified.connect(&FlashMap::setDirty, this);
+		dataCon = data->modified.connect(&FlashMap::setDirty, this);
+		dataCellCon = data->cellModified.connect(&FlashMap::onCellModified, this);
 	}
 
 	void setViewport(const IntRect &value)
@@ -199,6 +209,12 @@ private:
 		dirty = true;
 	}
 
+	void onCellModified(int x, int y, int)
+	{
+		if (viewportShowsTile(viewp, *data, x, y))
+			dirty = true;
+	}
+
 	size_t quadCount() const
 	{
 		return vertices.size() / 4;
@@ -270,6 +286,7 @@ private:
 
 	Table *data;
 	sigslot::connection dataCon;
+	sigslot::connection dataCellCon;
 
 	IntRect viewp;
 
@@ -46,6 +46,8 @@
 #include <stdint.h>
 #include <algorithm>
 #include <vector>
+#include <limits.h>
+#include <assert.h>
 
 #include <SDL_surface.h>
 
@@ -72,6 +74,61 @@ static const int viewpH = 45; //16
 
 static const size_t zlayersMax = viewpH + 5;
 
+/* Map rows held in the tile cache */
+static const int cacheRowsN = viewpH + 1;
+
+/* Ground plus priorities 1 to 5 */
+static const int tileTargetsN = 6;
+
+/* Map cells set in one frame beyond which
+ * regenerating everything is cheaper */
+static const size_t dirtyCellsMax = 256;
+
+/* Vertices generated for one map row, split by
+ * target (0 = ground, 1-5 = priority) */
+struct TileRow
+{
+	/* Map row held here, or -1 if unused */
+	int y;
+
+	SVVector vert[tileTargetsN];
+
+	/* Quads contributed by each cached column,
+	 * in the same order as 'vert' */
+	std::vector<uint16_t> colQuads[tileTargetsN];
+
+	TileRow()
+	    : y(-1)
+	{}
+
+	void clear()
+	{
+		y = -1;
+
+		for (int i = 0; i < tileTargetsN; ++i)
+		{
+			vert[i].clear();
+			colQuads[i].clear();
+		}
+	}
+};
+
+/* A fixed region of the shared tile VBO. Quads past
+ * 'count' up to 'capacity' are degenerate padding */
+struct TileSlot
+{
+	size_t base;
+	size_t capacity;
+	size_t count;
+
+	/* Map row (ground) or absolute zlayer index held */
+	int key;
+
+	TileSlot()
+	    : base(0), capacity(0), count(0), key(INT_MIN)
+	{}
+};
+
 /* Vocabulary:
  *
  * Atlas: A texture containing both the tileset and all
@@ -152,9 +209,23 @@ static const size_t zlayersMax = viewpH + 5;
  *   This rectangle describes the subregion of the map that is
  *   actually translated to vertices and stored on the GPU ready
  *   for rendering. Whenever, ox/oy are modified, its position is
- *   adjusted if necessary and the data is regenerated. Its size
+ *   adjusted if necessary and the data is updated. Its size
  *   is fixed. This is NOT related to the RGSS Viewport class!
  *
+ * Tile cache:
+ *   Vertices are generated per map row into a ring of 'TileRow's
+ *   (indexed by map row modulo the ring size), with positions
+ *   relative to a fixed anchor tile instead of the map viewport,
+ *   so they stay valid while scrolling. Moving the map viewport
+ *   by a tile only generates the newly exposed row/column.
+ *   The VBO is split into slots, one per cached row (ground) and
+ *   one per zlayer (keyed by absolute layer index, also as a ring),
+ *   each with some spare capacity filled by degenerate quads.
+ *   A vertical scroll thus only re-uploads the slots it touched;
+ *   if a slot outgrows its capacity, everything is laid out anew.
+ *   Likewise, setting single cells of the map data only regenerates
+ *   their column of the cached row and re-uploads the slots of it.
+ *
  */
 
 /* Autotile animation */
@@ -204,6 +275,7 @@ struct GroundLayer : public ViewportElement
 
 	void draw();
 	void drawInt();
+	Profiler::Zone profileZone() const { return Profiler::Tilemaps; }
 
 	void onGeometryChange(const Scene::Geometry &geo);
 
@@ -231,11 +303,12 @@ struct ZLayer : public ViewportElement
 
 	void draw();
 	void drawInt();
+	Profiler::Zone profileZone() const { return Profiler::Tilemaps; }
 
 	static int calculateZ(TilemapPrivate *p, int index);
 
 	void initUpdateZ();
-	void finiUpdateZ(ZLayer *prev);
+	void finiUpdateZ();
 
 	ABOUT_TO_ACCESS_NOOP
 };
@@ -286,15 +359,28 @@ struct TilemapPrivate
 	/* Map viewport position */
 	Vec2i viewpPos;
 
-	/* Ground layer vertices */
-	SVVector groundVert;
+	/* Tile cache, see above */
+	TileRow rows[cacheRowsN];
+
+	/* Anchor tile of cached vertex positions */
+	Vec2i cacheOrigin;
+
+	/* Map tiles held in the cache (inclusive) */
+	Vec2i cacheMin, cacheMax;
+	bool cacheValid;
+
+	/* VBO slots, ground rows first */
+	TileSlot groundSlots[cacheRowsN];
+	TileSlot zlayerSlots[zlayersMax];
 
-	/* ZLayer vertices */
-	SVVector zlayerVert[zlayersMax];
+	/* Non-padding quads in all ground slots */
+	size_t groundQuads;
 
-	/* Base quad indices of each zlayer
-	 * in the shared buffer */
-	size_t zlayerBases[zlayersMax+1];
+	/* Cached map cells set since the last prepare */
+	std::vector<Vec2i> dirtyCells;
+
+	/* Staging buffer for slot uploads */
+	SVVector slotVert;
 
 	/* Shared buffers for all tiles */
 	struct
@@ -327,8 +413,10 @@ struct TilemapPrivate
 	bool atlasSizeDirty;
 	/* Affected by: autotiles(.changed), tileset(.changed), allocateAtlas */
 	bool atlasDirty;
-	/* Affected by: mapData(.changed), priorities(.changed) */
+	/* Affected by: mapData(.changed), priorities(.changed), allocateAtlas */
 	bool buffersDirty;
+	/* Affected by: ox, oy (map viewport moved) */
+	bool buffersScrolled;
 	/* Affected by: ox, oy */
 	bool mapViewportDirty;
 	/* Affected by: oy */
@@ -341,7 +429,9 @@ struct TilemapPrivate
 	sigslot::connection tilesetCon;
 	sigslot::connection autotilesCon[autotileCount];
 	sigslot::connection mapDataCon;
+	sigslot::connection mapDataCellCon;
 	sigslot::connection prioritiesCon;
+	sigslot::connection prioritiesCellCon;
 
 	/* Dispose watches */
 	sigslot::connection autotilesDispCon[autotileCount];
@@ -355,10 +445,13 @@ struct TilemapPrivate
 	      mapData(0),
 	      priorities(0),
 	      visible(true),
+	      cacheValid(false),
+	      groundQuads(0),
 	      flashAlphaIdx(0),
 	      atlasSizeDirty(false),
 	      atlasDirty(false),
 	      buffersDirty(false),
+	      buffersScrolled(false),
 	      mapViewportDirty(false),
 	      zOrderDirty(false),
 	      tilemapReady(false)
@@ -413,7 +506,9 @@ struct TilemapPrivate
 			autotilesDispCon[i].disconnect();
 		}
 		mapDataCon.disconnect();
+		mapDataCellCon.disconnect();
 		prioritiesCon.disconnect();
+		prioritiesCellCon.disconnect();
 
 		prepareCon.disconnect();
 	}
@@ -509,6 +604,38 @@ struct TilemapPrivate
 		buffersDirty = true;
 	}
 
+	void onMapCellModified(int x, int y, int)
+	{
+		if (buffersDirty)
+			return;
+
+		/* Cells outside the cache are generated
+		 * from the current data once they scroll in */
+		if (!rowCached(y) || x < cacheMin.x || x > cacheMax.x)
+			return;
+
+		Vec2i cell(x, y);
+
+		/* Usually the layers of one cell are set in a row */
+		if (!dirtyCells.empty() && dirtyCells.back() == cell)
+			return;
+
+		if (dirtyCells.size() == dirtyCellsMax)
+		{
+			dirtyCells.clear();
+			buffersDirty = true;
+			return;
+		}
+
+		dirtyCells.push_back(cell);
+	}
+
+	/* A priority affects every cell with that tile */
+	void onPrioritiesCellModified(int, int, int)
+	{
+		buffersDirty = true;
+	}
+
 	/* Checks for the minimum amount of data needed to display */
 	bool verifyResources()
 	{
@@ -531,6 +658,9 @@ struct TilemapPrivate
 		shState->requestAtlasTex(atlas.size.x, atlas.size.y, atlas.gl);
 
 		atlasDirty = true;
+
+		/* Cached vertices hold atlas coordinates */
+		buffersDirty = true;
 	}
 
 	/* Assembles atlas from tileset and autotile bitmaps */
@@ -560,6 +690,11 @@ struct TilemapPrivate
 			Bitmap *autotile = autotiles[atInd];
             autotile->ensureNonAnimated();
 
+			/* Blank autotiles (RPG::Cache hands out Bitmap.new(32, 32)
+			 * for empty slots) are already clear in the atlas */
+			if (autotile->storagePending())
+				continue;
+
 			int atW = autotile->width();
 			int atH = autotile->height();
 			int blitW = std::min(atW, atAreaW);
@@ -567,6 +702,15 @@ struct TilemapPrivate
 
 			GLMeta::blitSource(autotile->getGLTypes());
 
+#ifndef NDEBUG
+			/* Fetching a source must never redirect the blit away
+			 * from the atlas (this used to corrupt every autotile
+			 * following a blank one, as well as the blank bitmap) */
+			GLint drawFBO = 0;
+			gl.GetIntegerv(GL_FRAMEBUFFER_BINDING, &drawFBO);
+			assert((GLuint) drawFBO == atlas.gl.fbo.gl);
+#endif
+
 			// if (atW <= autotileW && tiles.animated && !atlas.smallATs[atInd])
 			if (blitW <= autotileW && tiles.animated)
 			{
@@ -760,10 +904,10 @@ struct TilemapPrivate
 		// }
 	}
 
-	void handleTile(int x, int y, int z)
+	/* 'x' and 'y' are map coordinates */
+	void handleTile(int x, int y, int z, TileRow &row)
 	{
-		int tileInd =
-			tableGetWrapped(*mapData, x + viewpPos.x, y + viewpPos.y, z);
+		int tileInd = tableGetWrapped(*mapData, x, y, z);
 
 		/* Check for empty space */
 		if (tileInd < 48)
@@ -775,25 +919,18 @@ struct TilemapPrivate
 		if (prio == -1)
 			return;
 
-		SVVector *targetArray;
+		/* Prio 0 tiles are all part of the same ground layer,
+		 * the rest is sorted into zlayers when assembling slots */
+		SVVector *targetArray = &row.vert[prio];
 
-		/* Prio 0 tiles are all part of the same ground layer */
-		if (prio == 0)
-		{
-			targetArray = &groundVert;
-		}
-		else
-		{
-			int layerInd = y + prio;
-			if ((size_t)layerInd >= zlayersMax)
-				return;
-			targetArray = &zlayerVert[layerInd];
-		}
+		/* Position relative to cache anchor */
+		int ax = x - cacheOrigin.x;
+		int ay = y - cacheOrigin.y;
 
 		/* Check for autotile */
 		if (tileInd < 48*8)
 		{
-			handleAutotile(x, y, tileInd, targetArray);
+			handleAutotile(ax, ay, tileInd, targetArray);
 			return;
 		}
 
@@ -805,7 +942,7 @@ struct TilemapPrivate
 		// !! Not sure why it was like this, but adjusting to fix zoom scaling issues...
 		FloatRect texRect((float) texPos.x, (float) texPos.y, TileAtlas::tileSize, TileAtlas::tileSize);
 		//FloatRect texRect((float) texPos.x+0.5f, (float) texPos.y+0.5f, 31, 31);
-		FloatRect posRect(x*TileAtlas::tileSize, y*TileAtlas::tileSize, TileAtlas::tileSize, TileAtlas::tileSize);
+		FloatRect posRect(ax*TileAtlas::tileSize, ay*TileAtlas::tileSize, TileAtlas::tileSize, TileAtlas::tileSize);
 
 		SVertex v[4];
 		Quad::setTexPosRect(v, texRect, posRect);
@@ -814,44 +951,160 @@ struct TilemapPrivate
 			targetArray->push_back(v[i]);
 	}
 
-	void clearQuadArrays()
+	/* Appends columns x0 to x1 of map row 'y' */
+	void buildRowColumns(TileRow &row, int y, int x0, int x1)
 	{
-		groundVert.clear();
+		const int zSize = mapData->zSize();
 
-		for (size_t i = 0; i < zlayersMax; ++i)
-			zlayerVert[i].clear();
+		for (int x = x0; x <= x1; ++x)
+		{
+			size_t before[tileTargetsN];
+
+			for (int t = 0; t < tileTargetsN; ++t)
+				before[t] = row.vert[t].size();
+
+			for (int z = 0; z < zSize; ++z)
+				handleTile(x, y, z, row);
+
+			for (int t = 0; t < tileTargetsN; ++t)
+				row.colQuads[t].push_back((row.vert[t].size() - before[t]) / 4);
+		}
 	}
 
-	void buildQuadArray()
+	/* Removes 'n' columns from the front or back of a row */
+	static void dropRowColumns(TileRow &row, int n, bool front)
 	{
-		clearQuadArrays();
+		for (int t = 0; t < tileTargetsN; ++t)
+		{
+			std::vector<uint16_t> &cols = row.colQuads[t];
+			SVVector &vert = row.vert[t];
+
+			size_t quads = 0;
 
-		int ox = viewpPos.x;
-		int oy = viewpPos.y;
+			if (front)
+			{
+				for (int i = 0; i < n; ++i)
+					quads += cols[i];
+
+				cols.erase(cols.begin(), cols.begin() + n);
+				vert.erase(vert.begin(), vert.begin() + quads*4);
+			}
+			else
+			{
+				for (int i = 0; i < n; ++i)
+					quads += cols[cols.size()-1-i];
+
+				cols.erase(cols.end() - n, cols.end());
+				vert.erase(vert.end() - quads*4, vert.end());
+			}
+		}
+	}
+
+	/* Prepends columns x0 to x1 to a row */
+	void prependRowColumns(TileRow &row, int x0, int x1)
+	{
+		TileRow front;
+		buildRowColumns(front, row.y, x0, x1);
+
+		for (int t = 0; t < tileTargetsN; ++t)
+		{
+			row.vert[t].insert(row.vert[t].begin(),
+			                   front.vert[t].begin(), front.vert[t].end());
+			row.colQuads[t].insert(row.colQuads[t].begin(),
+			                       front.colQuads[t].begin(), front.colQuads[t].end());
+		}
+	}
+
+	/* Regenerates the column of map tile 'x' in a cached row */
+	void rebuildRowColumn(TileRow &row, int x)
+	{
+		const size_t col = x - cacheMin.x;
+
+		TileRow fresh;
+		buildRowColumns(fresh, row.y, x, x);
+
+		for (int t = 0; t < tileTargetsN; ++t)
+		{
+			std::vector<uint16_t> &cols = row.colQuads[t];
+			SVVector &vert = row.vert[t];
+
+			size_t offset = 0;
+
+			for (size_t i = 0; i < col; ++i)
+				offset += cols[i];
+
+			SVVector::iterator first = vert.begin() + offset*4;
+			first = vert.erase(first, first + cols[col]*4);
+			vert.insert(first, fresh.vert[t].begin(), fresh.vert[t].end());
+
+			cols[col] = fresh.colQuads[t][0];
+		}
+	}
+
+	TileRow &cachedRow(int y)
+	{
+		return rows[wrap(y, cacheRowsN)];
+	}
+
+	TileSlot &groundSlot(int y)
+	{
+		return groundSlots[wrap(y, cacheRowsN)];
+	}
+
+	TileSlot &zlayerSlot(int layer)
+	{
+		return zlayerSlots[wrap(layer, (int) zlayersMax)];
+	}
+
+	/* Computes the map tiles covered by the map viewport.
+	 * Returns false if there are none */
+	bool calcCacheRect(Vec2i &min, Vec2i &max)
+	{
 		int mapW = mapData->xSize();
 		int mapH = mapData->ySize();
 
-		int minX = 0;
-		int minY = 0;
-		if (ox < 0)
-			minX = -ox;
-		if (oy < 0)
-			minY = -oy;
-
 		// There could be off-by-one issues in these couple sections.
-		int maxX = viewpW;
-		int maxY = viewpH;
-		if (ox + maxX >= mapW)
-			maxX = mapW - ox - 1;
-		if (oy + maxY >= mapH)
-			maxY = mapH - oy - 1;
-
-		if ((minX > maxX) || (minY > maxY))
+		min = Vec2i(std::max(viewpPos.x, 0), std::max(viewpPos.y, 0));
+		max = Vec2i(std::min(viewpPos.x + viewpW, mapW - 1),
+		            std::min(viewpPos.y + viewpH, mapH - 1));
+
+		return (min.x <= max.x) && (min.y <= max.y);
+	}
+
+	bool rowCached(int y) const
+	{
+		return cacheValid && y >= cacheMin.y && y <= cacheMax.y;
+	}
+
+	/* Collects the vertices of ground row 'y' */
+	const SVVector *groundContent(int y)
+	{
+		if (!rowCached(y))
+			return 0;
+
+		return &cachedRow(y).vert[0];
+	}
+
+	/* Collects the vertices of (absolute) zlayer 'layer'. Each tile
+	 * in row n with priority m ends up in layer n+m */
+	void zlayerContent(int layer, SVVector &out)
+	{
+		out.clear();
+
+		/* Layers outside the map viewport stay empty */
+		if (layer - viewpPos.y < 0 || layer - viewpPos.y >= (int) zlayersMax)
 			return;
-		for (int x = minX; x <= maxX; ++x)
-			for (int y = minY; y <= maxY; ++y)
-				for (int z = 0; z < mapData->zSize(); ++z)
-					handleTile(x, y, z);
+
+		for (int prio = 1; prio < tileTargetsN; ++prio)
+		{
+			int y = layer - prio;
+
+			if (!rowCached(y))
+				continue;
+
+			const SVVector &vert = cachedRow(y).vert[prio];
+			out.insert(out.end(), vert.begin(), vert.end());
+		}
 	}
 
 	static size_t quadDataSize(size_t quadCount)
@@ -859,43 +1112,310 @@ struct TilemapPrivate
 		return quadCount * sizeof(SVertex) * 4;
 	}
 
-	size_t zlayerSize(size_t index)
+	/* Writes 'content' into 'slot', padding the remaining capacity
+	 * with degenerate quads. The tile VBO must be bound */
+	void writeSlot(TileSlot &slot, const SVVector *content)
 	{
-		return zlayerBases[index+1] - zlayerBases[index];
+		size_t count = content ? content->size() / 4 : 0;
+
+		slotVert.assign(slot.capacity * 4, SVertex());
+
+		if (count > 0)
+			std::copy(content->begin(), content->end(), slotVert.begin());
+
+		slot.count = count;
+
+		if (slot.capacity > 0)
+			VBO::uploadSubData(quadDataSize(slot.base),
+			                   quadDataSize(slot.capacity), dataPtr(slotVert));
 	}
 
-	void uploadBuffers()
+	/* Gives every slot its current content plus some spare capacity
+	 * and re-uploads the whole VBO */
+	void layoutBuffers()
 	{
-		/* Calculate total quad count */
-		size_t groundQuadCount = groundVert.size() / 4;
-		size_t quadCount = groundQuadCount;
+		SVVector zlayerVert[zlayersMax];
+		size_t counts[cacheRowsN + zlayersMax];
+		size_t total = 0;
+
+		for (int i = 0; i < cacheRowsN; ++i)
+		{
+			TileSlot &slot = groundSlot(viewpPos.y + i);
+			slot.key = viewpPos.y + i;
+
+			const SVVector *content = groundContent(slot.key);
+			counts[i] = content ? content->size() / 4 : 0;
+			total += counts[i];
+		}
 
 		for (size_t i = 0; i < zlayersMax; ++i)
 		{
-			zlayerBases[i] = quadCount;
-			quadCount += zlayerVert[i].size() / 4;
+			int layer = viewpPos.y + i;
+			zlayerContent(layer, zlayerVert[i]);
+
+			counts[cacheRowsN + i] = zlayerVert[i].size() / 4;
+			total += counts[cacheRowsN + i];
 		}
 
-		zlayerBases[zlayersMax] = quadCount;
+		/* Leave room for a few more tiles per slot, unless
+		 * that would exceed what the global IBO can index */
+		const size_t slotsN = cacheRowsN + zlayersMax;
+		size_t spareTotal = 0;
+
+		for (size_t i = 0; i < slotsN; ++i)
+			spareTotal += counts[i] / 4 + 4;
+
+		const bool spare = (total + spareTotal) * 6 < INDEX_T_MAX;
+
+		size_t base = 0;
+
+		for (size_t i = 0; i < slotsN; ++i)
+		{
+			TileSlot &slot = (i < (size_t) cacheRowsN)
+			        ? groundSlots[i]
+			        : zlayerSlots[i - cacheRowsN];
+
+			/* Slots are laid out in ring order, find out
+			 * which map row / layer landed in this one */
+			size_t ci;
+
+			if (i < (size_t) cacheRowsN)
+				ci = wrap((int) i - viewpPos.y, cacheRowsN);
+			else
+				ci = cacheRowsN + wrap((int) (i - cacheRowsN) - viewpPos.y, (int) zlayersMax);
+
+			slot.base = base;
+			slot.capacity = counts[ci] + (spare ? counts[ci] / 4 + 4 : 0);
+			base += slot.capacity;
+		}
 
 		VBO::bind(tiles.vbo);
-		VBO::allocEmpty(quadDataSize(quadCount));
+		VBO::allocEmpty(quadDataSize(base), GL_DYNAMIC_DRAW);
+
+		groundQuads = 0;
 
-		VBO::uploadSubData(0, quadDataSize(groundQuadCount), dataPtr(groundVert));
+		for (int i = 0; i < cacheRowsN; ++i)
+		{
+			TileSlot &slot = groundSlot(viewpPos.y + i);
+			writeSlot(slot, groundContent(slot.key));
+			groundQuads += slot.count;
+		}
 
 		for (size_t i = 0; i < zlayersMax; ++i)
 		{
-			if (zlayerVert[i].empty())
+			TileSlot &slot = zlayerSlot(viewpPos.y + i);
+			slot.key = viewpPos.y + i;
+			writeSlot(slot, &zlayerVert[i]);
+		}
+
+		VBO::unbind();
+
+		/* Ensure global IBO size */
+		shState->ensureQuadIBO(base);
+	}
+
+	/* Regenerates the entire tile cache */
+	void rebuildBuffers()
+	{
+		for (int i = 0; i < cacheRowsN; ++i)
+			rows[i].clear();
+
+		cacheOrigin = viewpPos;
+		cacheValid = calcCacheRect(cacheMin, cacheMax);
+
+		if (cacheValid)
+		{
+			for (int y = cacheMin.y; y <= cacheMax.y; ++y)
+			{
+				TileRow &row = cachedRow(y);
+				row.y = y;
+				buildRowColumns(row, y, cacheMin.x, cacheMax.x);
+			}
+		}
+
+		layoutBuffers();
+	}
+
+	/* Brings the tile cache up to date after the map viewport
+	 * moved, only generating the newly exposed rows/columns */
+	void scrollBuffers()
+	{
+		Vec2i min, max;
+
+		if (!cacheValid || !calcCacheRect(min, max) ||
+		    min.x > cacheMax.x || max.x < cacheMin.x ||
+		    min.y > cacheMax.y || max.y < cacheMin.y)
+		{
+			rebuildBuffers();
+			return;
+		}
+
+		bool rowChanged[cacheRowsN] = { false };
+
+		/* Evict rows that scrolled out */
+		for (int y = cacheMin.y; y <= cacheMax.y; ++y)
+		{
+			if (y >= min.y && y <= max.y)
+				continue;
+
+			cachedRow(y).clear();
+			rowChanged[wrap(y, cacheRowsN)] = true;
+		}
+
+		/* Shift columns of the rows we keep */
+		const bool colsChanged = (min.x != cacheMin.x || max.x != cacheMax.x);
+
+		if (colsChanged)
+		{
+			for (int y = std::max(min.y, cacheMin.y); y <= std::min(max.y, cacheMax.y); ++y)
+			{
+				TileRow &row = cachedRow(y);
+
+				if (min.x > cacheMin.x)
+					dropRowColumns(row, min.x - cacheMin.x, true);
+				if (max.x < cacheMax.x)
+					dropRowColumns(row, cacheMax.x - max.x, false);
+				if (min.x < cacheMin.x)
+					prependRowColumns(row, min.x, cacheMin.x - 1);
+				if (max.x > cacheMax.x)
+					buildRowColumns(row, y, cacheMax.x + 1, max.x);
+			}
+		}
+
+		/* Generate rows that scrolled in */
+		for (int y = min.y; y <= max.y; ++y)
+		{
+			if (y >= cacheMin.y && y <= cacheMax.y)
+				continue;
+
+			TileRow &row = cachedRow(y);
+			row.clear();
+			row.y = y;
+			buildRowColumns(row, y, min.x, max.x);
+			rowChanged[wrap(y, cacheRowsN)] = true;
+		}
+
+		cacheMin = min;
+		cacheMax = max;
+
+		/* Every row changed, so lay out all slots from scratch */
+		if (colsChanged)
+		{
+			layoutBuffers();
+			return;
+		}
+
+		updateSlots(rowChanged);
+	}
+
+	/* Brings the cached columns of the cells set since the
+	 * last frame up to date */
+	void patchCells()
+	{
+		if (dirtyCells.empty())
+			return;
+
+		bool rowChanged[cacheRowsN] = { false };
+
+		for (size_t i = 0; i < dirtyCells.size(); ++i)
+		{
+			const Vec2i &cell = dirtyCells[i];
+
+			/* May have scrolled out since */
+			if (!rowCached(cell.y) || cell.x < cacheMin.x || cell.x > cacheMax.x)
 				continue;
 
-			VBO::uploadSubData(quadDataSize(zlayerBases[i]),
-			                   quadDataSize(zlayerSize(i)), dataPtr(zlayerVert[i]));
+			rebuildRowColumn(cachedRow(cell.y), cell.x);
+			rowChanged[wrap(cell.y, cacheRowsN)] = true;
+		}
+
+		dirtyCells.clear();
+
+		updateSlots(rowChanged);
+	}
+
+	/* Re-uploads the slots that moved to another row / layer,
+	 * or whose rows are marked in 'rowChanged' */
+	void updateSlots(const bool rowChanged[cacheRowsN])
+	{
+		/* Find the slots whose content changed */
+		std::vector<TileSlot*> dirtyGround;
+		std::vector<TileSlot*> dirtyZLayers;
+
+		for (int i = 0; i < cacheRowsN; ++i)
+		{
+			int y = viewpPos.y + i;
+			TileSlot &slot = groundSlot(y);
+
+			if (slot.key != y || rowChanged[wrap(y, cacheRowsN)])
+			{
+				slot.key = y;
+				dirtyGround.push_back(&slot);
+			}
+		}
+
+		for (size_t i = 0; i < zlayersMax; ++i)
+		{
+			int layer = viewpPos.y + i;
+			TileSlot &slot = zlayerSlot(layer);
+			bool dirty = (slot.key != layer);
+
+			for (int prio = 1; prio < tileTargetsN && !dirty; ++prio)
+				dirty = rowChanged[wrap(layer - prio, cacheRowsN)];
+
+			if (dirty)
+			{
+				slot.key = layer;
+				dirtyZLayers.push_back(&slot);
+			}
 		}
 
+		/* Lay out anew if any of them outgrew its slot */
+		SVVector zlayerVert[zlayersMax];
+
+		for (size_t i = 0; i < dirtyGround.size(); ++i)
+		{
+			const SVVector *content = groundContent(dirtyGround[i]->key);
+
+			if (content && content->size() / 4 > dirtyGround[i]->capacity)
+			{
+				layoutBuffers();
+				return;
+			}
+		}
+
+		for (size_t i = 0; i < dirtyZLayers.size(); ++i)
+		{
+			zlayerContent(dirtyZLayers[i]->key, zlayerVert[i]);
+
+			if (zlayerVert[i].size() / 4 > dirtyZLayers[i]->capacity)
+			{
+				layoutBuffers();
+				return;
+			}
+		}
+
+		VBO::bind(tiles.vbo);
+
+		for (size_t i = 0; i < dirtyGround.size(); ++i)
+		{
+			TileSlot &slot = *dirtyGround[i];
+
+			groundQuads -= slot.count;
+			writeSlot(slot, groundContent(slot.key));
+			groundQuads += slot.count;
+		}
+
+		for (size_t i = 0; i < dirtyZLayers.size(); ++i)
+			writeSlot(*dirtyZLayers[i], &zlayerVert[i]);
+
 		VBO::unbind();
+	}
 
-		/* Ensure global IBO size */
-		shState->ensureQuadIBO(quadCount);
+	/* Translation of the cached vertices to the screen */
+	Vec2i tileTranslation() const
+	{
+		return dispPos + (cacheOrigin - viewpPos) * TileAtlas::tileSize;
 	}
 
 	void bindShader(ShaderBase *&shaderVar)
@@ -954,7 +1474,7 @@ struct TilemapPrivate
 		std::vector<int> zlayerInd;
 
 		for (size_t i = 0; i < zlayersMax; ++i)
-			if (zlayerVert[i].size() > 0)
+			if (zlayerSlot(viewpPos.y + i).count > 0)
 				zlayerInd.push_back(i);
 
 		updateActiveElements(zlayerInd);
@@ -978,15 +1498,8 @@ struct TilemapPrivate
 		for (size_t i = 0; i < elem.activeLayers; ++i)
 			elem.zlayers[i]->initUpdateZ();
 
-		ZLayer *prev = elem.zlayers[0];
-		prev->finiUpdateZ(0);
-
-		for (size_t i = 1; i < elem.activeLayers; ++i)
-		{
-			ZLayer *layer = elem.zlayers[i];
-			layer->finiUpdateZ(prev);
-			prev = layer;
-		}
+		for (size_t i = 0; i < elem.activeLayers; ++i)
+			elem.zlayers[i]->finiUpdateZ();
 	}
 
 	/* When there are two or more zlayers with no other
@@ -1021,7 +1534,14 @@ struct TilemapPrivate
 				if (iter != &layer->link)
 					break;
 
-				vboBatchCount += layer->vboCount;
+				/* Zlayer slots wrap around at the end of the
+				 * buffer; a batch can't span that boundary.
+				 * Padding of slots in between is degenerate */
+				if (layer->vboOffset < batchHead->vboOffset)
+					break;
+
+				vboBatchCount = (layer->vboOffset - batchHead->vboOffset) / sizeof(index_t)
+				              + layer->vboCount;
 				layer->batchedFlag = true;
 			}
 
@@ -1038,7 +1558,7 @@ struct TilemapPrivate
 		if (mvpPos != viewpPos)
 		{
 			viewpPos = mvpPos;
-			buffersDirty = true;
+			buffersScrolled = true;
 			updateFlashMapViewport();
 		}
 
@@ -1076,10 +1596,20 @@ struct TilemapPrivate
 
 		if (buffersDirty)
 		{
-			buildQuadArray();
-			uploadBuffers();
+			rebuildBuffers();
 			updateSceneElements();
 			buffersDirty = false;
+			buffersScrolled = false;
+			dirtyCells.clear();
+		}
+		else if (buffersScrolled || !dirtyCells.empty())
+		{
+			if (buffersScrolled)
+				scrollBuffers();
+
+			patchCells();
+			updateSceneElements();
+			buffersScrolled = false;
 		}
 
 		flashMap.prepare();
@@ -1106,12 +1636,13 @@ GroundLayer::GroundLayer(TilemapPrivate *p, Viewport *viewport)
 
 void GroundLayer::updateVboCount()
 {
-	vboCount = p->zlayerBases[0] * 6;
+	/* Drawn in one go, including slot padding */
+	vboCount = p->zlayerSlots[0].base * 6;
 }
 
 void GroundLayer::draw()
 {
-	if (p->groundVert.size() == 0)
+	if (p->groundQuads == 0)
 		return;
 
 	// Check this -- removed with tilemap frag removal
@@ -1125,7 +1656,7 @@ void GroundLayer::draw()
 
 	GLMeta::vaoBind(p->tiles.vao);
 
-	shader->setTranslation(p->dispPos);
+	shader->setTranslation(p->tileTranslation());
 	drawInt();
 
 	GLMeta::vaoUnbind(p->tiles.vao);
@@ -1159,8 +1690,10 @@ void ZLayer::setIndex(int value)
 	z = calculateZ(p, index);
 	scene->reinsert(*this);
 
-	vboOffset = p->zlayerBases[index] * sizeof(index_t) * 6;
-	vboCount = p->zlayerSize(index) * 6;
+	const TileSlot &slot = p->zlayerSlot(p->viewpPos.y + index);
+
+	vboOffset = slot.base * sizeof(index_t) * 6;
+	vboCount = slot.count * 6;
 }
 
 void ZLayer::draw()
@@ -1175,7 +1708,7 @@ void ZLayer::draw()
 
 	GLMeta::vaoBind(p->tiles.vao);
 
-	shader->setTranslation(p->dispPos);
+	shader->setTranslation(p->tileTranslation());
 	drawInt();
 
 	GLMeta::vaoUnbind(p->tiles.vao);
@@ -1196,14 +1729,10 @@ void ZLayer::initUpdateZ()
 	unlink();
 }
 
-void ZLayer::finiUpdateZ(ZLayer *prev)
+void ZLayer::finiUpdateZ()
 {
 	z = calculateZ(p, index);
-
-	if (prev)
-		scene->insertAfter(*this, *prev);
-	else
-		scene->insert(*this);
+	scene->insert(*this);
 }
 
 void Tilemap::Autotiles::set(int i, Bitmap *bitmap)
@@ -1333,6 +1862,9 @@ void Tilemap::setMapData(Table *value)
 	p->mapDataCon.disconnect();
 	p->mapDataCon = value->modified.connect
 	        (&TilemapPrivate::invalidateBuffers, p);
+	p->mapDataCellCon.disconnect();
+	p->mapDataCellCon = value->cellModified.connect
+	        (&TilemapPrivate::onMapCellModified, p);
 }
 
 void Tilemap::setFlashData(Table *value)
@@ -1358,6 +1890,9 @@ void Tilemap::setPriorities(Table *value)
 	p->prioritiesCon.disconnect();
 	p->prioritiesCon = value->modified.connect
 	        (&TilemapPrivate::invalidateBuffers, p);
+	p->prioritiesCellCon.disconnect();
+	p->prioritiesCellCon = value->cellModified.connect
+	        (&TilemapPrivate::onPrioritiesCellModified, p);
 }
 
 void Tilemap::setVisible(bool value)
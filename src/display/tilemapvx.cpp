@@ -88,7 +88,9 @@ struct TilemapVXPrivate : public ViewportElement, TileAtlasVX::Reader
 	bool mapViewportDirty;
 
 	sigslot::connection mapDataCon;
+	sigslot::connection mapDataCellCon;
 	sigslot::connection flagsCon;
+	sigslot::connection flagsCellCon;
 
 	sigslot::connection prepareCon;
 	sigslot::connection bmChangedCons[BM_COUNT];
@@ -109,6 +111,8 @@ struct TilemapVXPrivate : public ViewportElement, TileAtlasVX::Reader
 			p->drawFlashLayer();
 		}
 
+		Profiler::Zone profileZone() const { return Profiler::Tilemaps; }
+
 		ABOUT_TO_ACCESS_NOOP
 	};
 
@@ -155,7 +159,9 @@ struct TilemapVXPrivate : public ViewportElement, TileAtlasVX::Reader
 		prepareCon.disconnect();
 
 		mapDataCon.disconnect();
+		mapDataCellCon.disconnect();
 		flagsCon.disconnect();
+		flagsCellCon.disconnect();
 
 		for (size_t i = 0; i < BM_COUNT; ++i)
 		{
@@ -174,6 +180,23 @@ struct TilemapVXPrivate : public ViewportElement, TileAtlasVX::Reader
 		buffersDirty = true;
 	}
 
+	/* The buffers only hold the map viewport, which is small
+	 * enough to simply be read again. The quads of its cells
+	 * are ordered by layer (and legs of table tiles overlap
+	 * the cell below), so patching one cell in place wouldn't
+	 * save much over that */
+	void onMapCellModified(int x, int y, int)
+	{
+		if (viewportShowsTile(mapViewp, *mapData, x, y))
+			buffersDirty = true;
+	}
+
+	/* A flag affects every cell with that tile */
+	void onFlagsCellModified(int, int, int)
+	{
+		buffersDirty = true;
+	}
+
 	void rebuildAtlas()
 	{
 		TileAtlasVX::build(atlas, bitmaps);
@@ -283,6 +306,8 @@ struct TilemapVXPrivate : public ViewportElement, TileAtlasVX::Reader
 		drawFlashLayer();
 	}
 
+	Profiler::Zone profileZone() const { return Profiler::Tilemaps; }
+
 	void drawGround()
 	{
 		if (groundQuads == 0)
@@ -483,6 +508,9 @@ void TilemapVX::setMapData(Table *value)
 	p->mapDataCon.disconnect();
 	p->mapDataCon = value->modified.connect
 		(&TilemapVXPrivate::invalidateBuffers, p);
+	p->mapDataCellCon.disconnect();
+	p->mapDataCellCon = value->cellModified.connect
+		(&TilemapVXPrivate::onMapCellModified, p);
 }
 
 void TilemapVX::setFlashData(Table *value)
@@ -505,6 +533,9 @@ void TilemapVX::setFlags(Table *value)
 	p->flagsCon.disconnect();
 	p->flagsCon = value->modified.connect
 		(&TilemapVXPrivate::invalidateBuffers, p);
+	p->flagsCellCon.disconnect();
+	p->flagsCellCon = value->cellModified.connect
+		(&TilemapVXPrivate::onFlagsCellModified, p);
 }
 
 void TilemapVX::setVisible(bool value)
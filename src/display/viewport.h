@@ -53,6 +53,7 @@ private:
 
 	void composite();
 	void draw();
+	Profiler::Zone profileZone() const { return Profiler::ViewportComposite; }
 	void onGeometryChange(const Geometry &);
 	bool isEffectiveViewport(Rect *&, Color *&, Tone *&) const;
 
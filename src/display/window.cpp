@@ -220,6 +220,8 @@ struct WindowPrivate
 			p->drawControls();
 		}
 
+		Profiler::Zone profileZone() const { return Profiler::Windows; }
+
 		void release()
 		{
 			unlink();
@@ -72,6 +72,7 @@ private:
 	WindowVXPrivate *p;
 
 	void draw();
+	Profiler::Zone profileZone() const { return Profiler::Windows; }
 	void onGeometryChange(const Scene::Geometry &);
 
 	void releaseResources();
@@ -53,9 +53,14 @@ void Table::set(int16_t value, int x, int y, int z)
 		return;
 	}
 
-	data[xs*ys*z + xs*y + x] = value;
+	int16_t &cell = data[xs*ys*z + xs*y + x];
 
-	modified();
+	if (cell == value)
+		return;
+
+	cell = value;
+
+	cellModified(x, y, z);
 }
 
 void Table::resize(int x, int y, int z)
@@ -76,7 +81,7 @@ void Table::resize(int x, int y, int z)
 	ys = y;
 	zs = z;
 
-	return;
+	modified();
 }
 
 void Table::resize(int x, int y)
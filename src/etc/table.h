@@ -62,7 +62,12 @@ public:
 		return data[xs*ys*z + xs*y + x];
 	}
 
-    sigslot::signal<> modified;
+	/* Emitted when the dimensions changed */
+	sigslot::signal<> modified;
+
+	/* Emitted when the cell at x/y/z was set (instead of
+	 * 'modified'), so watchers can patch just that cell */
+	sigslot::signal<int, int, int> cellModified;
 
 private:
 	int xs, ys, zs;
@@ -393,6 +393,14 @@ void EventThread::process(RGSSThreadData &rtData)
                     break;
                 }
                 
+                /* Left to the game unless profiling was asked for */
+                if (event.key.keysym.scancode == SDL_SCANCODE_F3 &&
+                    (rtData.config.profilerOverlay || !rtData.config.profilerTrace.empty()))
+                {
+                    rtData.rqProfilerOverlay.set();
+                    break;
+                }
+                
                 if (event.key.keysym.scancode == SDL_SCANCODE_F12)
                 {
                     if (!rtData.config.enableReset)
@@ -243,6 +243,9 @@ struct RGSSThreadData
 
 	/* Set when F12 is released */
 	AtomicFlag rqResetFinish;
+
+	/* Set when F3 is pressed */
+	AtomicFlag rqProfilerOverlay;
     
     // Set when window is being adjusted (resize, reposition)
     AtomicFlag rqWindowAdjust;
@@ -259,6 +262,10 @@ struct RGSSThreadData
 	ALCdevice *alcDev;
     
     SDL_GLContext glContext;
+    
+    /* Shares objects with glContext; only created
+     * when frames are presented from their own thread */
+    SDL_GLContext presentContext;
 
 	Vec2 sizeResoRatio;
 	Vec2i screenOffset;
@@ -285,7 +292,8 @@ struct RGSSThreadData
 	      refreshRate(refreshRate),
           scale(scalingFactor),
 	      config(newconf),
-          glContext(ctx)
+          glContext(ctx),
+          presentContext(0)
 	{}
 };
 
@@ -24,8 +24,11 @@
 #include "util/boost-hash.h"
 #include "util/debugwriter.h"
 #include "util/exception.h"
+#include "util/sdl-util.h"
 #include "util/util.h"
 #include "display/font.h"
+#include "display/graphics.h"
+#include "display/bitmapcache.h"
 #include "crypto/rgssad.h"
 
 #include "eventthread.h"
@@ -33,8 +36,12 @@
 
 #include <physfs.h>
 
+#include <SDL_mutex.h>
+
 #include <algorithm>
+#include <memory>
 #include <stack>
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
@@ -267,19 +274,143 @@ static void strTolower(std::string &str) {
 
 const Uint32 SDL_RWOPS_PHYSFS = SDL_RWOPS_UNKNOWN + 10;
 
-struct FileSystemPrivate {
+/* Bump when changing the index file layout */
+static const char indexMagic[8] = { 'M', 'K', 'X', 'P', 'P', 'A', 'T', 'H' };
+static const uint32_t indexVersion = 1;
+
+struct PathStamp {
+  std::string path;
+  int64_t modTime;
+  int64_t size;
+};
+
+/* Maps: file stem,
+ * To:   filenames openRead finds by it (see 'addStems()') */
+typedef BoostHash<std::string, std::vector<std::string>> StemIndex;
+
+struct PathCache {
   /* Maps: lower case full filepath,
    * To:   mixed case full filepath */
   BoostHash<std::string, std::string> pathCache;
   /* Maps: lower case directory path,
    * To:   list of lower case filenames */
   BoostHash<std::string, std::vector<std::string>> fileLists;
+  /* Built from 'fileLists' (not stored in the index file);
+   * keys are lower case directory path + '/' + stem */
+  StemIndex stems;
+
+  /* The search path this was enumerated from */
+  std::string key;
+
+  /* Every mounted archive and native directory the cache was
+   * built from. As long as none of their modification times
+   * changed, neither did the enumerated directory contents */
+  std::vector<PathStamp> stamps;
+};
+
+struct FileSystemPrivate {
+  /* Only ever replaced as a whole through 'setCache()', as
+   * the background validation may swap in a rebuilt one
+   * while other threads are still reading the old one */
+  std::shared_ptr<const PathCache> cache;
 
   /* This is for compatibility with games that take Windows'
    * case insensitivity for granted */
   bool havePathCache;
+
+  std::string indexPath;
+  /* Search path at the time the cache was created; only
+   * caches built for it are worth writing to the index */
+  std::string indexKey;
+
+  /* Guards 'generation' and writing the index file */
+  SDL_mutex *indexMutex;
+  /* Bumped by every synchronous rebuild, so a background
+   * rebuild started earlier doesn't overwrite its result */
+  unsigned int generation;
+  unsigned int validateGeneration;
+
+  SDL_Thread *validateThread;
+  AtomicFlag validateQuit;
+
+  /* Without the path cache: maps directory paths to
+   * stem indices of their contents, built on first use */
+  BoostHash<std::string, StemIndex> dirStems;
+  SDL_mutex *dirStemsMutex;
+
+  std::shared_ptr<const PathCache> getCache() const {
+    return std::atomic_load(&cache);
+  }
+
+  void setCache(const std::shared_ptr<const PathCache> &value) {
+    std::atomic_store(&cache, value);
+  }
+
+  void validate();
+
+  bool stemCandidates(const char *dir, const char *stem,
+                      std::vector<std::string> &out, bool rebuild);
+
+  void clearDirStems() {
+    SDL_LockMutex(dirStemsMutex);
+    dirStems.clear();
+    SDL_UnlockMutex(dirStemsMutex);
+  }
 };
 
+/* openRead finds "a.b.png" when asked for "a", "a.b" or "a.b.png",
+ * so it is indexed under all of them. Lists keep enumeration order */
+static void addStems(StemIndex &index, const std::string &prefix,
+                     const std::string &filename) {
+  for (size_t dot = filename.find('.'); dot != std::string::npos;
+       dot = filename.find('.', dot + 1))
+    index[prefix + filename.substr(0, dot)].push_back(filename);
+
+  index[prefix + filename].push_back(filename);
+}
+
+static void indexStems(PathCache &cache) {
+  BoostHash<std::string, std::vector<std::string>>::const_iterator iter;
+
+  for (iter = cache.fileLists.cbegin(); iter != cache.fileLists.cend();
+       ++iter) {
+    const std::string prefix = iter->first + '/';
+    const std::vector<std::string> &list = iter->second;
+
+    for (size_t i = 0; i < list.size(); ++i)
+      addStems(cache.stems, prefix, list[i]);
+  }
+}
+
+static PHYSFS_EnumerateCallbackResult
+dirStemsEnumCB(void *d, const char *, const char *fname) {
+  addStems(*static_cast<StemIndex *>(d), std::string(), fname);
+
+  return PHYSFS_ENUM_OK;
+}
+
+/* Writes the entries of 'dir' that 'stem' may refer to into 'out'.
+ * Returns true if the directory was (re-)enumerated for this */
+bool FileSystemPrivate::stemCandidates(const char *dir, const char *stem,
+                                       std::vector<std::string> &out,
+                                       bool rebuild) {
+  SDL_LockMutex(dirStemsMutex);
+
+  bool fresh = rebuild || !dirStems.contains(dir);
+  StemIndex &index = dirStems[dir];
+
+  if (fresh) {
+    index.clear();
+    PHYSFS_enumerate(dir, dirStemsEnumCB, &index);
+  }
+
+  out = index.value(stem);
+
+  SDL_UnlockMutex(dirStemsMutex);
+
+  return fresh;
+}
+
 static void throwPhysfsError(const char *desc) {
   PHYSFS_ErrorCode ec = PHYSFS_getLastErrorCode();
   const char *englishStr;
@@ -294,7 +425,7 @@ static void throwPhysfsError(const char *desc) {
   throw Exception(Exception::PHYSFSError, "%s: %s", desc, englishStr);
 }
 
-FileSystem::FileSystem(const char *argv0, bool allowSymlinks) {
+FileSystem::FileSystem(const char *argv0, bool allowSymlinks, bool mapArchives) {
   if (PHYSFS_init(argv0) == 0)
     throwPhysfsError("Error initializing PhysFS");
 
@@ -309,20 +440,46 @@ FileSystem::FileSystem(const char *argv0, bool allowSymlinks) {
   if (er == 0)
     throwPhysfsError("Error registering PhysFS RGSS archiver");
 
+  RGSS_setMapArchives(mapArchives);
+
   p = new FileSystemPrivate;
   p->havePathCache = false;
+  p->indexMutex = SDL_CreateMutex();
+  p->generation = 0;
+  p->validateGeneration = 0;
+  p->validateThread = 0;
+  p->dirStemsMutex = SDL_CreateMutex();
 
   if (allowSymlinks)
     PHYSFS_permitSymbolicLinks(1);
 }
 
 FileSystem::~FileSystem() {
+  if (p->validateThread) {
+    p->validateQuit.set();
+    SDL_WaitThread(p->validateThread, 0);
+  }
+
+  SDL_DestroyMutex(p->indexMutex);
+  SDL_DestroyMutex(p->dirStemsMutex);
   delete p;
 
   if (PHYSFS_deinit() == 0)
     Debug() << "PhyFS failed to deinit.";
 }
 
+/* Cached images are keyed by path, which may
+ * resolve to another file after remounting */
+static void clearBitmapCache() {
+    /* Still mounting the initial paths */
+    if (!shState)
+        return;
+    
+    GFX_LOCK;
+    shState->bitmapCache().clear();
+    GFX_UNLOCK;
+}
+
 void FileSystem::addPath(const char *path, const char *mountpoint, bool reload) {
   /* Try the normal mount first */
     int state = PHYSFS_mount(path, mountpoint, 1);
@@ -339,7 +496,10 @@ void FileSystem::addPath(const char *path, const char *mountpoint, bool reload)
         throw Exception(Exception::PHYSFSError, "Failed to mount %s (%s)", path, PHYSFS_getErrorByCode(err));
     }
     
+    p->clearDirStems();
+    
     if (reload) reloadPathCache();
+    else clearBitmapCache();
 }
 
 void FileSystem::removePath(const char *path, bool reload) {
@@ -349,19 +509,29 @@ void FileSystem::removePath(const char *path, bool reload) {
         throw Exception(Exception::PHYSFSError, "Failed to unmount %s (%s)", path, PHYSFS_getErrorByCode(err));
     }
     
+    p->clearDirStems();
+    
     if (reload) reloadPathCache();
+    else clearBitmapCache();
 }
 
 struct CacheEnumData {
-  FileSystemPrivate *p;
+  PathCache &cache;
   std::stack<std::vector<std::string> *> fileLists;
 
+  /* Mixed case paths of all enumerated directories */
+  std::vector<std::string> dirs;
+
+  /* Set to abort a background enumeration */
+  const AtomicFlag *quit;
+
 #ifdef __APPLE__
   iconv_t nfd2nfc;
   char buf[512];
 #endif
 
-  CacheEnumData(FileSystemPrivate *p) : p(p) {
+  CacheEnumData(PathCache &cache, const AtomicFlag *quit)
+      : cache(cache), quit(quit) {
 #ifdef __APPLE__
     nfd2nfc = iconv_open("utf-8", "utf-8-mac");
 #endif
@@ -399,6 +569,9 @@ static PHYSFS_EnumerateCallbackResult cacheEnumCB(void *d, const char *origdir,
   CacheEnumData &data = *static_cast<CacheEnumData *>(d);
   char fullPath[512];
 
+  if (data.quit && *data.quit)
+    return PHYSFS_ENUM_STOP;
+
   if (!*origdir)
     snprintf(fullPath, sizeof(fullPath), "%s", fname);
   else
@@ -416,7 +589,8 @@ static PHYSFS_EnumerateCallbackResult cacheEnumCB(void *d, const char *origdir,
 
   if (stat.filetype == PHYSFS_FILETYPE_DIRECTORY) {
     /* Create a new list for this directory */
-    std::vector<std::string> &list = data.p->fileLists[lowerCase];
+    std::vector<std::string> &list = data.cache.fileLists[lowerCase];
+    data.dirs.push_back(mixedCase);
 
     /* Iterate over its contents */
     data.fileLists.push(&list);
@@ -432,26 +606,351 @@ static PHYSFS_EnumerateCallbackResult cacheEnumCB(void *d, const char *origdir,
     list.push_back(lowerFilename);
 
     /* Add the lower -> mixed mapping of the file's full path */
-    data.p->pathCache.insert(lowerCase, mixedCase);
+    data.cache.pathCache.insert(lowerCase, mixedCase);
   }
 
   return PHYSFS_ENUM_OK;
 }
 
-void FileSystem::createPathCache() {
-  CacheEnumData data(p);
-  data.fileLists.push(&p->fileLists[""]);
+static std::string searchPathKey() {
+  std::string key = mkxp_fs::getCurrentDirectory();
+  char **list = PHYSFS_getSearchPath();
+
+  for (char **i = list; *i; ++i) {
+    const char *mount = PHYSFS_getMountPoint(*i);
+
+    key += '\n';
+    key += *i;
+    key += '|';
+    key += mount ? mount : "";
+  }
+
+  PHYSFS_freeList(list);
+
+  return key;
+}
+
+static void stampSearchPath(PathCache &cache,
+                            const std::vector<std::string> &dirs) {
+  char **list = PHYSFS_getSearchPath();
+
+  for (char **i = list; *i; ++i) {
+    PathStamp stamp;
+    bool isDir;
+
+    if (!mkxp_fs::statPath(*i, stamp.modTime, stamp.size, isDir))
+      continue;
+
+    stamp.path = *i;
+    cache.stamps.push_back(stamp);
+
+    /* Archives are fully covered by their own stamp */
+    if (!isDir)
+      continue;
+
+    /* Mount points are reported as eg. "/" or "/Fonts/",
+     * enumerated paths are relative */
+    const char *mountPoint = PHYSFS_getMountPoint(*i);
+    std::string mount(mountPoint ? mountPoint : "");
+
+    if (!mount.empty() && mount[0] == '/')
+      mount.erase(0, 1);
+
+    /* A directory only gains entries by its modification
+     * time changing, including subdirectories appearing
+     * in this mount that only existed in others before */
+    for (size_t j = 0; j < dirs.size(); ++j) {
+      if (dirs[j].compare(0, mount.size(), mount) != 0)
+        continue;
+
+      std::string path = stamp.path + "/" + dirs[j].substr(mount.size());
+
+      if (mkxp_fs::statPath(path.c_str(), stamp.modTime, stamp.size, isDir) &&
+          isDir) {
+        PathStamp dirStamp = { path, stamp.modTime, stamp.size };
+        cache.stamps.push_back(dirStamp);
+      }
+    }
+  }
+
+  PHYSFS_freeList(list);
+}
+
+/* Returns false if the enumeration was aborted */
+static bool buildPathCache(PathCache &cache, const AtomicFlag *quit) {
+  CacheEnumData data(cache, quit);
+  cache.key = searchPathKey();
+
+  data.fileLists.push(&cache.fileLists[""]);
   PHYSFS_enumerate("", cacheEnumCB, &data);
 
+  if (quit && *quit)
+    return false;
+
+  stampSearchPath(cache, data.dirs);
+  indexStems(cache);
+
+  return true;
+}
+
+static bool stampsValid(const PathCache &cache) {
+  for (size_t i = 0; i < cache.stamps.size(); ++i) {
+    const PathStamp &stamp = cache.stamps[i];
+    int64_t modTime, size;
+    bool isDir;
+
+    if (!mkxp_fs::statPath(stamp.path.c_str(), modTime, size, isDir))
+      return false;
+
+    if (modTime != stamp.modTime || size != stamp.size)
+      return false;
+  }
+
+  return true;
+}
+
+static bool readU32(FILE *f, uint32_t &value) {
+  return fread(&value, sizeof(value), 1, f) == 1;
+}
+
+static bool readI64(FILE *f, int64_t &value) {
+  return fread(&value, sizeof(value), 1, f) == 1;
+}
+
+static bool readString(FILE *f, std::string &str) {
+  uint32_t len;
+
+  if (!readU32(f, len) || len > 0x100000)
+    return false;
+
+  str.resize(len);
+
+  return len == 0 || fread(&str[0], 1, len, f) == len;
+}
+
+static bool writeU32(FILE *f, uint32_t value) {
+  return fwrite(&value, sizeof(value), 1, f) == 1;
+}
+
+static bool writeString(FILE *f, const std::string &str) {
+  uint32_t len = str.size();
+
+  return writeU32(f, len) &&
+         (len == 0 || fwrite(str.c_str(), 1, len, f) == len);
+}
+
+static bool readIndexBody(FILE *f, PathCache &cache) {
+  uint32_t count;
+
+  if (!readU32(f, count))
+    return false;
+
+  cache.stamps.resize(count);
+
+  for (uint32_t i = 0; i < count; ++i) {
+    PathStamp &stamp = cache.stamps[i];
+
+    if (!readString(f, stamp.path) || !readI64(f, stamp.modTime) ||
+        !readI64(f, stamp.size))
+      return false;
+  }
+
+  if (!readU32(f, count))
+    return false;
+
+  for (uint32_t i = 0; i < count; ++i) {
+    std::string dir;
+    uint32_t fileCount;
+
+    if (!readString(f, dir) || !readU32(f, fileCount))
+      return false;
+
+    std::vector<std::string> &list = cache.fileLists[dir];
+    list.resize(fileCount);
+
+    for (uint32_t j = 0; j < fileCount; ++j)
+      if (!readString(f, list[j]))
+        return false;
+  }
+
+  if (!readU32(f, count))
+    return false;
+
+  for (uint32_t i = 0; i < count; ++i) {
+    std::string lower, mixed;
+
+    if (!readString(f, lower) || !readString(f, mixed))
+      return false;
+
+    cache.pathCache.insert(lower, mixed);
+  }
+
+  return true;
+}
+
+/* Only succeeds if the index was written for 'key' */
+static bool readIndex(const std::string &path, const std::string &key,
+                      PathCache &cache) {
+  FILE *f = fopen(path.c_str(), "rb");
+
+  if (!f)
+    return false;
+
+  char magic[sizeof(indexMagic)];
+  uint32_t version;
+
+  bool ok = fread(magic, sizeof(magic), 1, f) == 1 &&
+            memcmp(magic, indexMagic, sizeof(magic)) == 0 &&
+            readU32(f, version) && version == indexVersion &&
+            readString(f, cache.key) && cache.key == key &&
+            readIndexBody(f, cache);
+
+  fclose(f);
+
+  if (ok)
+    indexStems(cache);
+
+  return ok;
+}
+
+static void writeIndex(const std::string &path, const PathCache &cache) {
+  FILE *f = fopen(path.c_str(), "wb");
+
+  if (!f) {
+    Debug() << "Failed to write path cache index" << path;
+    return;
+  }
+
+  bool ok = fwrite(indexMagic, sizeof(indexMagic), 1, f) == 1 &&
+            writeU32(f, indexVersion) && writeString(f, cache.key) &&
+            writeU32(f, cache.stamps.size());
+
+  for (size_t i = 0; ok && i < cache.stamps.size(); ++i) {
+    const PathStamp &stamp = cache.stamps[i];
+
+    ok = writeString(f, stamp.path) &&
+         fwrite(&stamp.modTime, sizeof(stamp.modTime), 1, f) == 1 &&
+         fwrite(&stamp.size, sizeof(stamp.size), 1, f) == 1;
+  }
+
+  uint32_t count = 0;
+  BoostHash<std::string, std::vector<std::string>>::const_iterator dirIter;
+
+  for (dirIter = cache.fileLists.cbegin(); dirIter != cache.fileLists.cend();
+       ++dirIter)
+    ++count;
+
+  ok = ok && writeU32(f, count);
+
+  for (dirIter = cache.fileLists.cbegin();
+       ok && dirIter != cache.fileLists.cend(); ++dirIter) {
+    const std::vector<std::string> &list = dirIter->second;
+    ok = writeString(f, dirIter->first) && writeU32(f, list.size());
+
+    for (size_t i = 0; ok && i < list.size(); ++i)
+      ok = writeString(f, list[i]);
+  }
+
+  count = 0;
+  BoostHash<std::string, std::string>::const_iterator pathIter;
+
+  for (pathIter = cache.pathCache.cbegin();
+       pathIter != cache.pathCache.cend(); ++pathIter)
+    ++count;
+
+  ok = ok && writeU32(f, count);
+
+  for (pathIter = cache.pathCache.cbegin();
+       ok && pathIter != cache.pathCache.cend(); ++pathIter)
+    ok = writeString(f, pathIter->first) && writeString(f, pathIter->second);
+
+  fclose(f);
+
+  if (!ok) {
+    Debug() << "Failed to write path cache index" << path;
+    remove(path.c_str());
+  }
+}
+
+void FileSystemPrivate::validate() {
+  std::shared_ptr<const PathCache> current = getCache();
+
+  if (stampsValid(*current))
+    return;
+
+  Debug() << "Path cache index is stale, rebuilding";
+
+  std::shared_ptr<PathCache> fresh(new PathCache);
+
+  if (!buildPathCache(*fresh, &validateQuit))
+    return;
+
+  SDL_LockMutex(indexMutex);
+
+  /* Don't replace the result of a rebuild
+   * that happened in the meantime */
+  if (generation == validateGeneration) {
+    setCache(fresh);
+
+    if (fresh->key == indexKey)
+      writeIndex(indexPath, *fresh);
+  }
+
+  SDL_UnlockMutex(indexMutex);
+}
+
+void FileSystem::createPathCache(const std::string &indexPath) {
+  p->indexPath = indexPath;
+  p->indexKey = searchPathKey();
+
+  std::shared_ptr<PathCache> cache(new PathCache);
+
+  if (!indexPath.empty() && readIndex(indexPath, p->indexKey, *cache)) {
+    p->setCache(cache);
+    p->havePathCache = true;
+
+    /* Use the index right away, and only re-enumerate
+     * once any of the stamped paths turns out changed */
+    p->validateGeneration = p->generation;
+    p->validateThread =
+        createSDLThread<FileSystemPrivate, &FileSystemPrivate::validate>(
+            p, "pathcache");
+
+    return;
+  }
+
+  /* Missing, unreadable, or written for a different search path */
+  cache.reset(new PathCache);
+
+  SDL_LockMutex(p->indexMutex);
+
+  buildPathCache(*cache, 0);
+  p->setCache(cache);
   p->havePathCache = true;
+
+  if (!indexPath.empty())
+    writeIndex(indexPath, *cache);
+
+  SDL_UnlockMutex(p->indexMutex);
 }
 
 void FileSystem::reloadPathCache() {
+    clearBitmapCache();
+    
     if (!p->havePathCache) return;
     
-    p->fileLists.clear();
-    p->pathCache.clear();
-    createPathCache();
+    std::shared_ptr<PathCache> cache(new PathCache);
+    
+    SDL_LockMutex(p->indexMutex);
+    
+    ++p->generation;
+    buildPathCache(*cache, 0);
+    p->setCache(cache);
+    
+    if (!p->indexPath.empty() && cache->key == p->indexKey)
+        writeIndex(p->indexPath, *cache);
+    
+    SDL_UnlockMutex(p->indexMutex);
 }
 
 struct FontSetsCBData {
@@ -532,7 +1031,7 @@ struct OpenReadEnumData {
 
   /* Optional hash to translate full filepaths
    * (used with path cache) */
-  BoostHash<std::string, std::string> *pathTrans;
+  const BoostHash<std::string, std::string> *pathTrans;
 
   /* Number of files we've attempted to read and parse */
   size_t matchCount;
@@ -544,7 +1043,7 @@ struct OpenReadEnumData {
 
   OpenReadEnumData(FileSystem::OpenHandler &handler, const char *filename,
                    size_t filenameN,
-                   BoostHash<std::string, std::string> *pathTrans)
+                   const BoostHash<std::string, std::string> *pathTrans)
       : handler(handler), filename(filename), filenameN(filenameN),
         pathTrans(pathTrans), matchCount(0), stopSearching(false),
         physfsError(0) {}
@@ -555,6 +1054,7 @@ openReadEnumCB(void *d, const char *dirpath, const char *filename) {
   OpenReadEnumData &data = *static_cast<OpenReadEnumData *>(d);
   char buffer[512];
   const char *fullPath;
+  std::string mixedPath;
 
   if (data.stopSearching)
     return PHYSFS_ENUM_STOP;
@@ -579,8 +1079,10 @@ openReadEnumCB(void *d, const char *dirpath, const char *filename) {
 
   /* If the path cache is active, translate from lower case
    * to mixed case path */
-  if (data.pathTrans)
-    fullPath = (*data.pathTrans)[fullPath].c_str();
+  if (data.pathTrans) {
+    mixedPath = data.pathTrans->value(fullPath);
+    fullPath = mixedPath.c_str();
+  }
 
   PHYSFS_File *phys = PHYSFS_openRead(fullPath);
 
@@ -604,13 +1106,43 @@ openReadEnumCB(void *d, const char *dirpath, const char *filename) {
   return PHYSFS_ENUM_OK;
 }
 
+/* Looks 'file' up in 'dir' by enumerating it through PhysFS,
+ * re-enumerating once if the remembered listing comes up empty */
+static void openReadEnumerated(FileSystemPrivate *p, OpenReadEnumData &data,
+                               const char *dir, const char *file) {
+  std::vector<std::string> fileList;
+  bool fresh = p->stemCandidates(dir, file, fileList, false);
+
+  for (size_t i = 0; i < fileList.size(); ++i)
+    openReadEnumCB(&data, dir, fileList[i].c_str());
+
+  /* The directory may have changed since it was indexed */
+  if (!fresh && (data.matchCount == 0 || data.physfsError)) {
+    data.matchCount = 0;
+    data.stopSearching = false;
+    data.physfsError = 0;
+
+    p->stemCandidates(dir, file, fileList, true);
+
+    for (size_t i = 0; i < fileList.size(); ++i)
+      openReadEnumCB(&data, dir, fileList[i].c_str());
+  }
+}
+
 void FileSystem::openRead(OpenHandler &handler, const char *filename) {
   std::string filename_nm = normalize(filename, false, false);
   char buffer[512];
   size_t len = strcpySafe(buffer, filename_nm.c_str(), sizeof(buffer), -1);
   char *delim;
 
+  /* Hold on to it, in case the background
+   * validation swaps in a rebuilt one */
+  std::shared_ptr<const PathCache> cache;
+
   if (p->havePathCache)
+    cache = p->getCache();
+
+  if (cache)
     for (size_t i = 0; i < len; ++i)
       buffer[i] = tolower(buffer[i]);
 
@@ -632,17 +1164,45 @@ void FileSystem::openRead(OpenHandler &handler, const char *filename) {
     dir = buffer;
   }
   OpenReadEnumData data(handler, file, len + buffer - delim - !root,
-                        p->havePathCache ? &p->pathCache : 0);
+                        cache ? &cache->pathCache : 0);
 
-  if (p->havePathCache) {
-    /* Get the list of files contained in this directory
-     * and manually iterate over them */
-    const std::vector<std::string> &fileList = p->fileLists[dir];
+  if (cache) {
+    /* Only look at the files this name can refer to. Don't
+     * insert missing keys, as this may run on decode worker
+     * threads */
+    StemIndex::const_iterator iter =
+        cache->stems.find(std::string(dir) + '/' + file);
 
-    for (size_t i = 0; i < fileList.size(); ++i)
-      openReadEnumCB(&data, dir, fileList[i].c_str());
+    if (iter != cache->stems.cend()) {
+      const std::vector<std::string> &fileList = iter->second;
+
+      for (size_t i = 0; i < fileList.size(); ++i)
+        openReadEnumCB(&data, dir, fileList[i].c_str());
+    }
+
+    /* The index may predate files added since it was written
+     * (and still be under validation), so don't trust a miss.
+     * Ask PhysFS directly, as if there were no path cache */
+    if (data.matchCount == 0 || data.physfsError) {
+      strcpySafe(buffer, filename_nm.c_str(), sizeof(buffer), -1);
+
+      file = buffer;
+      dir = "";
+
+      if (!root) {
+        *delim = '\0';
+        file = delim + 1;
+        dir = buffer;
+      }
+
+      OpenReadEnumData direct(handler, file, strlen(file), 0);
+      openReadEnumerated(p, direct, dir, file);
+
+      data.matchCount = direct.matchCount;
+      data.physfsError = direct.physfsError;
+    }
   } else {
-    PHYSFS_enumerate(dir, openReadEnumCB, &data);
+    openReadEnumerated(p, data, dir, file);
   }
 
   if (data.physfsError)
@@ -673,13 +1233,13 @@ bool FileSystem::exists(const char *filename) {
   return PHYSFS_exists(normalize(filename, false, false).c_str());
 }
 
-const char *FileSystem::desensitize(const char *filename) {
+std::string FileSystem::desensitize(const char *filename) {
   std::string fn_lower(filename);
     
   std::transform(fn_lower.begin(), fn_lower.end(), fn_lower.begin(), [](unsigned char c){
       return std::tolower(c);
   });
-  if (p->havePathCache && p->pathCache.contains(fn_lower))
-    return p->pathCache[fn_lower].c_str();
+  if (p->havePathCache)
+    return p->getCache()->pathCache.value(fn_lower, filename);
   return filename;
 }
@@ -36,15 +36,20 @@ class FileSystem
 {
 public:
 	FileSystem(const char *argv0,
-	           bool allowSymlinks);
+	           bool allowSymlinks,
+	           bool mapArchives);
 	~FileSystem();
 
 	void addPath(const char *path, const char *mountpoint = 0, bool reload = false);
     void removePath(const char *path, bool reload = false);
 
-	/* Call these after the last 'addPath()' */
-	void createPathCache();
+	/* Call these after the last 'addPath()'. If 'indexPath'
+	 * is given, the cache is restored from that file when it
+	 * was written for the same search path, and re-enumerated
+	 * in the background should it turn out to be outdated */
+	void createPathCache(const std::string &indexPath = std::string());
     
+    /* Always re-enumerates, and rewrites the index */
     void reloadPathCache();
 
 	/* Scans "Fonts/" and creates inventory of
@@ -77,7 +82,7 @@ public:
 	/* Does not perform extension supplementing */
 	bool exists(const char *filename);
 
-	const char *desensitize(const char *filename);
+	std::string desensitize(const char *filename);
 
 private:
 	FileSystemPrivate *p;
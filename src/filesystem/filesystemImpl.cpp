@@ -20,6 +20,7 @@ namespace fs = ghc::filesystem;
 #endif
 
 #include <fstream>
+#include <system_error>
 
 // https://stackoverflow.com/questions/12774207/fastest-way-to-check-if-a-file-exist-using-standard-c-c11-c
 bool filesystemImpl::fileExists(const char *path) {
@@ -27,6 +28,23 @@ bool filesystemImpl::fileExists(const char *path) {
     return (fs::exists(stdPath) && !fs::is_directory(stdPath));
 }
 
+bool filesystemImpl::statPath(const char *path, int64_t &modTime, int64_t &size, bool &isDir) {
+    fs::path stdPath(path);
+    std::error_code ec;
+
+    fs::file_status status = fs::status(stdPath, ec);
+    if (ec || !fs::exists(status))
+        return false;
+
+    isDir = fs::is_directory(status);
+    size = isDir ? 0 : (int64_t)fs::file_size(stdPath, ec);
+    if (ec)
+        return false;
+
+    modTime = (int64_t)fs::last_write_time(stdPath, ec).time_since_epoch().count();
+    return !ec;
+}
+
 
 // https://stackoverflow.com/questions/2912520/read-file-contents-into-a-string-in-c
 std::string filesystemImpl::contentsOfFileAsString(const char *path) {
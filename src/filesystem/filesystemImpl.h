@@ -8,12 +8,17 @@
 #ifndef filesystemImpl_h
 #define filesystemImpl_h
 
+#include <stdint.h>
 #include <string>
 #include <SDL_video.h>
 
 namespace filesystemImpl {
 bool fileExists(const char *path);
 
+/* Returns false if nothing exists at 'path'. 'size' is
+ * 0 for directories, 'modTime' only meant for comparison */
+bool statPath(const char *path, int64_t &modTime, int64_t &size, bool &isDir);
+
 std::string contentsOfFileAsString(const char *path);
 
 bool setCurrentDirectory(const char *path);
@@ -22,6 +22,17 @@ bool filesystemImpl::fileExists(const char *path) {
     return  [NSFileManager.defaultManager fileExistsAtPath:PATHTONS(path) isDirectory: &isDir] && !isDir;
 }
 
+bool filesystemImpl::statPath(const char *path, int64_t &modTime, int64_t &size, bool &isDir) {
+    NSDictionary *attrs = [NSFileManager.defaultManager attributesOfItemAtPath:PATHTONS(path) error:nil];
+    if (attrs == nil)
+        return false;
+    
+    isDir = [attrs.fileType isEqualToString:NSFileTypeDirectory];
+    size = isDir ? 0 : (int64_t)attrs.fileSize;
+    modTime = (int64_t)(attrs.fileModificationDate.timeIntervalSince1970 * 1000000);
+    return true;
+}
+
 
 
 std::string filesystemImpl::contentsOfFileAsString(const char *path) {
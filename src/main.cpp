@@ -116,6 +116,9 @@ static void printGLInfo() {
 static SDL_GLContext initGL(SDL_Window *win, Config &conf,
                             RGSSThreadData *threadData);
 
+static SDL_GLContext initPresentContext(SDL_Window *win, SDL_GLContext glCtx,
+                                        const Config &conf);
+
 int rgssThreadFun(void *userdata) {
   RGSSThreadData *threadData = static_cast<RGSSThreadData *>(userdata);
 
@@ -124,6 +127,10 @@ int rgssThreadFun(void *userdata) {
       initGL(threadData->window, threadData->config, threadData);
   if (!threadData->glContext)
     return 0;
+
+  threadData->presentContext =
+      initPresentContext(threadData->window, threadData->glContext,
+                         threadData->config);
 #else
   SDL_GL_MakeCurrent(threadData->window, threadData->glContext);
 #endif
@@ -239,6 +246,23 @@ int main(int argc, char *argv[]) {
     Config conf;
     conf.read(argc, argv);
 
+    if (conf.headless) {
+      /* SDL was brought up before the config could be read,
+       * restart video on a driver that doesn't need a display */
+      SDL_QuitSubSystem(SDL_INIT_VIDEO);
+      SDL_setenv("SDL_VIDEODRIVER", "offscreen", 0);
+      SDL_setenv("ALSOFT_DRIVERS", "null", 0);
+
+      if (SDL_InitSubSystem(SDL_INIT_VIDEO) < 0) {
+        showInitError(std::string("Error initializing headless video: ") +
+                      SDL_GetError());
+        SDL_Quit();
+        return 0;
+      }
+
+      conf.fullscreen = false;
+    }
+
 #if defined(__WIN32__)
     // Create a debug console in debug mode
     if (conf.winConsole) {
@@ -325,6 +349,8 @@ int main(int argc, char *argv[]) {
       winFlags |= SDL_WINDOW_RESIZABLE;
     if (conf.fullscreen)
       winFlags |= SDL_WINDOW_FULLSCREEN_DESKTOP;
+    if (conf.headless)
+      winFlags |= SDL_WINDOW_HIDDEN;
     
 #ifdef GLES2_HEADER
   SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_ES);
@@ -425,6 +451,10 @@ int main(int argc, char *argv[]) {
     RGSSThreadData rtData(&eventThread, argv[0], win, alcDev, mode.refresh_rate,
                           mkxp_sys::getScalingFactor(), conf, glCtx);
 
+#ifndef MKXPZ_INIT_GL_LATER
+    rtData.presentContext = initPresentContext(win, glCtx, conf);
+#endif
+
     int winW, winH, drwW, drwH;
     SDL_GetWindowSize(win, &winW, &winH);
     rtData.windowSizeMsg.post(Vec2i(winW, winH));
@@ -477,6 +507,9 @@ int main(int argc, char *argv[]) {
                                rtData.rgssErrorMsg.c_str(), win);
     }
 
+    if (rtData.presentContext)
+      SDL_GL_DeleteContext(rtData.presentContext);
+
     if (rtData.glContext)
       SDL_GL_DeleteContext(rtData.glContext);
 
@@ -549,3 +582,21 @@ static SDL_GLContext initGL(SDL_Window *win, Config &conf,
   // GLDebugLogger dLogger;
   return glCtx;
 }
+
+static SDL_GLContext initPresentContext(SDL_Window *win, SDL_GLContext glCtx,
+                                        const Config &conf) {
+  if (!conf.presentThread || conf.headless || !glCtx)
+    return 0;
+
+  /* Creating a context makes it current */
+  SDL_GL_SetAttribute(SDL_GL_SHARE_WITH_CURRENT_CONTEXT, 1);
+  SDL_GLContext ctx = SDL_GL_CreateContext(win);
+  SDL_GL_SetAttribute(SDL_GL_SHARE_WITH_CURRENT_CONTEXT, 0);
+
+  if (!ctx)
+    Debug() << "Could not create present context:" << SDL_GetError();
+
+  SDL_GL_MakeCurrent(win, glCtx);
+
+  return ctx;
+}
@@ -28,25 +28,36 @@
 #include "audio.h"
 #include "glstate.h"
 #include "shader.h"
+#include "shadercache.h"
 #include "texpool.h"
 #include "font.h"
 #include "eventthread.h"
 #include "gl-util.h"
 #include "global-ibo.h"
 #include "quad.h"
+#include "spritebatch.h"
+#include "decodepool.h"
+#include "screenshotqueue.h"
+#include "bitmapcache.h"
+#include "glyphatlas.h"
+#include "textcache.h"
 #include "binding.h"
 #include "exception.h"
 #include "sharedmidistate.h"
+#include "rgssad.h"
 
 #include <unistd.h>
 #include <stdio.h>
 #include <string>
 #include <chrono>
+#include <algorithm>
 
 SharedState *SharedState::instance = 0;
 int SharedState::rgssVersion = 0;
 static GlobalIBO *_globalIBO = 0;
 
+#define PATH_CACHE_INDEX "pathcache.idx"
+
 static const char *gameArchExt()
 {
 	if (rgssVer == 1)
@@ -80,13 +91,21 @@ struct SharedStatePrivate
 
 	GLState _glState;
 
+	/* Must be constructed before 'shaders' */
+	ShaderCache shaderCache;
+
 	ShaderSet shaders;
 
 	TexPool texPool;
 
+	BitmapCache bitmapCache;
+
 	SharedFontState fontState;
 	Font *defaultFont;
 
+	GlyphAtlas glyphAtlas;
+	TextCache textCache;
+
 	TEX::ID globalTex;
 	int globalTexW, globalTexH;
 	bool globalTexDirty;
@@ -95,8 +114,18 @@ struct SharedStatePrivate
 
 	TEXFBO atlasTex;
 
+	/* 1x1, fully transparent */
+	TEX::ID emptyTex;
+
 	Quad gpQuad;
 
+	SpriteBatch spriteBatch;
+
+	DecodePool decodePool;
+
+	/* Destroyed first, so pending files still get written */
+	ScreenshotQueue screenshotQueue;
+
 	unsigned int stampCounter;
     
     std::chrono::time_point<std::chrono::steady_clock> startupTime;
@@ -104,7 +133,8 @@ struct SharedStatePrivate
 	SharedStatePrivate(RGSSThreadData *threadData)
 	    : bindingData(0),
 	      sdlWindow(threadData->window),
-	      fileSystem(threadData->argv0, threadData->config.allowSymlinks),
+	      fileSystem(threadData->argv0, threadData->config.allowSymlinks,
+	                 threadData->config.mapArchives),
 	      eThread(*threadData->ethread),
 	      rtData(*threadData),
 	      config(threadData->config),
@@ -113,16 +143,27 @@ struct SharedStatePrivate
 	      input(*threadData),
 	      audio(*threadData),
 	      _glState(threadData->config),
+	      shaderCache(threadData->config),
+	      texPool((uint64_t) std::max(threadData->config.texturePoolSize, 0) * 1024 * 1024),
+	      bitmapCache((uint64_t) std::max(threadData->config.bitmapCacheSize, 0) * 1024 * 1024),
 	      fontState(threadData->config),
+	      glyphAtlas(threadData->config.textAtlas),
+	      textCache((uint64_t) std::max(threadData->config.textCacheSize, 0) * 1024 * 1024),
+	      screenshotQueue(decodePool),
 	      stampCounter(0)
 	{
         
         startupTime = std::chrono::steady_clock::now();
         
 		/* Shaders have been compiled in ShaderSet's constructor */
+		shaderCache.finish();
+
 		if (gl.ReleaseShaderCompiler)
 			gl.ReleaseShaderCompiler();
 
+		if (config.benchmarkDecrypt)
+			RGSS_benchmarkKernels();
+
 		std::string archPath = config.execName + gameArchExt();
 
 		/* Check if a game archive exists */
@@ -139,7 +180,8 @@ struct SharedStatePrivate
 			fileSystem.addPath(config.rtps[i].c_str());
 
 		if (config.pathCache)
-			fileSystem.createPathCache();
+			fileSystem.createPathCache(config.customDataPath.empty()
+				? std::string() : config.customDataPath + "/" PATH_CACHE_INDEX);
 
 		fileSystem.initFontSets(fontState);
 
@@ -158,6 +200,13 @@ struct SharedStatePrivate
 		TEXFBO::allocEmpty(gpTexFBO, globalTexW, globalTexH);
 		TEXFBO::linkFBO(gpTexFBO);
 
+		const uint32_t clearPixel = 0;
+		emptyTex = TEX::gen();
+		TEX::bind(emptyTex);
+		TEX::setRepeat(false);
+		TEX::setSmooth(false);
+		TEX::uploadImage(1, 1, &clearPixel, GL_RGBA);
+
 		/* RGSS3 games will call setup_midi, so there's
 		 * no need to do it on startup */
 		if (rgssVer <= 2)
@@ -167,6 +216,7 @@ struct SharedStatePrivate
 	~SharedStatePrivate()
 	{
 		TEX::del(globalTex);
+		TEX::del(emptyTex);
 		TEXFBO::fini(gpTexFBO);
 		TEXFBO::fini(atlasTex);
 	}
@@ -238,6 +288,12 @@ GSATT(GLState&, _glState)
 GSATT(ShaderSet&, shaders)
 GSATT(TexPool&, texPool)
 GSATT(Quad&, gpQuad)
+GSATT(SpriteBatch&, spriteBatch)
+GSATT(DecodePool&, decodePool)
+GSATT(ScreenshotQueue&, screenshotQueue)
+GSATT(BitmapCache&, bitmapCache)
+GSATT(GlyphAtlas&, glyphAtlas)
+GSATT(TextCache&, textCache)
 GSATT(SharedFontState&, fontState)
 GSATT(SharedMidiState&, midiState)
 
@@ -267,6 +323,11 @@ void SharedState::bindTex()
 	}
 }
 
+void SharedState::bindEmptyTex()
+{
+	TEX::bind(p->emptyTex);
+}
+
 void SharedState::ensureTexSize(int minW, int minH, Vec2i &currentSizeOut)
 {
 	if (minW > p->globalTexW)
@@ -35,6 +35,12 @@ struct SDL_Window;
 struct TEXFBO;
 struct Quad;
 struct ShaderSet;
+class SpriteBatch;
+class DecodePool;
+class ScreenshotQueue;
+class BitmapCache;
+class GlyphAtlas;
+class TextCache;
 
 class Scene;
 class FileSystem;
@@ -77,6 +83,16 @@ struct SharedState
 
 	TexPool &texPool() const;
 
+	SpriteBatch &spriteBatch() const;
+
+	DecodePool &decodePool() const;
+	ScreenshotQueue &screenshotQueue() const;
+
+	BitmapCache &bitmapCache() const;
+
+	GlyphAtlas &glyphAtlas() const;
+	TextCache &textCache() const;
+
 	SharedFontState &fontState() const;
 	Font &defaultFont() const;
 	SharedMidiState &midiState() const;
@@ -97,6 +113,10 @@ struct SharedState
 	void bindTex();
 	void ensureTexSize(int minW, int minH, Vec2i &currentSizeOut);
 
+	/* Clamped, 1x1 transparent texture; sampling it anywhere
+	 * gives the same as sampling a cleared texture */
+	void bindEmptyTex();
+
 	TEXFBO &gpTexFBO(int minW, int minH);
 
 	Quad &gpQuad() const;
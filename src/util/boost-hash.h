@@ -84,6 +84,11 @@ public:
 		return p[key];
 	}
 
+	inline const_iterator find(const K &key) const
+	{
+		return p.find(key);
+	}
+
 	inline const_iterator cbegin() const
 	{
 		return p.cbegin();
@@ -93,6 +98,11 @@ public:
 	{
 		return p.cend();
 	}
+
+	inline size_t size() const
+	{
+		return p.size();
+	}
     
     inline void clear()
     {